@@ -0,0 +1,87 @@
+import socket
+import struct
+import sys
+
+# Client for the alignment daemon started with `process-tree-alignments-cpp serve <socket>`.
+# Frames are a little-endian uint32 payload length followed by the payload, see src/alignmentServer.h.
+
+LOAD, UNLOAD, ALIGN, HEALTH, SHUTDOWN = 1, 2, 3, 4, 5
+
+
+def pack_string(text):
+    data = text.encode("utf-8")
+    return struct.pack("<I", len(data)) + data
+
+
+class AlignmentClient:
+    def __init__(self, socket_path):
+        self.connection = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+        self.connection.connect(socket_path)
+
+    def close(self):
+        self.connection.close()
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, *exc):
+        self.close()
+
+    def _receive(self, size):
+        data = b""
+        while len(data) < size:
+            chunk = self.connection.recv(size - len(data))
+            if not chunk:
+                raise ConnectionError("The alignment server closed the connection")
+            data += chunk
+        return data
+
+    # sends one request and returns the payload of the reply after the status byte
+    def _request(self, payload):
+        self.connection.sendall(struct.pack("<I", len(payload)) + payload)
+        (length,) = struct.unpack("<I", self._receive(4))
+        reply = self._receive(length)
+        if reply[0] != 0:
+            (size,) = struct.unpack_from("<I", reply, 1)
+            raise RuntimeError(reply[5:5 + size].decode("utf-8"))
+        return reply[1:]
+
+    def load(self, name, tree, normalize=True):
+        self._request(bytes([LOAD]) + pack_string(name) + pack_string(tree) + bytes([int(normalize)]))
+
+    def unload(self, name):
+        return self._request(bytes([UNLOAD]) + pack_string(name))[0] != 0
+
+    # returns (cost, lower_bound, exact); with a budget >= 0 only costs up to the budget are exact
+    def align(self, name, trace, budget=-1):
+        payload = bytes([ALIGN]) + pack_string(name) + struct.pack("<iI", budget, len(trace))
+        payload += b"".join(pack_string(activity) for activity in trace)
+        cost, lower_bound, exact = struct.unpack("<iiB", self._request(payload))
+        return cost, lower_bound, exact != 0
+
+    def health(self):
+        reply = self._request(bytes([HEALTH]))
+        (size,) = struct.unpack_from("<I", reply)
+        return dict(line.split(" ", 1) for line in reply[4:4 + size].decode("utf-8").splitlines())
+
+    def shutdown(self):
+        self._request(bytes([SHUTDOWN]))
+
+
+# usage: alignment_client.py <socket> <tree file> <trace file>
+# loads the tree, aligns every line of the trace file and prints the case ids with their costs, then the metrics;
+# the trace file is the one of the command line tool: the case id and its activities, tab separated
+if __name__ == "__main__":
+    socket_path, tree_path, trace_path = sys.argv[1:4]
+    with AlignmentClient(socket_path) as client:
+        with open(tree_path) as tree_file:
+            client.load("model", tree_file.read().strip())
+        with open(trace_path) as trace_file:
+            for line in trace_file:
+                fields = line.rstrip("\n").split("\t")
+                if not fields[0]:
+                    continue
+                trace = [activity for activity in fields[1:] if activity]
+                print(fields[0], client.align("model", trace)[0], sep="\t")
+        for key, value in client.health().items():
+            print(key, value, file=sys.stderr)
@@ -19,6 +19,22 @@ source_files = [
     os.path.join(PROJECT_ROOT, "src/treeAlignment.cpp"),
     os.path.join(PROJECT_ROOT, "src/utils.cpp"),
     os.path.join(PROJECT_ROOT, "src/parser.cpp"),
+    os.path.join(PROJECT_ROOT, "src/traceEvents.cpp"),
+    os.path.join(PROJECT_ROOT, "src/eventLog.cpp"),
+    os.path.join(PROJECT_ROOT, "src/batchAlignment.cpp"),
+    os.path.join(PROJECT_ROOT, "src/onlineAlignment.cpp"),
+    os.path.join(PROJECT_ROOT, "src/treeNormalization.cpp"),
+    os.path.join(PROJECT_ROOT, "src/traceView.cpp"),
+    os.path.join(PROJECT_ROOT, "src/memoTable.cpp"),
+    os.path.join(PROJECT_ROOT, "src/modelRegistry.cpp"),
+    os.path.join(PROJECT_ROOT, "src/perfectFit.cpp"),
+    os.path.join(PROJECT_ROOT, "src/shardedAlignment.cpp"),
+    os.path.join(PROJECT_ROOT, "src/slicedAlignment.cpp"),
+    os.path.join(PROJECT_ROOT, "src/longTraceAlignment.cpp"),
+    os.path.join(PROJECT_ROOT, "src/costModel.cpp"),
+    os.path.join(PROJECT_ROOT, "src/alignmentServer.cpp"),
+    os.path.join(PROJECT_ROOT, "src/memoSnapshot.cpp"),
+    os.path.join(PROJECT_ROOT, "src/memoPolicy.cpp"),
 ]
 
 # Define include directories
@@ -33,6 +49,10 @@ define_macros = [
     ("PROJECT_OUTPUT_DIR", f'"{PROJECT_OUTPUT_DIR}"'),
 ]
 
+# COMPACT_MEMO=1 python setup.py build_ext selects the compact memo storage
+if os.environ.get("COMPACT_MEMO", "0") not in ("", "0"):
+    define_macros.append(("COMPACT_MEMO", None))
+
 ext_modules = [
     Pybind11Extension(
         "alignment",
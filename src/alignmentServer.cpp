@@ -0,0 +1,508 @@
+#include "alignmentServer.h"
+#include "batchAlignment.h"
+#include "parser.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <limits>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+#include <tuple>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// frames above this are rejected, a client sending one is out of sync or not speaking the protocol
+constexpr uint32_t maxFrameBytes = 64u << 20;
+// alignments whose latency the HEALTH percentiles are computed over
+constexpr size_t latencyWindow = 4096;
+
+// reads the fields of a request payload in order
+struct PayloadReader
+{
+    const std::string &payload;
+    size_t position = 0;
+
+    const char *take(size_t bytes)
+    {
+        if (payload.size() - position < bytes)
+        {
+            throw std::invalid_argument("Truncated request.");
+        }
+        const char *data = payload.data() + position;
+        position += bytes;
+        return data;
+    }
+
+    uint32_t readUint32()
+    {
+        const auto *bytes = reinterpret_cast<const unsigned char *>(take(4));
+        return bytes[0] | bytes[1] << 8 | bytes[2] << 16 | static_cast<uint32_t>(bytes[3]) << 24;
+    }
+
+    uint8_t readUint8()
+    {
+        return static_cast<uint8_t>(*take(1));
+    }
+
+    std::string readString()
+    {
+        const uint32_t length = readUint32();
+        return std::string(take(length), length);
+    }
+};
+
+void appendUint32(std::string &payload, uint32_t value)
+{
+    for (int shift = 0; shift < 32; shift += 8)
+    {
+        payload.push_back(static_cast<char>(value >> shift & 0xff));
+    }
+}
+
+void appendString(std::string &payload, const std::string &text)
+{
+    appendUint32(payload, static_cast<uint32_t>(text.size()));
+    payload += text;
+}
+
+// false if the peer closed the socket first
+bool receiveAll(int socket, char *data, size_t bytes)
+{
+    while (bytes > 0)
+    {
+        const ssize_t received = recv(socket, data, bytes, 0);
+        if (received < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (received <= 0)
+        {
+            return false;
+        }
+        data += received;
+        bytes -= static_cast<size_t>(received);
+    }
+    return true;
+}
+
+bool sendAll(int socket, const char *data, size_t bytes)
+{
+    while (bytes > 0)
+    {
+        // a client that went away must not kill the daemon with SIGPIPE
+        const ssize_t sent = send(socket, data, bytes, MSG_NOSIGNAL);
+        if (sent < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (sent <= 0)
+        {
+            return false;
+        }
+        data += sent;
+        bytes -= static_cast<size_t>(sent);
+    }
+    return true;
+}
+
+bool receiveFrame(int socket, std::string &payload)
+{
+    std::string header(4, '\0');
+    if (!receiveAll(socket, header.data(), header.size()))
+    {
+        return false;
+    }
+    const uint32_t length = PayloadReader{header}.readUint32();
+    if (length > maxFrameBytes)
+    {
+        return false;
+    }
+    payload.assign(length, '\0');
+    return receiveAll(socket, payload.data(), length);
+}
+
+bool sendFrame(int socket, const std::string &payload)
+{
+    std::string frame;
+    frame.reserve(payload.size() + 4);
+    appendUint32(frame, static_cast<uint32_t>(payload.size()));
+    frame += payload;
+    return sendAll(socket, frame.data(), frame.size());
+}
+
+AlignmentServer::AlignmentServer(std::string socketPath, ServerOptions options)
+    : socketPath(std::move(socketPath)), options(options), started(std::chrono::steady_clock::now()), listenSocket(-1),
+      stopping(false), requests(0), failedRequests(0), batches(0), batchedAlignments(0), distinctAlignments(0), memoHits(0),
+      memoMisses(0), memoSkips(0), nextLatency(0)
+{
+    this->options.maxBatch = std::max<size_t>(1, this->options.maxBatch);
+}
+
+AlignmentServer::~AlignmentServer()
+{
+    const int socket = listenSocket.exchange(-1);
+    if (socket >= 0)
+    {
+        close(socket);
+    }
+}
+
+/**
+ * Serves clients on the calling thread until stop is called. Alignments that were queued before are still answered,
+ * then all connections are closed and the socket file is removed.
+ *
+ * @throws std::runtime_error if the socket cannot be bound, e.g. because the path is too long or not writable
+ */
+void AlignmentServer::run()
+{
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    if (socketPath.empty() || socketPath.size() >= sizeof(address.sun_path))
+    {
+        throw std::runtime_error("Invalid socket path " + socketPath + ".");
+    }
+    std::strcpy(address.sun_path, socketPath.c_str());
+
+    const int server = socket(AF_UNIX, SOCK_STREAM, 0);
+    listenSocket = server;
+    // a daemon that did not shut down cleanly leaves its socket file behind
+    unlink(socketPath.c_str());
+    if (server < 0 || bind(server, reinterpret_cast<sockaddr *>(&address), sizeof(address)) != 0 || listen(server, SOMAXCONN) != 0)
+    {
+        throw std::runtime_error("Cannot listen on " + socketPath + ": " + std::strerror(errno) + ".");
+    }
+
+    std::vector<std::thread> workers;
+    const unsigned workerCount = resolveThreadCount(options.threads, std::numeric_limits<size_t>::max());
+    for (unsigned i = 0; i < workerCount; ++i)
+    {
+        workers.emplace_back(&AlignmentServer::alignBatches, this);
+    }
+
+    while (!stopping)
+    {
+        const int client = accept(server, nullptr, nullptr);
+        if (client < 0)
+        {
+            if (errno == EINTR || errno == ECONNABORTED)
+            {
+                continue;
+            }
+            // stop shuts the listening socket down, which wakes accept
+            break;
+        }
+
+        std::lock_guard<std::mutex> lock(connectionsMutex);
+        if (stopping)
+        {
+            close(client);
+            break;
+        }
+        // threads of closed connections are joined here, so a daemon that runs for weeks does not pile them up
+        connections.erase(std::remove_if(connections.begin(), connections.end(), [](auto &connection)
+                                         {
+                                             if (!connection->finished)
+                                             {
+                                                 return false;
+                                             }
+                                             connection->thread.join();
+                                             return true; }),
+                          connections.end());
+        auto &connection = *connections.emplace_back(std::make_unique<Connection>());
+        connection.socket = client;
+        connection.thread = std::thread(&AlignmentServer::serveConnection, this, std::ref(connection));
+    }
+    stop();
+
+    // the workers drain the queue before they exit, so every waiting connection gets its answer
+    queueReady.notify_all();
+    for (auto &worker : workers)
+    {
+        worker.join();
+    }
+    {
+        std::lock_guard<std::mutex> lock(connectionsMutex);
+        for (auto &connection : connections)
+        {
+            shutdown(connection->socket, SHUT_RDWR);
+        }
+    }
+    for (auto &connection : connections)
+    {
+        connection->thread.join();
+    }
+    connections.clear();
+    close(listenSocket.exchange(-1));
+    unlink(socketPath.c_str());
+}
+
+void AlignmentServer::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        stopping = true;
+    }
+    queueReady.notify_all();
+    const int socket = listenSocket;
+    if (socket >= 0)
+    {
+        shutdown(socket, SHUT_RDWR);
+    }
+}
+
+void AlignmentServer::serveConnection(Connection &connection)
+{
+    std::string request;
+    while (receiveFrame(connection.socket, request))
+    {
+        bool shutdownRequested = false;
+        const std::string reply = handleRequest(request, shutdownRequested);
+        const bool sent = sendFrame(connection.socket, reply);
+        if (shutdownRequested)
+        {
+            stop();
+        }
+        if (!sent || shutdownRequested)
+        {
+            break;
+        }
+    }
+    close(connection.socket);
+    connection.finished = true;
+}
+
+// runs a request and returns the reply payload; errors become error replies, the connection stays open
+std::string AlignmentServer::handleRequest(const std::string &request, bool &shutdown)
+{
+    requests++;
+    std::string reply(1, '\0');
+    try
+    {
+        PayloadReader reader{request};
+        switch (static_cast<ServerRequest>(reader.readUint8()))
+        {
+        case ServerRequest::LOAD:
+        {
+            const std::string name = reader.readString();
+            const std::string tree = reader.readString();
+            registry.load(name, tree, reader.readUint8() != 0);
+            break;
+        }
+        case ServerRequest::UNLOAD:
+            reply.push_back(registry.unload(reader.readString()) ? 1 : 0);
+            break;
+        case ServerRequest::ALIGN:
+        {
+            const std::string name = reader.readString();
+            const int budget = static_cast<int32_t>(reader.readUint32());
+            const uint32_t labelCount = reader.readUint32();
+            // every label takes at least its length, so a count the payload cannot hold is refused before allocating
+            if (labelCount > (request.size() - reader.position) / 4)
+            {
+                throw std::invalid_argument("Truncated request.");
+            }
+            std::vector<std::string> labels(labelCount);
+            for (auto &label : labels)
+            {
+                label = reader.readString();
+            }
+            auto model = registry.find(name);
+            if (!model)
+            {
+                throw std::invalid_argument("No model is loaded as " + name + ".");
+            }
+            const AlignmentResult result = align(std::move(model), convertStringTrace(labels), budget);
+            appendUint32(reply, static_cast<uint32_t>(result.cost));
+            appendUint32(reply, static_cast<uint32_t>(result.lowerBound));
+            reply.push_back(result.exact ? 1 : 0);
+            break;
+        }
+        case ServerRequest::HEALTH:
+            appendString(reply, health());
+            break;
+        case ServerRequest::SHUTDOWN:
+            shutdown = true;
+            break;
+        default:
+            throw std::invalid_argument("Unknown request type.");
+        }
+    }
+    catch (const std::exception &error)
+    {
+        failedRequests++;
+        reply.assign(1, '\1');
+        appendString(reply, error.what());
+    }
+    return reply;
+}
+
+// queues the alignment for the workers and waits for its batch
+AlignmentResult AlignmentServer::align(std::shared_ptr<const ProcessModel> model, std::vector<int> trace, int budget)
+{
+    auto pending = std::make_unique<PendingAlignment>();
+    pending->model = std::move(model);
+    pending->trace = std::move(trace);
+    pending->budget = budget;
+    pending->received = std::chrono::steady_clock::now();
+    auto result = pending->result.get_future();
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        if (stopping)
+        {
+            throw std::runtime_error("The server is shutting down.");
+        }
+        queue.push_back(std::move(pending));
+    }
+    queueReady.notify_one();
+    return result.get();
+}
+
+/**
+ * Worker loop. Each turn takes up to maxBatch queued alignments, sorts them so that equal traces and traces with
+ * a common prefix run back-to-back, and aligns every distinct (model, budget, trace) once. The memo of the worker
+ * thread is kept across batches and models until it outgrows maxMemoEntries, so frequent variants stay warm.
+ */
+void AlignmentServer::alignBatches()
+{
+    memoStats = MemoStats();
+    memoPolicyStats = MemoPolicyStats();
+    MemoPolicyScope policyScope(options.memoPolicy);
+    while (true)
+    {
+        std::vector<std::unique_ptr<PendingAlignment>> batch;
+        {
+            std::unique_lock<std::mutex> lock(queueMutex);
+            queueReady.wait(lock, [this]()
+                            { return !queue.empty() || stopping; });
+            if (queue.empty())
+            {
+                return;
+            }
+            while (!queue.empty() && batch.size() < options.maxBatch)
+            {
+                batch.push_back(std::move(queue.front()));
+                queue.pop_front();
+            }
+        }
+        // other workers can start on the rest of the queue
+        queueReady.notify_one();
+
+        std::sort(batch.begin(), batch.end(), [](const auto &a, const auto &b)
+                  { return std::tie(a->model, a->budget, a->trace) < std::tie(b->model, b->budget, b->trace); });
+
+        const MemoStats before = memoStats;
+        const MemoPolicyStats policyBefore = memoPolicyStats;
+        size_t distinct = 0;
+        for (size_t first = 0; first < batch.size();)
+        {
+            size_t last = first + 1;
+            while (last < batch.size() && batch[last]->model == batch[first]->model && batch[last]->budget == batch[first]->budget &&
+                   batch[last]->trace == batch[first]->trace)
+            {
+                last++;
+            }
+
+            const auto &request = *batch[first];
+            try
+            {
+                if (options.maxMemoEntries == 0 || costTableEntries(costTable) > options.maxMemoEntries)
+                {
+                    costTable.clear();
+                }
+                Deadline deadline{std::chrono::milliseconds(options.timeoutMs)};
+                const AlignmentResult result = request.budget >= 0
+                                                   ? alignWithin(request.model->root, request.trace, request.budget, deadline)
+                                                   : alignAnytime(request.model->root, request.trace, deadline);
+                for (size_t i = first; i < last; ++i)
+                {
+                    batch[i]->result.set_value(result);
+                }
+            }
+            catch (...)
+            {
+                for (size_t i = first; i < last; ++i)
+                {
+                    batch[i]->result.set_exception(std::current_exception());
+                }
+            }
+            for (size_t i = first; i < last; ++i)
+            {
+                recordLatency(std::chrono::steady_clock::now() - batch[i]->received);
+            }
+            distinct++;
+            first = last;
+        }
+
+        batches++;
+        batchedAlignments += batch.size();
+        distinctAlignments += distinct;
+        memoHits += memoStats.hits - before.hits;
+        memoMisses += memoStats.misses - before.misses;
+        memoSkips += memoPolicyStats.staticSkips + memoPolicyStats.adaptiveSkips - policyBefore.staticSkips - policyBefore.adaptiveSkips;
+    }
+}
+
+void AlignmentServer::recordLatency(std::chrono::steady_clock::duration latency)
+{
+    const double micros = std::chrono::duration<double, std::micro>(latency).count();
+    std::lock_guard<std::mutex> lock(latencyMutex);
+    if (recentLatencies.size() < latencyWindow)
+    {
+        recentLatencies.push_back(micros);
+    }
+    else
+    {
+        recentLatencies[nextLatency] = micros;
+    }
+    nextLatency = (nextLatency + 1) % latencyWindow;
+}
+
+std::string AlignmentServer::health() const
+{
+    std::vector<double> latencies;
+    {
+        std::lock_guard<std::mutex> lock(latencyMutex);
+        latencies = recentLatencies;
+    }
+    std::sort(latencies.begin(), latencies.end());
+    const auto percentile = [&latencies](double p)
+    {
+        return latencies.empty() ? 0.0 : latencies[static_cast<size_t>(p * (latencies.size() - 1))];
+    };
+
+    size_t queued;
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        queued = queue.size();
+    }
+    size_t openConnections = 0;
+    {
+        std::lock_guard<std::mutex> lock(connectionsMutex);
+        for (const auto &connection : connections)
+        {
+            openConnections += connection->finished ? 0 : 1;
+        }
+    }
+    const size_t lookups = memoHits + memoMisses;
+
+    std::ostringstream output;
+    output << "status " << (stopping ? "stopping" : "ok") << "\n"
+           << "uptimeMs " << std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - started).count() << "\n"
+           << "models " << registry.models().size() << "\n"
+           << "connections " << openConnections << "\n"
+           << "queued " << queued << "\n"
+           << "requests " << requests << "\n"
+           << "failedRequests " << failedRequests << "\n"
+           << "batches " << batches << "\n"
+           << "alignments " << batchedAlignments << "\n"
+           << "distinctAlignments " << distinctAlignments << "\n"
+           << "memoHitRate " << (lookups == 0 ? 0.0 : static_cast<double>(memoHits) / lookups) << "\n"
+           << "memoSkips " << memoSkips << "\n"
+           << "latencyP50Us " << percentile(0.5) << "\n"
+           << "latencyP90Us " << percentile(0.9) << "\n"
+           << "latencyP99Us " << percentile(0.99) << "\n"
+           << "latencyMaxUs " << (latencies.empty() ? 0.0 : latencies.back()) << "\n";
+    return output.str();
+}
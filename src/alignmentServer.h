@@ -0,0 +1,124 @@
+#ifndef ALIGNMENTSERVER_H
+#define ALIGNMENTSERVER_H
+#include "memoPolicy.h"
+#include "modelRegistry.h"
+#include "treeAlignment.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// A long-running local daemon that keeps parsed models and the memos of its workers warm between requests.
+// Clients talk to it over a Unix domain socket in frames: a 4 byte payload length followed by the payload.
+// A request is an opcode byte and its fields, a reply a status byte (0 = ok, 1 = error) followed by the result
+// or an error message. Integers are little-endian, strings a uint32 length followed by their bytes.
+//
+//   LOAD      name, tree, uint8 normalize                        -> nothing
+//   UNLOAD    name                                               -> uint8 found
+//   ALIGN     name, int32 budget (< 0 = exact), uint32 n, n labels -> int32 cost, int32 lowerBound, uint8 exact
+//   HEALTH                                                       -> string of "key value" lines
+//   SHUTDOWN                                                     -> nothing, the server stops after replying
+//
+// Every connection is served by its own thread, alignments from all connections go through one queue. A worker
+// takes up to maxBatch queued alignments at once, aligns each distinct trace once and answers all its requests.
+enum class ServerRequest : uint8_t
+{
+    LOAD = 1,
+    UNLOAD = 2,
+    ALIGN = 3,
+    HEALTH = 4,
+    SHUTDOWN = 5
+};
+
+struct ServerOptions
+{
+    // alignment workers, 0 uses all hardware threads
+    unsigned threads = 0;
+    // per alignment, <= 0 disables it
+    int timeoutMs = 60000;
+    // queued alignments a worker takes at once
+    size_t maxBatch = 64;
+    // memo entries a worker keeps warm between batches before clearing it
+    size_t maxMemoEntries = 2000000;
+    MemoPolicy memoPolicy = MemoPolicy::STATIC;
+};
+
+class AlignmentServer
+{
+public:
+    AlignmentServer(std::string socketPath, ServerOptions options);
+
+    ~AlignmentServer();
+
+    // binds the socket and serves until stop is called or a client sends SHUTDOWN
+    void run();
+
+    // may be called from any thread; run returns once the queued alignments are answered
+    void stop();
+
+    // the HEALTH reply: uptime, load, batching and latency metrics
+    std::string health() const;
+
+private:
+    struct PendingAlignment
+    {
+        std::shared_ptr<const ProcessModel> model;
+        std::vector<int> trace;
+        int budget;
+        std::chrono::steady_clock::time_point received;
+        std::promise<AlignmentResult> result;
+    };
+
+    struct Connection
+    {
+        int socket;
+        std::thread thread;
+        std::atomic<bool> finished{false};
+    };
+
+    void serveConnection(Connection &connection);
+
+    std::string handleRequest(const std::string &request, bool &shutdown);
+
+    AlignmentResult align(std::shared_ptr<const ProcessModel> model, std::vector<int> trace, int budget);
+
+    void alignBatches();
+
+    void recordLatency(std::chrono::steady_clock::duration latency);
+
+    std::string socketPath;
+    ServerOptions options;
+    ModelRegistry registry;
+    std::chrono::steady_clock::time_point started;
+    std::atomic<int> listenSocket;
+    std::atomic<bool> stopping;
+
+    std::deque<std::unique_ptr<PendingAlignment>> queue;
+    mutable std::mutex queueMutex;
+    std::condition_variable queueReady;
+
+    std::vector<std::unique_ptr<Connection>> connections;
+    mutable std::mutex connectionsMutex;
+
+    std::atomic<size_t> requests;
+    std::atomic<size_t> failedRequests;
+    std::atomic<size_t> batches;
+    std::atomic<size_t> batchedAlignments;
+    std::atomic<size_t> distinctAlignments;
+    std::atomic<size_t> memoHits;
+    std::atomic<size_t> memoMisses;
+    std::atomic<size_t> memoSkips;
+    // the latencies of the most recent alignments in microseconds, a ring buffer
+    std::vector<double> recentLatencies;
+    size_t nextLatency;
+    mutable std::mutex latencyMutex;
+};
+
+#endif // ALIGNMENTSERVER_H
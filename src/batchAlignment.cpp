@@ -0,0 +1,631 @@
+#include "batchAlignment.h"
+#include "longTraceAlignment.h"
+#include "memoSnapshot.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <exception>
+#include <limits>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <unordered_map>
+
+double BatchStats::memoHitRate() const
+{
+    const size_t lookups = memoHits + memoMisses;
+    return lookups == 0 ? 0.0 : static_cast<double>(memoHits) / lookups;
+}
+
+unsigned resolveThreadCount(unsigned threads, size_t jobs)
+{
+    if (threads == 0)
+    {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    return static_cast<unsigned>(std::min<size_t>(threads, std::max<size_t>(jobs, 1)));
+}
+
+// Prefix trie over the encoded variants. Nodes are stored in creation order,
+// so a parent always comes before its children.
+struct VariantTrie
+{
+    struct Node
+    {
+        std::map<int, size_t> children;
+        // variants that end at this node
+        std::vector<size_t> variants;
+        size_t parent;
+        size_t subtreeVariants;
+    };
+
+    std::vector<Node> nodes;
+
+    explicit VariantTrie(const std::vector<std::vector<int>> &variants)
+    {
+        nodes.push_back({{}, {}, 0, 0});
+        for (size_t variant = 0; variant < variants.size(); ++variant)
+        {
+            size_t current = 0;
+            for (const int activity : variants[variant])
+            {
+                const auto [it, inserted] = nodes[current].children.try_emplace(activity, nodes.size());
+                if (inserted)
+                {
+                    nodes.push_back({{}, {}, current, 0});
+                }
+                current = it->second;
+            }
+            nodes[current].variants.push_back(variant);
+        }
+
+        // children have higher indices than their parents, so one backwards pass sums up the subtrees
+        for (size_t i = nodes.size(); i-- > 0;)
+        {
+            nodes[i].subtreeVariants += nodes[i].variants.size();
+            if (i > 0)
+            {
+                nodes[nodes[i].parent].subtreeVariants += nodes[i].subtreeVariants;
+            }
+        }
+    }
+
+    // variants of a subtree in depth-first order, i.e. sorted by their encoded traces
+    std::vector<size_t> collect(size_t subtree) const
+    {
+        std::vector<size_t> result;
+        std::vector<size_t> stack = {subtree};
+        while (!stack.empty())
+        {
+            const Node &node = nodes[stack.back()];
+            stack.pop_back();
+            result.insert(result.end(), node.variants.begin(), node.variants.end());
+            for (auto it = node.children.rbegin(); it != node.children.rend(); ++it)
+            {
+                stack.push_back(it->second);
+            }
+        }
+        return result;
+    }
+};
+
+// splits the trie into whole subtrees of at most chunkSize variants, in depth-first order;
+// neighbouring small subtrees share a prefix as well and are packed into the same chunk
+std::vector<std::vector<size_t>> trieChunks(const std::vector<std::vector<int>> &variants, size_t chunkSize)
+{
+    const VariantTrie trie(variants);
+    std::vector<std::vector<size_t>> chunks;
+    std::vector<size_t> stack = {0};
+
+    const auto emit = [&chunks, chunkSize](const std::vector<size_t> &part)
+    {
+        if (chunks.empty() || chunks.back().size() + part.size() > chunkSize)
+        {
+            chunks.emplace_back();
+        }
+        chunks.back().insert(chunks.back().end(), part.begin(), part.end());
+    };
+
+    while (!stack.empty())
+    {
+        const size_t current = stack.back();
+        stack.pop_back();
+        const auto &node = trie.nodes[current];
+
+        if (node.subtreeVariants <= chunkSize)
+        {
+            if (node.subtreeVariants > 0)
+            {
+                emit(trie.collect(current));
+            }
+            continue;
+        }
+
+        // the subtree is too large for one worker, its own variants go first and the children are split further
+        if (!node.variants.empty())
+        {
+            emit(node.variants);
+        }
+        for (auto it = node.children.rbegin(); it != node.children.rend(); ++it)
+        {
+            stack.push_back(it->second);
+        }
+    }
+    return chunks;
+}
+
+std::vector<std::vector<size_t>> inputOrderChunks(size_t numVariants, size_t chunkSize)
+{
+    std::vector<std::vector<size_t>> chunks;
+    for (size_t start = 0; start < numVariants; start += chunkSize)
+    {
+        auto &chunk = chunks.emplace_back();
+        for (size_t variant = start; variant < std::min(numVariants, start + chunkSize); ++variant)
+        {
+            chunk.push_back(variant);
+        }
+    }
+    return chunks;
+}
+
+// makes the memo of a worker the memo of this thread until it goes out of scope
+struct WorkerMemoScope
+{
+    CostTable &memo;
+
+    explicit WorkerMemoScope(CostTable &memo) : memo(memo)
+    {
+        std::swap(costTable, memo);
+    }
+
+    ~WorkerMemoScope()
+    {
+        std::swap(costTable, memo);
+    }
+};
+
+// aligns one variant the way options ask for, with the memo of a worker as the memo of this thread
+AlignmentResult alignWithWorkerMemo(CostTable &memo, const std::shared_ptr<TreeNode> &root, const std::vector<int> &trace,
+                                    const BatchOptions &options, const CostModel *costs, Deadline &deadline)
+{
+    if (options.maxMemoEntries == 0 || costTableEntries(memo) > options.maxMemoEntries)
+    {
+        memo.clear();
+    }
+    WorkerMemoScope scope(memo);
+    if (options.budget >= 0)
+    {
+        return alignWithin(root, trace, options.budget, deadline, costs);
+    }
+    if (!costs && options.longTraceWindow > 0 && trace.size() > options.longTraceWindow)
+    {
+        return alignLongTrace(root, trace, options.longTraceWindow, deadline);
+    }
+    return alignAnytime(root, trace, deadline, costs);
+}
+
+/**
+ * Aligns every variant against every model on a pool of threads. Workers pull whole chunks of the schedule and keep
+ * their memo warm across the variants of a chunk, so variants sharing subtraces reuse each other's subproblems.
+ * The memo is keyed by subtree structure, so the models share it as well: fragments that several models
+ * have in common are solved once per trace.
+ *
+ * @param roots Roots of the process trees
+ * @param variants Encoded traces
+ * @param frequencies Cases per variant for the deviation counts, empty counts every variant once
+ * @param options Timeout, thread count, schedule and memo limit of the workers
+ * @param stats If given, receives the memo hit rate of the schedule and the deviation counts
+ * @return One result per model and variant, in input order
+ */
+std::vector<std::vector<AlignmentResult>> alignFrequentVariants(const std::vector<std::shared_ptr<TreeNode>> &roots,
+                                                                const std::vector<std::vector<int>> &variants,
+                                                                const std::vector<size_t> &frequencies,
+                                                                const BatchOptions &options, BatchStats *stats)
+{
+    if (!options.costs.empty() && options.costs.size() != roots.size())
+    {
+        throw std::invalid_argument("Expected one cost model per process tree.");
+    }
+    const unsigned threadCount = resolveThreadCount(options.threads, variants.size());
+    // a few chunks per thread keep the load balanced when some subtrees are slow
+    const size_t chunkSize = std::max<size_t>(1, (variants.size() + threadCount * 4 - 1) / (threadCount * 4));
+    const auto chunks = options.schedule == BatchSchedule::TRIE_ORDER ? trieChunks(variants, chunkSize)
+                                                                       : inputOrderChunks(variants.size(), chunkSize);
+
+    std::vector<std::vector<AlignmentResult>> results(roots.size(), std::vector<AlignmentResult>(variants.size()));
+    std::atomic<size_t> nextChunk(0);
+    std::exception_ptr failure;
+    BatchStats totals;
+    totals.chunks = chunks.size();
+    std::mutex totalsMutex;
+
+    // a snapshot written for other trees is ignored and replaced at the end
+    const auto snapshot = options.memoSnapshot.empty() ? nullptr : openMemoSnapshot(options.memoSnapshot, roots);
+    std::vector<CostTable> memos(threadCount);
+    if (options.countDeviations)
+    {
+        totals.deviations.resize(roots.size());
+    }
+    std::vector<std::unordered_map<const TreeNode *, int>> positions;
+    for (size_t model = 0; options.countDeviations && model < roots.size(); ++model)
+    {
+        positions.push_back(preorderPositions(roots[model]));
+    }
+
+    const auto worker = [&](CostTable &memo)
+    {
+        memoStats = MemoStats();
+        memoPolicyStats = MemoPolicyStats();
+        MemoSnapshotScope snapshotScope(snapshot.get());
+        MemoPolicyScope policyScope(options.memoPolicy);
+        // merged into the totals at the end
+        std::vector<DeviationCounts> deviations(totals.deviations.size());
+        try
+        {
+            for (size_t c = nextChunk.fetch_add(1); c < chunks.size(); c = nextChunk.fetch_add(1))
+            {
+                for (const size_t variant : chunks[c])
+                {
+                    for (size_t model = 0; model < roots.size(); ++model)
+                    {
+                        const CostModel *costs = options.costs.empty() ? nullptr : options.costs[model].get();
+                        Deadline deadline{std::chrono::milliseconds(options.timeoutMs)};
+                        const auto &result = results[model][variant] = alignWithWorkerMemo(memo, roots[model], variants[variant], options, costs, deadline);
+                        if (options.countDeviations)
+                        {
+                            const size_t frequency = frequencies.empty() ? 1 : frequencies[variant];
+                            if (!result.exact || (options.longTraceWindow > 0 && variants[variant].size() > options.longTraceWindow))
+                            {
+                                deviations[model].skippedTraces += frequency;
+                            }
+                            else
+                            {
+                                WorkerMemoScope scope(memo);
+                                countDeviations(roots[model], variants[variant], positions[model], frequency, deviations[model], costs);
+                            }
+                        }
+                    }
+                }
+            }
+        }
+        catch (...)
+        {
+            std::lock_guard<std::mutex> lock(totalsMutex);
+            failure = std::current_exception();
+            nextChunk.store(chunks.size());
+        }
+
+        std::lock_guard<std::mutex> lock(totalsMutex);
+        totals.memoHits += memoStats.hits;
+        totals.memoMisses += memoStats.misses;
+        totals.memoSkips += memoPolicyStats.staticSkips + memoPolicyStats.adaptiveSkips;
+        totals.memoSwitchedOff += memoPolicyStats.switchedOff;
+        totals.memoEntries += costTableEntries(memo);
+        totals.memoBytes += costTableBytes(memo);
+        for (size_t model = 0; model < deviations.size(); ++model)
+        {
+            totals.deviations[model].add(deviations[model]);
+        }
+    };
+
+    std::vector<std::thread> pool;
+    for (unsigned i = 1; i < threadCount; ++i)
+    {
+        pool.emplace_back(worker, std::ref(memos[i]));
+    }
+    worker(memos[0]);
+    for (auto &thread : pool)
+    {
+        thread.join();
+    }
+
+    if (failure)
+    {
+        std::rethrow_exception(failure);
+    }
+    if (!options.memoSnapshot.empty())
+    {
+        std::vector<const CostTable *> finalMemos;
+        for (const auto &memo : memos)
+        {
+            finalMemos.push_back(&memo);
+        }
+        writeMemoSnapshot(options.memoSnapshot, roots, finalMemos, snapshot.get());
+    }
+    if (stats)
+    {
+        *stats = totals;
+    }
+    return results;
+}
+
+std::vector<std::vector<AlignmentResult>> alignVariantsAgainst(const std::vector<std::shared_ptr<TreeNode>> &roots,
+                                                               const std::vector<std::vector<int>> &variants,
+                                                               const BatchOptions &options, BatchStats *stats)
+{
+    return alignFrequentVariants(roots, variants, {}, options, stats);
+}
+
+std::vector<AlignmentResult> alignVariants(const std::shared_ptr<TreeNode> &root, const std::vector<std::vector<int>> &variants,
+                                           const BatchOptions &options, BatchStats *stats)
+{
+    return std::move(alignVariantsAgainst({root}, variants, options, stats)[0]);
+}
+
+std::vector<AlignmentResult> alignLog(const std::shared_ptr<TreeNode> &root, const EventLog &log,
+                                      const BatchOptions &options, BatchStats *stats)
+{
+    const auto variantResults = std::move(alignFrequentVariants({root}, log.variants, log.variantFrequencies, options, stats)[0]);
+
+    std::vector<AlignmentResult> caseResults;
+    caseResults.reserve(log.caseVariants.size());
+    for (const size_t variant : log.caseVariants)
+    {
+        caseResults.push_back(variantResults[variant]);
+    }
+    return caseResults;
+}
+
+std::vector<std::vector<AlignmentResult>> alignLogAgainst(const std::vector<std::shared_ptr<TreeNode>> &roots, const EventLog &log,
+                                                          const BatchOptions &options, BatchStats *stats)
+{
+    const auto variantResults = alignFrequentVariants(roots, log.variants, log.variantFrequencies, options, stats);
+
+    std::vector<std::vector<AlignmentResult>> caseResults(roots.size());
+    for (size_t model = 0; model < roots.size(); ++model)
+    {
+        caseResults[model].reserve(log.caseVariants.size());
+        for (const size_t variant : log.caseVariants)
+        {
+            caseResults[model].push_back(variantResults[model][variant]);
+        }
+    }
+    return caseResults;
+}
+
+
+// the p quantile of the standard normal distribution, by bisection on its distribution function
+double normalQuantile(double p)
+{
+    double low = -40;
+    double high = 40;
+    for (int i = 0; i < 100; ++i)
+    {
+        const double middle = (low + high) / 2;
+        (0.5 * std::erfc(-middle / std::sqrt(2.0)) < p ? low : high) = middle;
+    }
+    return (low + high) / 2;
+}
+
+// case drawn as the given sample; counter based, so the samples do not depend on which worker draws them
+size_t sampledCase(uint64_t seed, size_t sample, size_t cases)
+{
+    // splitmix64
+    uint64_t bits = seed + 0x9e3779b97f4a7c15ULL * (sample + 1);
+    bits = (bits ^ (bits >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    bits = (bits ^ (bits >> 27)) * 0x94d049bb133111ebULL;
+    return static_cast<size_t>((bits ^ (bits >> 31)) % cases);
+}
+
+// mean and variance of a stream of values (Welford)
+struct RunningMean
+{
+    size_t count = 0;
+    double mean = 0;
+    double squares = 0;
+
+    void add(double value)
+    {
+        ++count;
+        const double delta = value - mean;
+        mean += delta / count;
+        squares += delta * (value - mean);
+    }
+
+    // half width of the normal-approximation confidence interval for the quantile z
+    double halfWidth(double z) const
+    {
+        return count < 2 ? std::numeric_limits<double>::infinity() : z * std::sqrt(squares / (count - 1) / count);
+    }
+};
+
+// 1 - cost / cost of the worst alignment, which moves every event on the log and runs the model on its own
+double caseFitness(const std::shared_ptr<TreeNode> &root, const std::vector<int> &trace, const CostModel *costs, int cost)
+{
+    int worstCost = costs ? costs->minModelCost(*root) : root->getMinModelCost();
+    for (const int activity : trace)
+    {
+        worstCost += costs ? costs->logMove(activity) : 1;
+    }
+    return worstCost == 0 ? 1.0 : 1.0 - static_cast<double>(cost) / worstCost;
+}
+
+/**
+ * Draws cases at random and aligns them on a pool of threads until the intervals are narrow enough, every variant has
+ * been drawn or the time budget is spent. The workers finish samples out of order, but they are added in the order
+ * they were drawn and the rule is checked after each one, so with a fixed seed the stopping point only depends on the
+ * time budget. Samples finished after the budget ran out are dropped.
+ */
+LogEstimate estimateLog(const std::shared_ptr<TreeNode> &root, const EventLog &log, const BatchOptions &options,
+                        const EstimateOptions &estimate, BatchStats *stats)
+{
+    if (!(estimate.confidence > 0 && estimate.confidence < 1))
+    {
+        throw std::invalid_argument("The confidence level must lie strictly between 0 and 1.");
+    }
+    if (estimate.fitnessWidth <= 0 && estimate.costWidth <= 0 && estimate.timeBudgetMs <= 0)
+    {
+        throw std::invalid_argument("Sampling needs an interval width or a time budget to stop at.");
+    }
+    if (options.costs.size() > 1)
+    {
+        throw std::invalid_argument("Expected one cost model per process tree.");
+    }
+    const CostModel *costs = options.costs.empty() ? nullptr : options.costs[0].get();
+    const auto start = std::chrono::steady_clock::now();
+    const auto end = start + std::chrono::milliseconds(estimate.timeBudgetMs);
+    const bool limited = estimate.timeBudgetMs > 0;
+    const size_t cases = log.caseVariants.size();
+
+    LogEstimate result;
+    if (cases == 0)
+    {
+        result.fitness = result.fitnessLow = 1;
+        result.complete = result.converged = true;
+        return result;
+    }
+
+    const double z = normalQuantile(0.5 + estimate.confidence / 2);
+    // the estimator wants costs, not a screen against a budget
+    BatchOptions workerOptions = options;
+    workerOptions.budget = -1;
+
+    // the first worker to draw a variant aligns it, the others wait for its result
+    std::vector<std::once_flag> aligned(log.variants.size());
+    std::vector<AlignmentResult> variantResults(log.variants.size());
+    std::atomic<size_t> alignments(0);
+
+    std::mutex samplesMutex;
+    bool stopping = false;
+    size_t nextSample = 0;
+    // finished samples that wait for an earlier one, by sample
+    std::map<size_t, size_t> finished;
+    std::vector<bool> variantSampled(log.variants.size());
+    RunningMean cost;
+    RunningMean fitness;
+    std::exception_ptr failure;
+    BatchStats totals;
+
+    // adds the waiting samples that are next in order; true once the stopping rule holds
+    const auto addFinished = [&]()
+    {
+        while (!finished.empty() && finished.begin()->first == result.samples)
+        {
+            const size_t variant = finished.begin()->second;
+            finished.erase(finished.begin());
+            const AlignmentResult &alignment = variantResults[variant];
+            cost.add(alignment.cost);
+            fitness.add(caseFitness(root, log.variants[variant], costs, alignment.cost));
+            result.samples++;
+            result.inexactSamples += alignment.exact ? 0 : 1;
+            if (!variantSampled[variant])
+            {
+                variantSampled[variant] = true;
+                result.sampledVariants++;
+            }
+
+            result.complete = result.sampledVariants == log.variants.size();
+            result.converged = result.samples >= estimate.minSamples && (estimate.fitnessWidth > 0 || estimate.costWidth > 0) &&
+                               (estimate.fitnessWidth <= 0 || 2 * fitness.halfWidth(z) <= estimate.fitnessWidth) &&
+                               (estimate.costWidth <= 0 || 2 * cost.halfWidth(z) <= estimate.costWidth);
+            if (result.complete || result.converged)
+            {
+                return true;
+            }
+        }
+        return false;
+    };
+
+    const unsigned threadCount = resolveThreadCount(options.threads, log.variants.size());
+    std::vector<CostTable> memos(threadCount);
+
+    const auto worker = [&](CostTable &memo)
+    {
+        memoStats = MemoStats();
+        memoPolicyStats = MemoPolicyStats();
+        MemoPolicyScope policyScope(options.memoPolicy);
+        try
+        {
+            for (;;)
+            {
+                size_t sample;
+                {
+                    std::lock_guard<std::mutex> lock(samplesMutex);
+                    if (stopping)
+                    {
+                        break;
+                    }
+                    sample = nextSample++;
+                }
+
+                const size_t variant = log.caseVariants[sampledCase(estimate.seed, sample, cases)];
+                std::call_once(aligned[variant], [&]()
+                               {
+                                   // no alignment runs past the time budget
+                                   auto timeout = std::chrono::milliseconds(options.timeoutMs);
+                                   if (limited)
+                                   {
+                                       const auto remaining = std::max(std::chrono::milliseconds(1),
+                                                                       std::chrono::duration_cast<std::chrono::milliseconds>(end - std::chrono::steady_clock::now()));
+                                       timeout = timeout.count() > 0 ? std::min(timeout, remaining) : remaining;
+                                   }
+                                   Deadline deadline{timeout};
+                                   variantResults[variant] = alignWithWorkerMemo(memo, root, log.variants[variant], workerOptions, costs, deadline);
+                                   alignments++; });
+
+                std::lock_guard<std::mutex> lock(samplesMutex);
+                if (stopping || (limited && std::chrono::steady_clock::now() >= end))
+                {
+                    stopping = true;
+                    break;
+                }
+                finished.emplace(sample, variant);
+                stopping = addFinished();
+            }
+        }
+        catch (...)
+        {
+            std::lock_guard<std::mutex> lock(samplesMutex);
+            failure = std::current_exception();
+            stopping = true;
+        }
+
+        std::lock_guard<std::mutex> lock(samplesMutex);
+        totals.memoHits += memoStats.hits;
+        totals.memoMisses += memoStats.misses;
+        totals.memoSkips += memoPolicyStats.staticSkips + memoPolicyStats.adaptiveSkips;
+        totals.memoSwitchedOff += memoPolicyStats.switchedOff;
+        totals.memoEntries += costTableEntries(memo);
+        totals.memoBytes += costTableBytes(memo);
+    };
+
+    std::vector<std::thread> pool;
+    for (unsigned i = 1; i < threadCount; ++i)
+    {
+        pool.emplace_back(worker, std::ref(memos[i]));
+    }
+    worker(memos[0]);
+    for (auto &thread : pool)
+    {
+        thread.join();
+    }
+
+    if (failure)
+    {
+        std::rethrow_exception(failure);
+    }
+
+    if (result.complete)
+    {
+        // every variant is known, so the bounds of the alignments bound the means over the log
+        double costSum = 0, lowerBoundSum = 0, fitnessSum = 0, fitnessBoundSum = 0;
+        for (size_t variant = 0; variant < log.variants.size(); ++variant)
+        {
+            const AlignmentResult &alignment = variantResults[variant];
+            const double frequency = static_cast<double>(log.variantFrequencies[variant]);
+            costSum += frequency * alignment.cost;
+            lowerBoundSum += frequency * alignment.lowerBound;
+            fitnessSum += frequency * caseFitness(root, log.variants[variant], costs, alignment.cost);
+            fitnessBoundSum += frequency * caseFitness(root, log.variants[variant], costs, alignment.lowerBound);
+        }
+        result.meanCost = result.costHigh = costSum / cases;
+        result.costLow = lowerBoundSum / cases;
+        result.fitness = result.fitnessLow = fitnessSum / cases;
+        result.fitnessHigh = fitnessBoundSum / cases;
+        result.converged = true;
+    }
+    else if (result.samples == 0)
+    {
+        result.meanCost = result.fitness = std::numeric_limits<double>::quiet_NaN();
+        result.costHigh = std::numeric_limits<double>::infinity();
+    }
+    else
+    {
+        result.meanCost = cost.mean;
+        result.costLow = std::max(0.0, cost.mean - cost.halfWidth(z));
+        result.costHigh = cost.mean + cost.halfWidth(z);
+        result.fitness = fitness.mean;
+        result.fitnessLow = std::max(0.0, fitness.mean - fitness.halfWidth(z));
+        result.fitnessHigh = std::min(1.0, fitness.mean + fitness.halfWidth(z));
+    }
+    result.millis = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    if (stats)
+    {
+        totals.chunks = alignments.load();
+        *stats = totals;
+    }
+    return result;
+}
@@ -0,0 +1,139 @@
+#ifndef BATCHALIGNMENT_H
+#define BATCHALIGNMENT_H
+#include "eventLog.h"
+#include "memoPolicy.h"
+#include "treeAlignment.h"
+#include "treeNode.h"
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+enum class BatchSchedule
+{
+    // consecutive blocks of the input
+    INPUT_ORDER,
+    // subtrees of a prefix trie over the variants, so variants sharing a prefix run back-to-back on one worker
+    TRIE_ORDER
+};
+
+struct BatchOptions
+{
+    // per variant, <= 0 disables it
+    int timeoutMs = 60000;
+    // 0 uses all hardware threads
+    unsigned threads = 0;
+    BatchSchedule schedule = BatchSchedule::TRIE_ORDER;
+    // memo entries a worker keeps warm across variants and models before clearing it, 0 clears it after every alignment
+    size_t maxMemoEntries = 2000000;
+    // which subproblems of the workers go through the memo
+    MemoPolicy memoPolicy = MemoPolicy::STATIC;
+    // negative aligns exactly, otherwise only costs up to budget are exact and the rest is reported as above it
+    int budget = -1;
+    // variants longer than this are split with alignLongTrace, 0 aligns every variant in one piece; ignored with a budget
+    size_t longTraceWindow = 0;
+    // cost model of each root, parallel to the roots; empty aligns with unit costs. Weighted models ignore longTraceWindow
+    std::vector<std::shared_ptr<const CostModel>> costs;
+    // Memo snapshot file, empty disables it. The workers look up what the memo misses in the snapshot if it was written
+    // for the same trees, and the new entries they still hold at the end are added to it, so an overlapping log next
+    // run is mostly memo hits. New entries dropped by maxMemoEntries during the run are not added.
+    std::string memoSnapshot;
+    // Sums the moves of an optimal alignment of every variant, times its cases, into BatchStats::deviations. Variants
+    // whose alignment is not exact or could not be rebuilt, and those longer than a non-zero longTraceWindow, only
+    // count as skipped.
+    bool countDeviations = false;
+};
+
+struct BatchStats
+{
+    size_t memoHits = 0;
+    size_t memoMisses = 0;
+    // subproblems the memo policy solved without the memo
+    size_t memoSkips = 0;
+    // times the adaptive policy switched a memo key off
+    size_t memoSwitchedOff = 0;
+    // entries and approximate bytes of the memos the workers hold at the end
+    size_t memoEntries = 0;
+    size_t memoBytes = 0;
+    // units of work handed to the workers
+    size_t chunks = 0;
+    // one per root if BatchOptions::countDeviations is set
+    std::vector<DeviationCounts> deviations;
+
+    double memoHitRate() const;
+};
+
+// threads for a pool working on jobs units of work, 0 asks for all hardware threads
+unsigned resolveThreadCount(unsigned threads, size_t jobs);
+
+// one result vector per root, each parallel to variants
+std::vector<std::vector<AlignmentResult>> alignVariantsAgainst(const std::vector<std::shared_ptr<TreeNode>> &roots,
+                                                               const std::vector<std::vector<int>> &variants,
+                                                               const BatchOptions &options, BatchStats *stats = nullptr);
+
+std::vector<AlignmentResult> alignVariants(const std::shared_ptr<TreeNode> &root, const std::vector<std::vector<int>> &variants,
+                                           const BatchOptions &options, BatchStats *stats = nullptr);
+
+// Aligns a grouped log and returns one result per case, parallel to log.caseIds
+std::vector<AlignmentResult> alignLog(const std::shared_ptr<TreeNode> &root, const EventLog &log,
+                                      const BatchOptions &options, BatchStats *stats = nullptr);
+
+// Aligns a grouped log against several trees, every variant is encoded once and aligned against all of them
+std::vector<std::vector<AlignmentResult>> alignLogAgainst(const std::vector<std::shared_ptr<TreeNode>> &roots, const EventLog &log,
+                                                          const BatchOptions &options, BatchStats *stats = nullptr);
+
+struct EstimateOptions
+{
+    // full width of the confidence interval on the mean fitness to stop at, <= 0 ignores it
+    double fitnessWidth = 0.01;
+    // full width of the confidence interval on the mean cost per case to stop at, <= 0 ignores it
+    double costWidth = 0;
+    // confidence level of both intervals
+    double confidence = 0.95;
+    // wall time of the whole estimate, <= 0 only stops on the widths
+    int timeBudgetMs = 10000;
+    // samples before the intervals are trusted, too few underestimate the spread of rare expensive variants
+    size_t minSamples = 100;
+    // the samples drawn only depend on the seed, not on the thread count
+    uint64_t seed = 1;
+};
+
+// Fitness of a case is 1 - cost / (cost of log moves for all its events + cost of the cheapest run of the model),
+// the estimate is the mean over the cases of the log.
+struct LogEstimate
+{
+    double meanCost = 0;
+    double costLow = 0;
+    double costHigh = 0;
+    double fitness = 0;
+    double fitnessLow = 0;
+    double fitnessHigh = 1;
+    // cases drawn, repeats included
+    size_t samples = 0;
+    // distinct variants among them
+    size_t sampledVariants = 0;
+    // samples whose alignment timed out; they count with their upper bound, so they only lower the fitness
+    size_t inexactSamples = 0;
+    // the samples covered every variant, so the intervals are the exact bounds over the whole log
+    bool complete = false;
+    // every requested width was reached, or the log completed, before the time budget ran out
+    bool converged = false;
+    double millis = 0;
+};
+
+/**
+ * Estimates the mean cost and fitness of a log from a random sample of its cases. Drawing cases uniformly draws the
+ * variants by frequency, and every sampled variant is aligned once however often it is drawn.
+ *
+ * @param root Root of the process tree
+ * @param log Grouped log
+ * @param options Threads, timeout, memo limit and cost model of the workers; budget and memoSnapshot are ignored
+ * @param estimate Stopping rule: interval widths, confidence and time budget
+ * @param stats If given, receives the memo hit rate and the number of alignments
+ * @return The estimates and their normal-approximation confidence intervals
+ * @throws std::invalid_argument If the confidence is not in (0, 1) or nothing but completing the log could stop the sampling
+ */
+LogEstimate estimateLog(const std::shared_ptr<TreeNode> &root, const EventLog &log, const BatchOptions &options,
+                        const EstimateOptions &estimate, BatchStats *stats = nullptr);
+
+#endif // BATCHALIGNMENT_H
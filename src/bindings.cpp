@@ -1,56 +1,668 @@
 #include "bindings.h"
+#include "batchAlignment.h"
+#include "longTraceAlignment.h"
+#include "modelRegistry.h"
+#include "onlineAlignment.h"
 #include "parser.h"
+#include "slicedAlignment.h"
+#include "traceEvents.h"
 #include "treeAlignment.h"
 #include "utils.h"
+#include <algorithm>
 #include <iostream>
+#include <pybind11/numpy.h>
 #include <pybind11/pybind11.h>
 #include <pybind11/stl.h>
 #include <span>
 #include <string>
-#include <atomic>
-#include <thread>
-#include <future>
+#include <chrono>
+#include <optional>
+#include <unordered_map>
 
 namespace py = pybind11;
 
-AlignmentWrapper::AlignmentWrapper()
+AlignmentWrapper::AlignmentWrapper() : timeoutMs(60000)
 {
 }
 
-void AlignmentWrapper::loadTree(std::string tree)
+void AlignmentWrapper::loadTree(std::string tree, bool normalize, const std::unordered_map<std::string, int> &logMoveCosts,
+                                const std::unordered_map<std::string, int> &modelMoveCosts)
 {
     processTree = parseProcessTreeString(tree);
+    normalizationStats = NormalizationStats();
+    if (normalize)
+    {
+        processTree = normalizeTree(processTree, &normalizationStats);
+    }
+    // the cost model indexes the subtrees, so it is built for the tree that is aligned
+    costModel.reset();
+    if (!logMoveCosts.empty() || !modelMoveCosts.empty())
+    {
+        costModel = std::make_shared<const CostModel>(processTree, logMoveCosts, modelMoveCosts);
+    }
+}
+
+const NormalizationStats &AlignmentWrapper::getNormalizationStats() const
+{
+    return normalizationStats;
+}
+
+std::shared_ptr<TreeNode> AlignmentWrapper::getTree() const
+{
+    return processTree;
+}
+
+void AlignmentWrapper::setTimeout(int newTimeoutMs)
+{
+    timeoutMs = newTimeoutMs;
+}
+
+int AlignmentWrapper::getTimeout() const
+{
+    return timeoutMs;
 }
 
 int AlignmentWrapper::align(const std::vector<std::string> newTrace) const
 {
-    std::vector<int> intTrace = convertStringTrace(newTrace);
-    std::span<const int> trace = intTrace;
+    const std::vector<int> intTrace = convertStringTrace(newTrace);
+    return alignEncoded(intTrace);
+}
+
+int AlignmentWrapper::alignEncoded(std::span<const int> trace) const
+{
+    costTable.clear();
+    Deadline deadline{std::chrono::milliseconds(timeoutMs)};
+    return alignWithDeadline(processTree, trace, deadline, costModel.get());
+}
 
-    stop_flag.store(false);
-    int timeout_seconds = 60;
+AlignmentResult AlignmentWrapper::alignAnytime(const std::vector<std::string> newTrace) const
+{
+    const std::vector<int> intTrace = convertStringTrace(newTrace);
+    return alignAnytimeEncoded(intTrace);
+}
 
+AlignmentResult AlignmentWrapper::alignAnytimeEncoded(std::span<const int> trace) const
+{
     costTable.clear();
-    std::future<size_t> result_future = std::async(std::launch::async, dynAlign, std::ref(processTree), std::ref(trace));
-    std::future_status status = result_future.wait_for(std::chrono::seconds(timeout_seconds));
+    Deadline deadline{std::chrono::milliseconds(timeoutMs)};
+    return ::alignAnytime(processTree, trace, deadline, costModel.get());
+}
+
+int AlignmentWrapper::alignWithin(const std::vector<std::string> newTrace, int budget) const
+{
+    const std::vector<int> intTrace = convertStringTrace(newTrace);
+    return alignWithinEncoded(intTrace, budget);
+}
+
+int AlignmentWrapper::alignWithinEncoded(std::span<const int> trace, int budget) const
+{
+    costTable.clear();
+    Deadline deadline{std::chrono::milliseconds(timeoutMs)};
+    const AlignmentResult result = ::alignWithin(processTree, trace, budget, deadline, costModel.get());
+    return result.exact ? result.cost : -1;
+}
+
+AlignmentResult AlignmentWrapper::alignLongTrace(const std::vector<std::string> newTrace, size_t window) const
+{
+    const std::vector<int> intTrace = convertStringTrace(newTrace);
+    return alignLongTraceEncoded(intTrace, window);
+}
+
+AlignmentResult AlignmentWrapper::alignLongTraceEncoded(std::span<const int> trace, size_t window) const
+{
+    if (costModel)
+    {
+        throw std::invalid_argument("Long trace alignment only supports unit move costs.");
+    }
+    Deadline deadline{std::chrono::milliseconds(timeoutMs)};
+    return ::alignLongTrace(processTree, trace, window, deadline);
+}
+
+std::vector<AlignmentResult> AlignmentWrapper::alignLog(const EventLog &log, BatchOptions options, BatchStats *stats) const
+{
+    options.timeoutMs = timeoutMs;
+    if (costModel)
+    {
+        options.costs = {costModel};
+    }
+    return ::alignLog(processTree, log, options, stats);
+}
+
+LogEstimate AlignmentWrapper::estimateLog(const EventLog &log, BatchOptions options, const EstimateOptions &estimate,
+                                          BatchStats *stats) const
+{
+    options.timeoutMs = timeoutMs;
+    if (costModel)
+    {
+        options.costs = {costModel};
+    }
+    return ::estimateLog(processTree, log, options, estimate, stats);
+}
+
+// int32 arrays that are already C-contiguous are viewed in place, anything else is converted once
+using EncodedTrace = py::array_t<int32_t, py::array::c_style | py::array::forcecast>;
+static_assert(sizeof(int) == sizeof(int32_t), "encoded traces are viewed as std::span<const int>");
+
+std::span<const int> encodedTraceView(const EncodedTrace &trace)
+{
+    if (trace.ndim() != 1)
+    {
+        throw std::invalid_argument("Encoded trace must be a one-dimensional int32 array.");
+    }
+    return std::span<const int>(trace.data(), static_cast<size_t>(trace.size()));
+}
+
+bool isIntegerColumn(const py::array &column)
+{
+    const char kind = column.dtype().kind();
+    return kind == 'i' || kind == 'u' || kind == 'b';
+}
+
+std::vector<std::string> stringColumn(const py::array &column)
+{
+    std::vector<std::string> values;
+    values.reserve(column.size());
+    for (const auto &value : column.attr("ravel")())
+    {
+        values.push_back(py::str(value));
+    }
+    return values;
+}
+
+// case ids as int64; string ids are numbered in order of appearance and their names kept for the result
+std::vector<int64_t> caseColumn(const py::array &cases, std::vector<std::string> &caseNames)
+{
+    if (isIntegerColumn(cases))
+    {
+        const auto codes = py::array_t<int64_t, py::array::c_style | py::array::forcecast>::ensure(cases);
+        return std::vector<int64_t>(codes.data(), codes.data() + codes.size());
+    }
+
+    std::unordered_map<std::string, int64_t> caseIndex;
+    std::vector<int64_t> caseIds;
+    for (auto &name : stringColumn(cases))
+    {
+        const auto [it, inserted] = caseIndex.try_emplace(name, static_cast<int64_t>(caseNames.size()));
+        if (inserted)
+        {
+            caseNames.push_back(std::move(name));
+        }
+        caseIds.push_back(it->second);
+    }
+    return caseIds;
+}
+
+// shared activity ids; integer columns are codes into categories if given, otherwise already encoded
+std::vector<int> activityColumn(const py::array &activities, const std::optional<std::vector<std::string>> &categories)
+{
+    if (isIntegerColumn(activities))
+    {
+        const auto codes = py::array_t<int64_t, py::array::c_style | py::array::forcecast>::ensure(activities);
+        std::vector<int> ids(codes.size());
+        if (!categories)
+        {
+            std::copy(codes.data(), codes.data() + codes.size(), ids.begin());
+            return ids;
+        }
+
+        // pandas uses the code -1 for missing values
+        const std::vector<int> categoryIds = convertStringTrace(*categories);
+        for (py::ssize_t i = 0; i < codes.size(); ++i)
+        {
+            const int64_t code = codes.data()[i];
+            ids[i] = code >= 0 && code < static_cast<int64_t>(categoryIds.size()) ? categoryIds[code] : -1;
+        }
+        return ids;
+    }
+
+    // encode every distinct label once
+    std::unordered_map<std::string, int> labelIds;
+    std::vector<int> ids;
+    ids.reserve(activities.size());
+    for (const auto &label : stringColumn(activities))
+    {
+        auto it = labelIds.find(label);
+        if (it == labelIds.end())
+        {
+            it = labelIds.emplace(label, convertStringTrace({label})[0]).first;
+        }
+        ids.push_back(it->second);
+    }
+    return ids;
+}
+
+BatchOptions batchOptions(unsigned threads, const std::string &schedule, size_t maxMemoEntries, int budget, size_t longTraceWindow,
+                          const std::string &memoSnapshot, const std::string &memoPolicy, bool countDeviations)
+{
+    BatchOptions options;
+    options.countDeviations = countDeviations;
+    options.memoSnapshot = memoSnapshot;
+    options.memoPolicy = parseMemoPolicy(memoPolicy);
+    options.threads = threads;
+    options.maxMemoEntries = maxMemoEntries;
+    options.budget = budget;
+    options.longTraceWindow = longTraceWindow;
+    if (schedule == "trie")
+    {
+        options.schedule = BatchSchedule::TRIE_ORDER;
+    }
+    else if (schedule == "input")
+    {
+        options.schedule = BatchSchedule::INPUT_ORDER;
+    }
+    else
+    {
+        throw std::invalid_argument("Unknown schedule '" + schedule + "', expected 'trie' or 'input'.");
+    }
+    return options;
+}
+
+// the columns of an event table converted for groupEvents; needs the GIL, grouping does not
+struct EventColumns
+{
+    std::vector<std::string> caseNames;
+    std::vector<int64_t> caseIds;
+    std::vector<int> activityIds;
+    std::span<const int64_t> timestamps;
+};
+
+EventColumns eventColumns(const py::array &cases, const py::array &activities,
+                          const std::optional<std::vector<std::string>> &categories,
+                          const std::optional<py::array_t<int64_t, py::array::c_style | py::array::forcecast>> &timestamps)
+{
+    EventColumns columns;
+    columns.caseIds = caseColumn(cases, columns.caseNames);
+    columns.activityIds = activityColumn(activities, categories);
+    if (timestamps)
+    {
+        columns.timestamps = std::span<const int64_t>(timestamps->data(), static_cast<size_t>(timestamps->size()));
+    }
+    return columns;
+}
+
+py::dict caseResults(const EventLog &log, const std::vector<AlignmentResult> &results, const std::vector<std::string> &caseNames)
+{
+    const auto numCases = static_cast<py::ssize_t>(results.size());
+    py::array_t<int32_t> costs(numCases);
+    py::array_t<int32_t> lowerBounds(numCases);
+    py::array_t<bool> exact(numCases);
+    py::array_t<int64_t> variants(numCases);
+    for (py::ssize_t i = 0; i < numCases; ++i)
+    {
+        costs.mutable_data()[i] = results[i].cost;
+        lowerBounds.mutable_data()[i] = results[i].lowerBound;
+        exact.mutable_data()[i] = results[i].exact;
+        variants.mutable_data()[i] = static_cast<int64_t>(log.caseVariants[i]);
+    }
 
-    if (status == std::future_status::ready)
+    py::dict result;
+    if (caseNames.empty())
     {
-        return result_future.get();
+        result["case"] = py::array_t<int64_t>(numCases, log.caseIds.data());
     }
     else
     {
-        stop_flag.store(true);
-        return -1;
+        py::list names;
+        for (const int64_t caseId : log.caseIds)
+        {
+            names.append(caseNames[caseId]);
+        }
+        result["case"] = names;
+    }
+    result["cost"] = costs;
+    result["lowerBound"] = lowerBounds;
+    result["exact"] = exact;
+    result["variant"] = variants;
+    return result;
+}
+
+void addMemoStats(py::dict &result, const BatchStats &stats)
+{
+    result["memoHits"] = stats.memoHits;
+    result["memoMisses"] = stats.memoMisses;
+    result["memoHitRate"] = stats.memoHitRate();
+    result["memoSkips"] = stats.memoSkips;
+    result["memoSwitchedOff"] = stats.memoSwitchedOff;
+    result["memoEntries"] = stats.memoEntries;
+    result["memoBytes"] = stats.memoBytes;
+}
+
+py::array_t<int64_t> countArray(const std::vector<size_t> &counts, size_t size)
+{
+    py::array_t<int64_t> array(static_cast<py::ssize_t>(size));
+    for (size_t i = 0; i < size; ++i)
+    {
+        array.mutable_data()[i] = i < counts.size() ? static_cast<int64_t>(counts[i]) : 0;
+    }
+    return array;
+}
+
+// per-activity arrays indexed by activity id and per-node arrays in preorder of the tree
+py::dict deviationStats(const std::shared_ptr<TreeNode> &root, const DeviationCounts &counts)
+{
+    const size_t numActivities = std::max({counts.syncMoves.size(), counts.logMoves.size(), counts.modelMoves.size()});
+    py::list activityLabels;
+    for (size_t activity = 0; activity < numActivities; ++activity)
+    {
+        activityLabels.append(activityLabel(static_cast<int>(activity)));
+    }
+
+    const auto positions = preorderPositions(root);
+    std::vector<const TreeNode *> preorder(positions.size());
+    for (const auto &[node, position] : positions)
+    {
+        preorder[position] = node;
+    }
+    py::list nodes;
+    for (const TreeNode *node : preorder)
+    {
+        nodes.append(node->getOperation() == ACTIVITY ? activityLabel(node->getActivity()) : operationToString(node->getOperation()));
+    }
+
+    py::dict result;
+    result["activity"] = activityLabels;
+    result["syncMoves"] = countArray(counts.syncMoves, numActivities);
+    result["logMoves"] = countArray(counts.logMoves, numActivities);
+    result["modelMoves"] = countArray(counts.modelMoves, numActivities);
+    result["unknownLogMoves"] = counts.unknownLogMoves;
+    result["node"] = nodes;
+    result["nodeLogMoves"] = countArray(counts.nodeLogMoves, preorder.size());
+    result["nodeModelMoves"] = countArray(counts.nodeModelMoves, preorder.size());
+    result["traces"] = counts.traces;
+    result["skippedTraces"] = counts.skippedTraces;
+    return result;
+}
+
+py::dict alignEventTable(const AlignmentWrapper &self, const py::array &cases, const py::array &activities,
+                         const std::optional<std::vector<std::string>> &categories,
+                         const std::optional<py::array_t<int64_t, py::array::c_style | py::array::forcecast>> &timestamps,
+                         unsigned threads, const std::string &schedule, size_t maxMemoEntries, int budget, size_t longTraceWindow,
+                         const std::string &memoSnapshot, const std::string &memoPolicy, bool countDeviations)
+{
+    const BatchOptions options = batchOptions(threads, schedule, maxMemoEntries, budget, longTraceWindow, memoSnapshot,
+                                              memoPolicy, countDeviations);
+    const EventColumns columns = eventColumns(cases, activities, categories, timestamps);
+
+    EventLog log;
+    std::vector<AlignmentResult> results;
+    BatchStats stats;
+    {
+        py::gil_scoped_release release;
+        log = groupEvents(columns.caseIds, columns.activityIds, columns.timestamps);
+        results = self.alignLog(log, options, &stats);
+    }
+
+    py::dict result = caseResults(log, results, columns.caseNames);
+    addMemoStats(result, stats);
+    if (countDeviations)
+    {
+        result["deviations"] = deviationStats(self.getTree(), stats.deviations[0]);
+    }
+    return result;
+}
+
+py::dict alignEventTableAgainstModels(const ModelRegistry &registry, const py::array &cases, const py::array &activities,
+                                      const std::optional<std::vector<std::string>> &categories,
+                                      const std::optional<py::array_t<int64_t, py::array::c_style | py::array::forcecast>> &timestamps,
+                                      unsigned threads, const std::string &schedule, size_t maxMemoEntries, int budget,
+                                      int timeoutMs, size_t longTraceWindow, const std::string &memoSnapshot,
+                                      const std::string &memoPolicy, bool countDeviations)
+{
+    BatchOptions options = batchOptions(threads, schedule, maxMemoEntries, budget, longTraceWindow, memoSnapshot,
+                                        memoPolicy, countDeviations);
+    options.timeoutMs = timeoutMs;
+    const EventColumns columns = eventColumns(cases, activities, categories, timestamps);
+
+    EventLog log;
+    std::vector<std::vector<AlignmentResult>> results;
+    std::vector<std::shared_ptr<const ProcessModel>> models;
+    BatchStats stats;
+    {
+        py::gil_scoped_release release;
+        log = groupEvents(columns.caseIds, columns.activityIds, columns.timestamps);
+        results = registry.alignLog(log, options, &models, &stats);
+    }
+
+    py::dict modelResults;
+    for (size_t model = 0; model < models.size(); ++model)
+    {
+        py::dict modelResult = caseResults(log, results[model], columns.caseNames);
+        if (countDeviations)
+        {
+            modelResult["deviations"] = deviationStats(models[model]->root, stats.deviations[model]);
+        }
+        modelResults[py::str(models[model]->name)] = modelResult;
     }
+    py::dict result;
+    result["models"] = modelResults;
+    addMemoStats(result, stats);
+    return result;
+}
+
+py::dict estimateEventTable(const AlignmentWrapper &self, const py::array &cases, const py::array &activities,
+                           const std::optional<std::vector<std::string>> &categories,
+                           const std::optional<py::array_t<int64_t, py::array::c_style | py::array::forcecast>> &timestamps,
+                           unsigned threads, double fitnessWidth, double costWidth, double confidence, int timeBudgetMs,
+                           size_t minSamples, uint64_t seed, size_t maxMemoEntries)
+{
+    BatchOptions options;
+    options.threads = threads;
+    options.maxMemoEntries = maxMemoEntries;
+    EstimateOptions estimate;
+    estimate.fitnessWidth = fitnessWidth;
+    estimate.costWidth = costWidth;
+    estimate.confidence = confidence;
+    estimate.timeBudgetMs = timeBudgetMs;
+    estimate.minSamples = minSamples;
+    estimate.seed = seed;
+    const EventColumns columns = eventColumns(cases, activities, categories, timestamps);
+
+    LogEstimate estimated;
+    BatchStats stats;
+    {
+        py::gil_scoped_release release;
+        const EventLog log = groupEvents(columns.caseIds, columns.activityIds, columns.timestamps);
+        estimated = self.estimateLog(log, options, estimate, &stats);
+    }
+
+    py::dict result;
+    result["meanCost"] = estimated.meanCost;
+    result["costInterval"] = py::make_tuple(estimated.costLow, estimated.costHigh);
+    result["fitness"] = estimated.fitness;
+    result["fitnessInterval"] = py::make_tuple(estimated.fitnessLow, estimated.fitnessHigh);
+    result["samples"] = estimated.samples;
+    result["sampledVariants"] = estimated.sampledVariants;
+    result["inexactSamples"] = estimated.inexactSamples;
+    result["complete"] = estimated.complete;
+    result["converged"] = estimated.converged;
+    result["millis"] = estimated.millis;
+    addMemoStats(result, stats);
+    return result;
 }
 
 PYBIND11_MODULE(alignment, m)
 {
     m.doc() = "Alignment module using pybind11";
 
+    py::class_<AlignmentResult>(m, "AlignmentResult")
+        .def_readonly("cost", &AlignmentResult::cost, "Optimal cost if exact, otherwise the best upper bound found")
+        .def_readonly("lowerBound", &AlignmentResult::lowerBound)
+        .def_readonly("exact", &AlignmentResult::exact)
+        .def("__repr__", [](const AlignmentResult &result)
+             { return "AlignmentResult(cost=" + std::to_string(result.cost) + ", lowerBound=" + std::to_string(result.lowerBound) +
+                      ", exact=" + (result.exact ? "True" : "False") + ")"; });
+
     py::class_<AlignmentWrapper>(m, "AlignmentWrapper")
         .def(py::init<>())
-        .def("loadTree", &AlignmentWrapper::loadTree, "Load a tree from a file path")
-        .def("align", &AlignmentWrapper::align, "Perform alignment and return the cost");
+        .def("loadTree", &AlignmentWrapper::loadTree, py::arg("tree"), py::arg("normalize") = true,
+             py::arg("logMoveCosts") = std::unordered_map<std::string, int>(),
+             py::arg("modelMoveCosts") = std::unordered_map<std::string, int>(),
+             "Load a tree from a file path, normalize flattens nested operators and drops neutral taus. The cost dicts map "
+             "activity labels to positive move costs, missing labels cost 1; with both empty the unit cost kernels are used")
+        .def(
+            "normalizationStats", [](const AlignmentWrapper &self)
+            {
+                const auto &stats = self.getNormalizationStats();
+                return py::make_tuple(stats.nodesBefore, stats.nodesAfter); },
+            "Node count of the last loaded tree before and after normalization")
+        .def("align", &AlignmentWrapper::align, py::call_guard<py::gil_scoped_release>(),
+             "Perform alignment and return the cost, or -1 on timeout")
+        .def(
+            "align", [](const AlignmentWrapper &self, const EncodedTrace &trace)
+            {
+                const auto view = encodedTraceView(trace);
+                py::gil_scoped_release release;
+                return self.alignEncoded(view); },
+            py::arg("trace"), "Align a trace encoded as an int32 array of activity ids (see encode) without copying it")
+        .def("alignAnytime", &AlignmentWrapper::alignAnytime, py::call_guard<py::gil_scoped_release>(),
+             "Perform alignment, returning bounds flagged as approximate on timeout")
+        .def(
+            "alignAnytime", [](const AlignmentWrapper &self, const EncodedTrace &trace)
+            {
+                const auto view = encodedTraceView(trace);
+                py::gil_scoped_release release;
+                return self.alignAnytimeEncoded(view); },
+            py::arg("trace"), "Anytime alignment of a trace encoded as an int32 array of activity ids")
+        .def("alignWithin", &AlignmentWrapper::alignWithin, py::arg("trace"), py::arg("budget"), py::call_guard<py::gil_scoped_release>(),
+             "Decide whether the alignment cost is at most budget: returns the cost if so, otherwise -1 (also on timeout). "
+             "Subproblems that cannot fit into the budget are cut off, so small budgets are much cheaper than align")
+        .def(
+            "alignWithin", [](const AlignmentWrapper &self, const EncodedTrace &trace, int budget)
+            {
+                const auto view = encodedTraceView(trace);
+                py::gil_scoped_release release;
+                return self.alignWithinEncoded(view, budget); },
+            py::arg("trace"), py::arg("budget"), "alignWithin for a trace encoded as an int32 array of activity ids")
+        .def("alignLongTrace", &AlignmentWrapper::alignLongTrace, py::arg("trace"), py::arg("window") = 256,
+             py::call_guard<py::gil_scoped_release>(),
+             "Align a very long trace in pieces of at most window events, so memory does not grow with its length. "
+             "Exact if the tree forces every cut, otherwise the cost is an upper bound flagged as not exact")
+        .def(
+            "alignLongTrace", [](const AlignmentWrapper &self, const EncodedTrace &trace, size_t window)
+            {
+                const auto view = encodedTraceView(trace);
+                py::gil_scoped_release release;
+                return self.alignLongTraceEncoded(view, window); },
+            py::arg("trace"), py::arg("window") = 256, "alignLongTrace for a trace encoded as an int32 array of activity ids")
+        .def(
+            "encode", [](const AlignmentWrapper &, const std::vector<std::string> &labels)
+            {
+                std::vector<int> ids;
+                {
+                    py::gil_scoped_release release;
+                    ids = convertStringTrace(labels);
+                }
+                return py::array_t<int32_t>(static_cast<py::ssize_t>(ids.size()), ids.data()); },
+            py::arg("labels"),
+            "Map activity labels to int32 activity ids, -1 for labels of no loaded tree. Ids are shared by all trees. "
+            "Encoding the categories of a log once allows encoding every trace with numpy indexing.")
+        .def("alignLog", &alignEventTable, py::arg("cases"), py::arg("activities"), py::arg("categories") = py::none(),
+             py::arg("timestamps") = py::none(), py::arg("threads") = 0, py::arg("schedule") = "trie",
+             py::arg("maxMemoEntries") = 2000000, py::arg("budget") = -1, py::arg("longTraceWindow") = 0,
+             py::arg("memoSnapshot") = "", py::arg("memoPolicy") = "static", py::arg("countDeviations") = false,
+             "Group an event table into traces and align every variant once. cases and activities are columns of "
+             "integer codes or strings; integer activities are codes into categories if given, otherwise activity ids "
+             "(see encode). timestamps (int64, e.g. datetime64 values) order the events of a case, row order is used "
+             "without them. schedule 'trie' aligns variants sharing a prefix back-to-back on one worker with a warm memo, "
+             "'input' keeps the input order; maxMemoEntries = 0 clears the memo after every variant. A budget >= 0 only "
+             "screens the log: costs up to budget are exact, larger ones come back inexact with lowerBound above budget. "
+             "Variants longer than a non-zero longTraceWindow are aligned with alignLongTrace. A memoSnapshot path warms "
+             "the memo from the snapshot of an earlier run with the same tree and is rewritten afterwards. memoPolicy 'always' "
+             "memoizes every subproblem, 'static' skips the ones that are cheaper to solve again by node type and "
+             "'adaptive' also switches off memo keys whose measured hits do not pay for their entries. Returns a dict of "
+             "per-case arrays case, cost, lowerBound, exact and variant, plus memoHits, memoMisses, memoHitRate, memoSkips, "
+             "memoSwitchedOff and the memoEntries and memoBytes the workers hold at the end. countDeviations adds "
+             "'deviations', the moves of one optimal alignment per case summed in C++: syncMoves, logMoves and modelMoves "
+             "indexed by activity id with the labels in 'activity', unknownLogMoves for labels not in the tree, "
+             "nodeLogMoves and nodeModelMoves per node in preorder with the labels in 'node', and the traces counted "
+             "and skippedTraces whose alignment is inexact or split by longTraceWindow.")
+        .def("estimateLog", &estimateEventTable, py::arg("cases"), py::arg("activities"), py::arg("categories") = py::none(),
+             py::arg("timestamps") = py::none(), py::arg("threads") = 0, py::arg("fitnessWidth") = 0.01, py::arg("costWidth") = 0.0,
+             py::arg("confidence") = 0.95, py::arg("timeBudgetMs") = 10000, py::arg("minSamples") = 100, py::arg("seed") = 1,
+             py::arg("maxMemoEntries") = 2000000,
+             "Estimate the mean cost and fitness per case of an event table (same columns as alignLog) from a random sample "
+             "of its cases. Cases are drawn until the confidence intervals are at most fitnessWidth and costWidth wide "
+             "(<= 0 ignores one), every variant was drawn, or timeBudgetMs ran out; each drawn variant is aligned once. "
+             "Fitness of a case is 1 - cost / cost of moving every event on the log and running the cheapest path of the "
+             "model. Returns a dict with meanCost, costInterval, fitness, fitnessInterval, samples, sampledVariants, "
+             "inexactSamples, complete (exact bounds over the whole log), converged, millis and the memo stats.")
+        .def("setTimeout", &AlignmentWrapper::setTimeout, py::arg("timeoutMs"), "Set the per-trace alignment timeout in milliseconds, <= 0 disables it")
+        .def("getTimeout", &AlignmentWrapper::getTimeout, "Per-trace alignment timeout in milliseconds");
+
+    py::class_<OnlineAligner>(m, "OnlineAligner")
+        .def(py::init([](const AlignmentWrapper &wrapper, size_t maxMemoEntries, int maxIdleMs)
+                      { return std::make_unique<OnlineAligner>(wrapper.getTree(), maxMemoEntries, std::chrono::milliseconds(maxIdleMs), wrapper.getTimeout()); }),
+             py::arg("aligner"), py::arg("maxMemoEntries") = 1000000, py::arg("maxIdleMs") = 0,
+             "Online conformance checking against the tree currently loaded in aligner")
+        .def("openCase", &OnlineAligner::openCase, "Open a new case and return its id")
+        .def("appendEvent", &OnlineAligner::appendEvent, py::arg("case"), py::arg("activity"), "Append an activity id to a case")
+        .def(
+            "appendEvent", [](OnlineAligner &self, int64_t caseId, const std::string &activity)
+            { self.appendEvent(caseId, convertStringTrace({activity})[0]); },
+            py::arg("case"), py::arg("activity"), "Append an activity label to a case")
+        .def("currentCost", &OnlineAligner::currentCost, py::arg("case"), py::call_guard<py::gil_scoped_release>(),
+             "Alignment of the events appended so far, reusing the memo of the shorter prefixes")
+        .def("closeCase", &OnlineAligner::closeCase, py::arg("case"))
+        .def("evictIdleCases", &OnlineAligner::evictIdleCases, "Drop cases idle for longer than maxIdleMs and return how many")
+        .def("openCases", &OnlineAligner::openCases)
+        .def("memoEntries", &OnlineAligner::memoEntries, py::arg("case"));
+
+    py::class_<AlignmentTask>(m, "AlignmentTask")
+        .def(py::init([](const AlignmentWrapper &wrapper, const std::vector<std::string> &trace, const py::bytes &frames)
+                      { return AlignmentTask(wrapper.getTree(), convertStringTrace(trace), {}, frames); }),
+             py::arg("aligner"), py::arg("trace"), py::arg("frames") = py::bytes(),
+             "Alignment of one trace against the tree currently loaded in aligner that runs in resumable time slices; "
+             "frames of an earlier task of the same trace and tree structure continue where that one stopped")
+        .def(py::init([](const AlignmentWrapper &wrapper, const EncodedTrace &trace, const py::bytes &frames)
+                      {
+                          const auto view = encodedTraceView(trace);
+                          return AlignmentTask(wrapper.getTree(), std::vector<int>(view.begin(), view.end()), {}, frames); }),
+             py::arg("aligner"), py::arg("trace"), py::arg("frames") = py::bytes())
+        .def(
+            "resume", [](AlignmentTask &self, int sliceMs)
+            { return self.resume(std::chrono::milliseconds(sliceMs)); },
+            py::arg("sliceMs"), py::call_guard<py::gil_scoped_release>(),
+            "Continue for at most sliceMs (<= 0 runs to the end), returns True once the cost is exact")
+        .def("done", &AlignmentTask::done)
+        .def("result", &AlignmentTask::result, "Exact once done, otherwise the tightest bounds of the slices so far")
+        .def("slices", &AlignmentTask::slices)
+        .def(
+            "frames", [](const AlignmentTask &self)
+            { return py::bytes(self.suspendedFrames()); },
+            "The subproblems in progress, to continue the task elsewhere");
+
+    py::class_<ModelRegistry>(m, "ModelRegistry")
+        .def(py::init<>())
+        .def(
+            "load", [](ModelRegistry &self, const std::string &name, const std::string &tree, bool normalize)
+            {
+                const auto model = self.load(name, tree, normalize);
+                return py::make_tuple(model->normalization.nodesBefore, model->normalization.nodesAfter); },
+            py::arg("name"), py::arg("tree"), py::arg("normalize") = true,
+            "Load a tree under name, replacing a model with that name; returns the node counts before and after normalization")
+        .def("unload", &ModelRegistry::unload, py::arg("name"), "Release a model, returns False if no model has that name")
+        .def(
+            "models", [](const ModelRegistry &self)
+            {
+                std::vector<std::string> names;
+                for (const auto &model : self.models())
+                {
+                    names.push_back(model->name);
+                }
+                return names; },
+            "Names of the loaded models in load order")
+        .def("alignLog", &alignEventTableAgainstModels, py::arg("cases"), py::arg("activities"), py::arg("categories") = py::none(),
+             py::arg("timestamps") = py::none(), py::arg("threads") = 0, py::arg("schedule") = "trie",
+             py::arg("maxMemoEntries") = 2000000, py::arg("budget") = -1, py::arg("timeoutMs") = 60000,
+             py::arg("longTraceWindow") = 0, py::arg("memoSnapshot") = "", py::arg("memoPolicy") = "static",
+             py::arg("countDeviations") = false,
+             "Like AlignmentWrapper.alignLog, but groups and encodes the log once and aligns every variant against every "
+             "loaded model. Returns {'models': {name: per-case dict}} plus the memo stats of alignLog, with the deviations "
+             "of each model in its per-case dict; "
+             "the models share one memo per worker, so common subtrees are aligned once, and maxMemoEntries applies to it.");
+
+    m.def("startTracing", &startTraceEvents, py::arg("thresholdMicros") = 0, py::arg("maxEvents") = 1000000,
+          "Record dynAlign spans lasting at least thresholdMicros as Chrome trace events");
+    m.def("stopTracing", &stopTraceEvents, "Stop recording dynAlign spans");
+    m.def("writeTrace", &writeTraceEvents, py::arg("path"), "Write the recorded spans as Chrome/Perfetto trace-event JSON");
 }
\ No newline at end of file
@@ -1,8 +1,14 @@
 #ifndef BINDINGS_H
 #define BINDINGS_H
+#include "batchAlignment.h"
+#include "eventLog.h"
 #include "parser.h"
+#include "treeAlignment.h"
+#include "treeNormalization.h"
 #include <memory>
+#include <span>
 #include <string>
+#include <unordered_map>
 #include <pybind11/stl.h>
 
 
@@ -10,13 +16,52 @@ class AlignmentWrapper
 {
 private:
     std::shared_ptr<TreeNode> processTree;
+    // null aligns with unit costs
+    std::shared_ptr<const CostModel> costModel;
+    int timeoutMs;
+    NormalizationStats normalizationStats;
 
 public:
     AlignmentWrapper();
 
     int align(const std::vector<std::string> newTrace) const;
 
-    void loadTree(std::string treePath);
+    // aligns a trace that is already encoded with the activity ids of the loaded tree
+    int alignEncoded(std::span<const int> trace) const;
+
+    AlignmentResult alignAnytime(const std::vector<std::string> newTrace) const;
+
+    AlignmentResult alignAnytimeEncoded(std::span<const int> trace) const;
+
+    // the cost if it is at most budget, -1 if it is larger or the timeout hit
+    int alignWithin(const std::vector<std::string> newTrace, int budget) const;
+
+    int alignWithinEncoded(std::span<const int> trace, int budget) const;
+
+    // splits the trace along the tree so that no piece is longer than window, see longTraceAlignment.h
+    // @throws std::invalid_argument if the tree was loaded with move costs
+    AlignmentResult alignLongTrace(const std::vector<std::string> newTrace, size_t window) const;
+
+    AlignmentResult alignLongTraceEncoded(std::span<const int> trace, size_t window) const;
+
+    // one result per case of the log, parallel to log.caseIds; the timeout of the wrapper overrides the one in options
+    std::vector<AlignmentResult> alignLog(const EventLog &log, BatchOptions options, BatchStats *stats) const;
+
+    // estimates the mean cost and fitness of the log from a sample of its cases, see estimateLog in batchAlignment.h
+    LogEstimate estimateLog(const EventLog &log, BatchOptions options, const EstimateOptions &estimate, BatchStats *stats) const;
+
+    void setTimeout(int newTimeoutMs);
+
+    int getTimeout() const;
+
+    // normalize flattens the parsed tree before alignment, costs are the same either way. Labels missing from the
+    // cost maps cost 1, and with both maps empty the tree is aligned with the unit cost kernels
+    void loadTree(std::string treePath, bool normalize = true, const std::unordered_map<std::string, int> &logMoveCosts = {},
+                  const std::unordered_map<std::string, int> &modelMoveCosts = {});
+
+    const NormalizationStats &getNormalizationStats() const;
+
+    std::shared_ptr<TreeNode> getTree() const;
 
 };
 
@@ -0,0 +1,175 @@
+#include "costModel.h"
+#include "parser.h"
+#include "traceView.h"
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+
+// tags the memo keys of weighted subtrees, subtree structures start with their operation instead
+constexpr int weightedKeyTag = -1;
+
+void setCost(std::vector<int> &costs, int activity, int cost)
+{
+    if (activity >= static_cast<int>(costs.size()))
+    {
+        costs.resize(activity + 1, 1);
+    }
+    costs[activity] = cost;
+}
+
+int lookupCost(const std::vector<int> &costs, int activity)
+{
+    return activity >= 0 && activity < static_cast<int>(costs.size()) ? costs[activity] : 1;
+}
+
+// the activities and costs of both tables, leaving out the default cost of 1 so that padding does not matter
+uint64_t fingerprintWeights(const std::vector<int> &logMoveCosts, const std::vector<int> &modelMoveCosts)
+{
+    std::vector<int> weights;
+    for (const auto *costs : {&logMoveCosts, &modelMoveCosts})
+    {
+        for (size_t activity = 0; activity < costs->size(); ++activity)
+        {
+            if ((*costs)[activity] != 1)
+            {
+                weights.push_back(static_cast<int>(activity));
+                weights.push_back((*costs)[activity]);
+            }
+        }
+        weights.push_back(-1);
+    }
+    return fingerprint(weights);
+}
+
+/**
+ * Builds the cost tables of a tree. Model move costs apply to every leaf with the label, including leaves whose
+ * label occurs earlier in the tree as well; log move costs apply to the events with the label.
+ *
+ * @param root Root of the tree the model is used with, already normalized if it will be
+ * @param logMoveCosts Label -> cost of a log move of an event with that label
+ * @param modelMoveCosts Label -> cost of a model move of a leaf with that label
+ * @throws std::invalid_argument if a cost is not positive, since then a trace could cost 0 without fitting
+ */
+CostModel::CostModel(const std::shared_ptr<TreeNode> &root, const std::unordered_map<std::string, int> &logMoveCosts,
+                     const std::unordered_map<std::string, int> &modelMoveCosts)
+{
+    for (const auto *costs : {&logMoveCosts, &modelMoveCosts})
+    {
+        for (const auto &[label, cost] : *costs)
+        {
+            if (cost <= 0)
+            {
+                throw std::invalid_argument("Move costs must be positive, '" + label + "' costs " + std::to_string(cost) + ".");
+            }
+        }
+    }
+
+    for (const auto &[label, cost] : logMoveCosts)
+    {
+        setCost(this->logMoveCosts, registerActivity(label), cost);
+    }
+
+    std::vector<const TreeNode *> stack = {root.get()};
+    while (!stack.empty())
+    {
+        const TreeNode *node = stack.back();
+        stack.pop_back();
+        if (node->getOperation() == ACTIVITY)
+        {
+            const auto it = modelMoveCosts.find(activityLabel(node->getActivity()));
+            if (it != modelMoveCosts.end())
+            {
+                setCost(this->modelMoveCosts, node->getActivity(), it->second);
+            }
+        }
+        for (const auto &child : node->getChildren())
+        {
+            stack.push_back(child.get());
+        }
+    }
+
+    weightsFingerprint = fingerprintWeights(this->logMoveCosts, this->modelMoveCosts);
+    indexSubtree(*root);
+}
+
+// interned like the structures of subtrees, so a key is made once per set of weights and subtree structure
+int weightedMemoKey(uint64_t weightsFingerprint, const TreeNode &node)
+{
+    return internSubtree({weightedKeyTag, static_cast<int>(weightsFingerprint >> 32), static_cast<int>(weightsFingerprint & 0xffffffff),
+                          node.getMemoKey()});
+}
+
+// children first, so every minimum is computed from the table
+void CostModel::indexSubtree(const TreeNode &node)
+{
+    if (minModelCosts.count(node.getMemoKey()))
+    {
+        return;
+    }
+    for (const auto &child : node.getChildren())
+    {
+        indexSubtree(*child);
+    }
+    if (node.getLoopHelper())
+    {
+        indexSubtree(*node.getLoopHelper());
+    }
+    minModelCosts[node.getMemoKey()] = computeMinModelCost(node);
+    memoKeys[node.getMemoKey()] = weightedMemoKey(weightsFingerprint, node);
+}
+
+int CostModel::logMove(int activity) const
+{
+    return lookupCost(logMoveCosts, activity);
+}
+
+int CostModel::modelMove(int activity) const
+{
+    return lookupCost(modelMoveCosts, activity);
+}
+
+int CostModel::computeMinModelCost(const TreeNode &node) const
+{
+    const auto &children = node.getChildren();
+    switch (node.getOperation())
+    {
+    case ACTIVITY:
+        return modelMove(node.getActivity());
+    case SILENT_ACTIVITY:
+        return 0;
+    case XOR:
+    {
+        int cost = children.empty() ? 0 : std::numeric_limits<int>::max();
+        for (const auto &child : children)
+        {
+            cost = std::min(cost, minModelCost(*child));
+        }
+        return cost;
+    }
+    case REDO_LOOP:
+    case XOR_LOOP:
+        return children.empty() ? 0 : minModelCost(*children[0]);
+    default:
+    {
+        int cost = 0;
+        for (const auto &child : children)
+        {
+            cost += minModelCost(*child);
+        }
+        return cost;
+    }
+    }
+}
+
+// subtrees built during the alignment, like the pieces of alignLongTrace, are not in the tables and computed on demand
+int CostModel::minModelCost(const TreeNode &node) const
+{
+    const auto it = minModelCosts.find(node.getMemoKey());
+    return it != minModelCosts.end() ? it->second : computeMinModelCost(node);
+}
+
+int CostModel::memoKey(const TreeNode &node) const
+{
+    const auto it = memoKeys.find(node.getMemoKey());
+    return it != memoKeys.end() ? it->second : weightedMemoKey(weightsFingerprint, node);
+}
@@ -0,0 +1,46 @@
+#ifndef COSTMODEL_H
+#define COSTMODEL_H
+#include "treeNode.h"
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Per-activity move costs, for logs in which some deviations matter more than others. Synchronous moves and taus
+// stay free, and an activity missing from the tables costs 1 per move like in the default unit costs. A cost model
+// belongs to the tree it was built for: it precomputes the cheapest runs and memo keys of the subtrees.
+class CostModel
+{
+public:
+    CostModel(const std::shared_ptr<TreeNode> &root, const std::unordered_map<std::string, int> &logMoveCosts,
+              const std::unordered_map<std::string, int> &modelMoveCosts);
+
+    // cost of an event that no activity of the run matches
+    int logMove(int activity) const;
+
+    // cost of an activity of the run that no event matches
+    int modelMove(int activity) const;
+
+    // weighted getMinModelCost
+    int minModelCost(const TreeNode &node) const;
+
+    // the same subtree costs differently under different weights, so each set of weights gets its own memo partitions;
+    // models with equal weights, e.g. the same tree loaded again, share them
+    int memoKey(const TreeNode &node) const;
+
+private:
+    void indexSubtree(const TreeNode &node);
+
+    int computeMinModelCost(const TreeNode &node) const;
+
+    // of the weights that differ from the default
+    uint64_t weightsFingerprint;
+    std::vector<int> logMoveCosts;
+    std::vector<int> modelMoveCosts;
+    // both by the memo key of the subtree
+    std::unordered_map<int, int> minModelCosts;
+    std::unordered_map<int, int> memoKeys;
+};
+
+#endif // COSTMODEL_H
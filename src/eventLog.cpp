@@ -0,0 +1,95 @@
+#include "eventLog.h"
+#include "treeNode.h"
+#include <algorithm>
+#include <stdexcept>
+#include <unordered_map>
+
+using VariantIndex = std::unordered_map<std::vector<int>, size_t, SpanHash, SpanEqual>;
+
+// appends a case, identical traces share one variant
+void addCase(EventLog &log, VariantIndex &variantIndex, const std::vector<int> &trace)
+{
+    const auto it = variantIndex.find(std::span<const int>(trace));
+    if (it != variantIndex.end())
+    {
+        log.caseVariants.push_back(it->second);
+        log.variantFrequencies[it->second]++;
+        return;
+    }
+
+    const size_t variant = log.variants.size();
+    variantIndex.emplace(trace, variant);
+    log.variants.push_back(trace);
+    log.variantFrequencies.push_back(1);
+    log.caseVariants.push_back(variant);
+}
+
+/**
+ * Groups a columnar event table into traces, i.e. what a groupby on the case column
+ * followed by a sort on the timestamp column does in pandas
+ *
+ * @param caseIds Case id of every event
+ * @param activities Encoded activity of every event
+ * @param timestamps Optional timestamp of every event; without them the row order is the event order
+ * @return The log with one variant per distinct trace
+ * @throws std::invalid_argument if the columns differ in length
+ */
+EventLog groupEvents(std::span<const int64_t> caseIds, std::span<const int> activities, std::span<const int64_t> timestamps)
+{
+    if (caseIds.size() != activities.size() || (!timestamps.empty() && timestamps.size() != caseIds.size()))
+    {
+        throw std::invalid_argument("Case, activity and timestamp columns must have the same length.");
+    }
+
+    EventLog log;
+    std::unordered_map<int64_t, size_t> caseIndex;
+    std::vector<std::vector<size_t>> caseEvents;
+
+    for (size_t event = 0; event < caseIds.size(); ++event)
+    {
+        const auto [it, inserted] = caseIndex.try_emplace(caseIds[event], caseEvents.size());
+        if (inserted)
+        {
+            log.caseIds.push_back(caseIds[event]);
+            caseEvents.emplace_back();
+        }
+        caseEvents[it->second].push_back(event);
+    }
+
+    VariantIndex variantIndex;
+    log.caseVariants.reserve(caseEvents.size());
+    std::vector<int> trace;
+
+    for (auto &events : caseEvents)
+    {
+        if (!timestamps.empty())
+        {
+            // stable so that events with equal timestamps keep their row order
+            std::stable_sort(events.begin(), events.end(), [&timestamps](size_t lhs, size_t rhs)
+                             { return timestamps[lhs] < timestamps[rhs]; });
+        }
+
+        trace.clear();
+        for (const size_t event : events)
+        {
+            trace.push_back(activities[event]);
+        }
+        addCase(log, variantIndex, trace);
+    }
+
+    return log;
+}
+
+EventLog groupTraces(const std::vector<std::vector<int>> &traces)
+{
+    EventLog log;
+    VariantIndex variantIndex;
+    log.caseIds.reserve(traces.size());
+    log.caseVariants.reserve(traces.size());
+    for (size_t trace = 0; trace < traces.size(); ++trace)
+    {
+        log.caseIds.push_back(static_cast<int64_t>(trace));
+        addCase(log, variantIndex, traces[trace]);
+    }
+    return log;
+}
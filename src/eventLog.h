@@ -0,0 +1,25 @@
+#ifndef EVENTLOG_H
+#define EVENTLOG_H
+#include <cstdint>
+#include <span>
+#include <vector>
+
+// Event log grouped into traces. Identical traces (variants) are stored and aligned only once.
+struct EventLog
+{
+    // encoded activity sequence of every variant
+    std::vector<std::vector<int>> variants;
+    // number of cases per variant
+    std::vector<size_t> variantFrequencies;
+    // case ids in the order of their first event
+    std::vector<int64_t> caseIds;
+    // variant index of every case, parallel to caseIds
+    std::vector<size_t> caseVariants;
+};
+
+EventLog groupEvents(std::span<const int64_t> caseIds, std::span<const int> activities, std::span<const int64_t> timestamps = {});
+
+// Groups whole traces, the case id of a trace is its index; unlike an event table this keeps empty traces
+EventLog groupTraces(const std::vector<std::vector<int>> &traces);
+
+#endif // EVENTLOG_H
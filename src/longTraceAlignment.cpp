@@ -0,0 +1,326 @@
+#include "longTraceAlignment.h"
+#include "parser.h"
+#include "perfectFit.h"
+#include <algorithm>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+// lower bound of a subtree that ignores the order of the events: every visible activity of the cheapest run
+// that has no event left to match is a model move
+int unorderedLowerBound(const TreeNode &node, std::span<const int> trace)
+{
+    return std::max(0, node.getMinModelCost() - static_cast<int>(trace.size()));
+}
+
+void addBounds(AlignmentResult &sum, const AlignmentResult &part)
+{
+    sum.cost += part.cost;
+    sum.lowerBound += part.lowerBound;
+}
+
+// operator node over existing subtrees, for pieces of the trace that no node of the tree covers on its own
+std::shared_ptr<TreeNode> buildNode(Operation operation, std::vector<std::shared_ptr<TreeNode>> children)
+{
+    auto node = std::make_shared<TreeNode>(operation, 0);
+    node->setChildren(std::move(children));
+    node->fillActivityMaps();
+    if (operation == REDO_LOOP)
+    {
+        node->setLoopHelper(createLoopHelper(node));
+    }
+    return node;
+}
+
+// state of one alignLongTrace call
+struct LongTraceSplitter
+{
+    size_t window;
+    Deadline &deadline;
+
+    /**
+     * Aligns a subtree with a trace of any length. The events outside the subtree are log moves
+     * wherever the cuts go, only the projection is split further.
+     *
+     * @param node Root of the subtree
+     * @param trace Events to align, may contain activities of other subtrees
+     * @return Bounds on the cost, exact if they are equal
+     */
+    AlignmentResult align(const std::shared_ptr<TreeNode> &node, std::span<const int> trace)
+    {
+        const auto &activities = node->getActivities();
+        std::vector<int> projected;
+        projected.reserve(trace.size());
+        for (const int activity : trace)
+        {
+            if (activities.count(activity))
+            {
+                projected.push_back(activity);
+            }
+        }
+        const int aliens = static_cast<int>(trace.size() - projected.size());
+
+        AlignmentResult result;
+        // the closed forms of the leaf shapes are cheap at any length
+        if (projected.size() <= window || node->getShape() != NodeShape::GENERIC)
+        {
+            result = alignPiece(node, projected);
+        }
+        else
+        {
+            switch (node->getOperation())
+            {
+            case SEQUENCE:
+                result = alignSequence(node, projected);
+                break;
+            case PARALLEL:
+            {
+                // the children of a parallel only see their own events
+                std::vector<std::vector<int>> childTraces(node->getChildren().size());
+                for (const int activity : projected)
+                {
+                    childTraces[node->childIndexOf(activity)].push_back(activity);
+                }
+                result = {0, 0, false};
+                for (size_t i = 0; i < childTraces.size(); ++i)
+                {
+                    addBounds(result, align(node->getChildren()[i], childTraces[i]));
+                }
+                break;
+            }
+            case XOR:
+                result = align(node->getChildren()[0], projected);
+                for (size_t i = 1; i < node->getChildren().size(); ++i)
+                {
+                    const auto option = align(node->getChildren()[i], projected);
+                    result.cost = std::min(result.cost, option.cost);
+                    result.lowerBound = std::min(result.lowerBound, option.lowerBound);
+                }
+                break;
+            case REDO_LOOP:
+                result = alignLoop(node, projected);
+                break;
+            default:
+                result = alignPiece(node, projected);
+                break;
+            }
+        }
+
+        result.cost += aliens;
+        result.lowerBound += aliens;
+        result.exact = result.cost == result.lowerBound;
+        return result;
+    }
+
+    // exact alignment of a piece of at most window events; a fresh memo bounds the memory by the window
+    // and leaves the memo of the thread alone
+    AlignmentResult alignPiece(const std::shared_ptr<TreeNode> &node, std::span<const int> piece)
+    {
+        CostTable memo;
+        std::swap(costTable, memo);
+        AlignmentResult result;
+        try
+        {
+            result = alignAnytime(node, piece, deadline);
+        }
+        catch (...)
+        {
+            std::swap(costTable, memo);
+            throw;
+        }
+        std::swap(costTable, memo);
+        return result;
+    }
+
+    /**
+     * Splits a long trace of a sequence at the forced cuts: if all events of the children up to some child come
+     * before all events of the children after it, every alignment can put the cut between them. Each group of
+     * children between two forced cuts gets its own piece of the trace.
+     *
+     * @param node Sequence node
+     * @param trace Events of the subtree only
+     * @return Bounds on the cost
+     */
+    AlignmentResult alignSequence(const std::shared_ptr<TreeNode> &node, std::span<const int> trace)
+    {
+        const auto &children = node->getChildren();
+        const size_t k = children.size();
+        const size_t n = trace.size();
+
+        // lastEvent[j]: last position of an event of children 0..j, firstEvent[j]: first position of children j..k-1
+        std::vector<long> lastEvent(k, -1);
+        std::vector<size_t> firstEvent(k + 1, n);
+        for (size_t i = 0; i < n; ++i)
+        {
+            const int child = node->childIndexOf(trace[i]);
+            lastEvent[child] = static_cast<long>(i);
+            firstEvent[child] = std::min(firstEvent[child], i);
+        }
+        for (size_t j = 1; j < k; ++j)
+        {
+            lastEvent[j] = std::max(lastEvent[j], lastEvent[j - 1]);
+        }
+        for (size_t j = k; j-- > 0;)
+        {
+            firstEvent[j] = std::min(firstEvent[j], firstEvent[j + 1]);
+        }
+
+        AlignmentResult result = {0, 0, false};
+        size_t groupStart = 0;
+        size_t pieceStart = 0;
+        for (size_t j = 0; j < k; ++j)
+        {
+            if (j + 1 < k && lastEvent[j] >= static_cast<long>(firstEvent[j + 1]))
+            {
+                continue;
+            }
+            const size_t pieceEnd = firstEvent[j + 1];
+            addBounds(result, alignGroup(node, groupStart, j, trace.subspan(pieceStart, pieceEnd - pieceStart)));
+            groupStart = j + 1;
+            pieceStart = pieceEnd;
+        }
+        return result;
+    }
+
+    // aligns the children first..last of a sequence with the piece of the trace between their forced cuts
+    AlignmentResult alignGroup(const std::shared_ptr<TreeNode> &node, size_t first, size_t last, std::span<const int> piece)
+    {
+        const auto &children = node->getChildren();
+        if (first == last)
+        {
+            return align(children[first], piece);
+        }
+
+        const auto group = first == 0 && last + 1 == children.size()
+                               ? node
+                               : buildNode(SEQUENCE, {children.begin() + first, children.begin() + last + 1});
+        if (piece.size() <= window)
+        {
+            return alignPiece(group, piece);
+        }
+        return alignInterleaved(group, piece);
+    }
+
+    /**
+     * Approximates a long piece of a sequence whose children interleave. Every cut between two children goes where
+     * the fewest events end up on the wrong side of it, those become log moves, and each child is aligned with its
+     * part. That is an alignment, so the cost is an upper bound.
+     *
+     * @param node Sequence node
+     * @param trace Events of the subtree only
+     * @return Upper bound and a lower bound that ignores the event order
+     */
+    AlignmentResult alignInterleaved(const std::shared_ptr<TreeNode> &node, std::span<const int> trace)
+    {
+        const auto &children = node->getChildren();
+        const size_t k = children.size();
+        const size_t n = trace.size();
+
+        std::vector<int> childOf(n);
+        std::vector<size_t> childEvents(k, 0);
+        for (size_t i = 0; i < n; ++i)
+        {
+            childOf[i] = node->childIndexOf(trace[i]);
+            childEvents[childOf[i]]++;
+        }
+
+        std::vector<size_t> cuts(k + 1, 0);
+        cuts[k] = n;
+        size_t eventsBefore = 0;
+        for (size_t j = 1; j < k; ++j)
+        {
+            // events of children before j behind the cut plus events of later children in front of it
+            eventsBefore += childEvents[j - 1];
+            size_t wrong = eventsBefore;
+            size_t fewestWrong = wrong;
+            size_t bestCut = 0;
+            for (size_t s = 1; s <= n; ++s)
+            {
+                if (childOf[s - 1] < static_cast<int>(j))
+                {
+                    wrong--;
+                }
+                else
+                {
+                    wrong++;
+                }
+                if (wrong < fewestWrong)
+                {
+                    fewestWrong = wrong;
+                    bestCut = s;
+                }
+            }
+            cuts[j] = std::max(bestCut, cuts[j - 1]);
+        }
+
+        AlignmentResult result = {0, 0, false};
+        for (size_t j = 0; j < k; ++j)
+        {
+            result.cost += align(children[j], trace.subspan(cuts[j], cuts[j + 1] - cuts[j])).cost;
+            result.lowerBound += std::max(0, children[j]->getMinModelCost() - static_cast<int>(childEvents[j]));
+        }
+        return result;
+    }
+
+    /**
+     * Approximates a long trace of a loop *(do, redo). The first chunk is aligned with the loop and every later
+     * chunk with (redo do)+, so the chunks together are a run of the loop and the summed cost is an upper bound.
+     * Chunks end where a redo part starts if possible, which keeps iterations in one piece.
+     *
+     * @param node Loop node
+     * @param trace Events of the subtree only
+     * @return Upper bound and a lower bound that ignores the event order
+     */
+    AlignmentResult alignLoop(const std::shared_ptr<TreeNode> &node, std::span<const int> trace)
+    {
+        const auto &redoActivities = node->getChildren()[1]->getActivities();
+        auto iteration = node->getLoopHelper();
+        if (!iteration)
+        {
+            iteration = createLoopHelper(node);
+        }
+        const auto repetitions = buildNode(REDO_LOOP, {iteration, std::make_shared<TreeNode>(SILENT_ACTIVITY, 0)});
+
+        const size_t n = trace.size();
+        AlignmentResult result = {0, unorderedLowerBound(*node, trace), false};
+        for (size_t start = 0; start < n;)
+        {
+            size_t end = std::min(n, start + window);
+            for (size_t cut = end; end < n && cut > start + window / 2; --cut)
+            {
+                if (redoActivities.count(trace[cut]) && !redoActivities.count(trace[cut - 1]))
+                {
+                    end = cut;
+                    break;
+                }
+            }
+            result.cost += alignPiece(start == 0 ? node : repetitions, trace.subspan(start, end - start)).cost;
+            start = end;
+        }
+        return result;
+    }
+};
+
+/**
+ * Aligns a trace of any length with memory bounded by the window, see longTraceAlignment.h
+ *
+ * @param root Root of the process tree
+ * @param trace Encoded trace
+ * @param window Longest piece that is aligned in one go
+ * @param deadline Shared by all pieces; pieces aligned after it expired contribute their bounds
+ * @return Exact cost if every cut was forced, otherwise an upper and a lower bound
+ * @throws std::invalid_argument if window is 0
+ */
+AlignmentResult alignLongTrace(const std::shared_ptr<TreeNode> &root, std::span<const int> trace, size_t window, Deadline &deadline)
+{
+    if (window == 0)
+    {
+        throw std::invalid_argument("The window of a long trace alignment must hold at least one event.");
+    }
+    if (fitsPerfectly(*root, trace))
+    {
+        return {0, 0, true};
+    }
+    LongTraceSplitter splitter{window, deadline};
+    return splitter.align(root, trace);
+}
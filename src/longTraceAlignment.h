@@ -0,0 +1,18 @@
+#ifndef LONGTRACEALIGNMENT_H
+#define LONGTRACEALIGNMENT_H
+#include "treeAlignment.h"
+#include "treeNode.h"
+#include <memory>
+#include <span>
+
+// Alignment for traces too long for dynAlign, e.g. stuck cases with thousands of events. The trace is split along
+// the tree where the tree forces a cut and only pieces of at most window events are aligned, each with a fresh memo,
+// so the memory used never depends on the trace length.
+//
+// Parallels and choices always split exactly, a sequence splits exactly between two children if all events of the
+// first come before all events of the second. The result is exact if every piece that is left is short enough.
+// Otherwise a long piece under a loop, or under a sequence whose children interleave, is cut into chunks that are
+// aligned one by one: that gives an upper bound and the result is flagged as not exact.
+AlignmentResult alignLongTrace(const std::shared_ptr<TreeNode> &root, std::span<const int> trace, size_t window, Deadline &deadline);
+
+#endif // LONGTRACEALIGNMENT_H
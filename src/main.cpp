@@ -1,10 +1,362 @@
 #include <memory.h>
 #include <string>
 #include <iostream>
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+#include <pthread.h>
+#include <signal.h>
+#include <spawn.h>
+#include <sys/wait.h>
+#include "alignmentServer.h"
 #include "parser.h"
+#include "shardedAlignment.h"
+#include "treeNormalization.h"
+
+extern char **environ;
+
+const char *usage =
+    "usage:\n"
+    "  process-tree-alignments-cpp align <tree> <traces> <output> [options]\n"
+    "  process-tree-alignments-cpp shard <tree> <traces> <shard> <shards> <partial> [options]\n"
+    "  process-tree-alignments-cpp merge <output> <partial>...\n"
+    "  process-tree-alignments-cpp launch <tree> <traces> <shards> <output> [options]\n"
+    "  process-tree-alignments-cpp serve <socket> [options]\n"
+    "  process-tree-alignments-cpp estimate <tree> <traces> [options]\n"
+    "\n"
+    "<tree> holds a process tree string, <traces> one case per line: the case id and its activities, tab separated.\n"
+    "shard aligns the cases whose variant hash falls into one of <shards> shards and writes a partial result;\n"
+    "the shards may run on different machines sharing a filesystem. merge combines the partial results of all\n"
+    "shards into one result in trace file order. launch runs every shard as a local process and merges them.\n"
+    "serve runs a daemon on a Unix domain socket that keeps its models loaded and its memos warm until it gets\n"
+    "SHUTDOWN, SIGINT or SIGTERM; see alignmentServer.h for the protocol and scripts/alignment_client.py for a client.\n"
+    "estimate aligns randomly drawn cases until the confidence intervals on mean cost and fitness are narrow enough.\n"
+    "\n"
+    "options:\n"
+    "  --threads N   threads per process, 0 uses all cores (launch divides them between the shards)\n"
+    "  --timeout MS  per variant, <= 0 disables it (default 60000)\n"
+    "  --budget K    only decide whether each case costs at most K\n"
+    "  --window N    split traces longer than N events along the tree, exact only where the tree forces the cuts\n"
+    "  --batch N     serve: queued alignments a worker takes at once (default 64)\n"
+    "  --snapshot F  warm the memo from the snapshot F of an earlier run with the same tree and update it afterwards\n"
+    "                (launch keeps one snapshot per shard next to F)\n"
+    "  --memo P      which subproblems use the memo: always, static (default: skips the ones that are cheaper to\n"
+    "                solve again by node type) or adaptive (also measures hit rates and compute times per node)\n"
+    "  --width W     estimate: width of the 95% interval on the mean fitness to stop at (default 0.01)\n"
+    "  --time MS     estimate: time budget, <= 0 only stops on the width (default 10000)\n";
+
+struct CommandLine
+{
+    std::vector<std::string> positional;
+    BatchOptions options;
+    bool threadsGiven = false;
+    size_t maxBatch = 64;
+    EstimateOptions estimate;
+    // as given, for the shard workers
+    std::string memoPolicy = "static";
+};
+
+CommandLine parseCommandLine(int argc, char *argv[])
+{
+    CommandLine commandLine;
+    for (int i = 2; i < argc; ++i)
+    {
+        const std::string argument = argv[i];
+        if (argument.rfind("--", 0) != 0)
+        {
+            commandLine.positional.push_back(argument);
+            continue;
+        }
+        if (i + 1 >= argc)
+        {
+            throw std::invalid_argument("Option " + argument + " needs a value.");
+        }
+        if (argument == "--snapshot")
+        {
+            commandLine.options.memoSnapshot = argv[++i];
+            continue;
+        }
+        if (argument == "--memo")
+        {
+            commandLine.options.memoPolicy = parseMemoPolicy(argv[++i]);
+            commandLine.memoPolicy = argv[i];
+            continue;
+        }
+        if (argument == "--width")
+        {
+            commandLine.estimate.fitnessWidth = std::stod(argv[++i]);
+            continue;
+        }
+        const int value = std::stoi(argv[++i]);
+        if (argument == "--threads")
+        {
+            commandLine.options.threads = static_cast<unsigned>(std::max(0, value));
+            commandLine.threadsGiven = true;
+        }
+        else if (argument == "--timeout")
+        {
+            commandLine.options.timeoutMs = value;
+        }
+        else if (argument == "--budget")
+        {
+            commandLine.options.budget = value;
+        }
+        else if (argument == "--window")
+        {
+            commandLine.options.longTraceWindow = static_cast<size_t>(std::max(0, value));
+        }
+        else if (argument == "--time")
+        {
+            commandLine.estimate.timeBudgetMs = value;
+        }
+        else if (argument == "--batch")
+        {
+            commandLine.maxBatch = static_cast<size_t>(std::max(1, value));
+        }
+        else
+        {
+            throw std::invalid_argument("Unknown option " + argument + ".");
+        }
+    }
+    return commandLine;
+}
+
+std::string readTree(const std::string &path)
+{
+    std::ifstream input(path);
+    if (!input)
+    {
+        throw std::runtime_error("Cannot open tree file " + path + ".");
+    }
+    std::stringstream content;
+    content << input.rdbuf();
+    std::string tree = content.str();
+    while (!tree.empty() && std::isspace(static_cast<unsigned char>(tree.back())))
+    {
+        tree.pop_back();
+    }
+    return tree;
+}
+
+void printStats(const MergedResult &merged)
+{
+    const auto &stats = merged.stats;
+    std::cout << "cases " << stats.cases << " (variants " << stats.variants << ", fitting " << stats.fitting << ", exact " << stats.exact << ")\n"
+              << "total cost " << stats.totalCost << "\n"
+              << "memo hit rate " << stats.memoHitRate() << ", skipped " << stats.memoSkips << ", held " << stats.memoBytes / 1024 << " KiB\n"
+              << "alignment time " << stats.millis << " ms over " << merged.shards << " shards, slowest shard " << merged.maxShardMillis << " ms\n";
+}
+
+size_t parseCount(const std::string &value, const std::string &what)
+{
+    const long long count = std::stoll(value);
+    if (count < 0)
+    {
+        throw std::invalid_argument(what + " must not be negative.");
+    }
+    return static_cast<size_t>(count);
+}
+
+// starts the shard workers as copies of this executable and waits for all of them
+void runShardProcesses(const std::string &executable, const CommandLine &commandLine, size_t shards, unsigned threadsPerShard)
+{
+    const auto &arguments = commandLine.positional;
+    std::vector<pid_t> workers;
+    for (size_t shard = 0; shard < shards; ++shard)
+    {
+        std::vector<std::string> workerArguments = {
+            executable, "shard", arguments[0], arguments[1], std::to_string(shard), std::to_string(shards),
+            partialResultPath(arguments[3], shard, shards),
+            "--threads", std::to_string(threadsPerShard),
+            "--timeout", std::to_string(commandLine.options.timeoutMs),
+            "--budget", std::to_string(commandLine.options.budget),
+            "--window", std::to_string(commandLine.options.longTraceWindow),
+            "--memo", commandLine.memoPolicy};
+        if (!commandLine.options.memoSnapshot.empty())
+        {
+            // a variant always lands in the same shard, so every shard keeps warming its own snapshot
+            workerArguments.push_back("--snapshot");
+            workerArguments.push_back(partialResultPath(commandLine.options.memoSnapshot, shard, shards));
+        }
+        std::vector<char *> argv;
+        for (auto &argument : workerArguments)
+        {
+            argv.push_back(argument.data());
+        }
+        argv.push_back(nullptr);
+
+        pid_t pid;
+        if (posix_spawnp(&pid, executable.c_str(), nullptr, nullptr, argv.data(), environ) != 0)
+        {
+            throw std::runtime_error("Cannot start the worker for shard " + std::to_string(shard) + ".");
+        }
+        workers.push_back(pid);
+    }
+
+    size_t failed = 0;
+    for (const pid_t pid : workers)
+    {
+        int status = 0;
+        if (waitpid(pid, &status, 0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0)
+        {
+            failed++;
+        }
+    }
+    if (failed > 0)
+    {
+        throw std::runtime_error(std::to_string(failed) + " of " + std::to_string(shards) + " shard workers failed.");
+    }
+}
+
+void printEstimate(const LogEstimate &estimate, const BatchStats &stats)
+{
+    std::cout << "samples " << estimate.samples << " (variants " << estimate.sampledVariants << ", inexact " << estimate.inexactSamples << ")\n"
+              << "mean cost " << estimate.meanCost << " [" << estimate.costLow << ", " << estimate.costHigh << "]\n"
+              << "fitness " << estimate.fitness << " [" << estimate.fitnessLow << ", " << estimate.fitnessHigh << "]\n"
+              << (estimate.complete ? "complete" : estimate.converged ? "converged" : "time budget spent") << " after "
+              << estimate.millis << " ms, memo hit rate " << stats.memoHitRate() << "\n";
+}
+
+// serves until a client asks for SHUTDOWN or the process gets SIGINT or SIGTERM
+void serve(const std::string &socketPath, const CommandLine &commandLine)
+{
+    ServerOptions options;
+    options.threads = commandLine.options.threads;
+    options.timeoutMs = commandLine.options.timeoutMs;
+    options.maxBatch = commandLine.maxBatch;
+    options.maxMemoEntries = commandLine.options.maxMemoEntries;
+    options.memoPolicy = commandLine.options.memoPolicy;
+    AlignmentServer server(socketPath, options);
+
+    // the signals are blocked before any thread starts, so only the waiter below ever receives them
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+    std::thread signalWaiter([&]()
+                             {
+                                 int signal;
+                                 sigwait(&signals, &signal);
+                                 server.stop(); });
+
+    try
+    {
+        server.run();
+    }
+    catch (...)
+    {
+        pthread_kill(signalWaiter.native_handle(), SIGTERM);
+        signalWaiter.join();
+        throw;
+    }
+    // wakes the waiter if the server stopped on a SHUTDOWN request
+    pthread_kill(signalWaiter.native_handle(), SIGTERM);
+    signalWaiter.join();
+}
+
+int run(int argc, char *argv[])
+{
+    if (argc < 2)
+    {
+        std::cerr << usage;
+        return 2;
+    }
+    const std::string command = argv[1];
+    const CommandLine commandLine = parseCommandLine(argc, argv);
+    const auto &arguments = commandLine.positional;
+
+    if (command == "align" && arguments.size() == 3)
+    {
+        const auto partial = alignShard(readTree(arguments[0]), readTraceFile(arguments[1]), 0, 1, commandLine.options);
+        const auto merged = mergePartialResults({partial});
+        writeMergedResult(merged, arguments[2]);
+        printStats(merged);
+        return 0;
+    }
+    if (command == "shard" && arguments.size() == 5)
+    {
+        const auto partial = alignShard(readTree(arguments[0]), readTraceFile(arguments[1]), parseCount(arguments[2], "shard"),
+                                        parseCount(arguments[3], "shards"), commandLine.options);
+        writePartialResult(partial, arguments[4]);
+        return 0;
+    }
+    if (command == "merge" && arguments.size() >= 2)
+    {
+        std::vector<PartialResult> partials;
+        for (size_t i = 1; i < arguments.size(); ++i)
+        {
+            partials.push_back(readPartialResult(arguments[i]));
+        }
+        const auto merged = mergePartialResults(partials);
+        writeMergedResult(merged, arguments[0]);
+        printStats(merged);
+        return 0;
+    }
+    if (command == "launch" && arguments.size() == 4)
+    {
+        const size_t shards = parseCount(arguments[2], "shards");
+        if (shards == 0)
+        {
+            throw std::invalid_argument("There must be at least one shard.");
+        }
+        // one process per shard already keeps the cores busy
+        const unsigned threadsPerShard = commandLine.threadsGiven
+                                             ? commandLine.options.threads
+                                             : std::max<unsigned>(1, std::thread::hardware_concurrency() / shards);
+        runShardProcesses(argv[0], commandLine, shards, threadsPerShard);
+
+        std::vector<PartialResult> partials;
+        for (size_t shard = 0; shard < shards; ++shard)
+        {
+            partials.push_back(readPartialResult(partialResultPath(arguments[3], shard, shards)));
+        }
+        const auto merged = mergePartialResults(partials);
+        writeMergedResult(merged, arguments[3]);
+        for (size_t shard = 0; shard < shards; ++shard)
+        {
+            std::remove(partialResultPath(arguments[3], shard, shards).c_str());
+        }
+        printStats(merged);
+        return 0;
+    }
+    if (command == "estimate" && arguments.size() == 2)
+    {
+        const auto root = normalizeTree(parseProcessTreeString(readTree(arguments[0])));
+        std::vector<std::vector<int>> traces;
+        for (const auto &trace : readTraceFile(arguments[1]).traces)
+        {
+            traces.push_back(convertStringTrace(trace));
+        }
+        BatchStats stats;
+        const auto estimate = estimateLog(root, groupTraces(traces), commandLine.options, commandLine.estimate, &stats);
+        printEstimate(estimate, stats);
+        return 0;
+    }
+    if (command == "serve" && arguments.size() == 1)
+    {
+        serve(arguments[0], commandLine);
+        return 0;
+    }
+
+    std::cerr << usage;
+    return 2;
+}
 
 int main(int argc, char *argv[])
 {
-    const std::string xesPath = "../data/xes/"; // Relative paths from working dir
-    const std::string ptmlPath = "../data/ptml/";
-}
\ No newline at end of file
+    try
+    {
+        return run(argc, argv);
+    }
+    catch (const std::exception &error)
+    {
+        std::cerr << error.what() << std::endl;
+        return 1;
+    }
+}
@@ -0,0 +1,97 @@
+#include "memoPolicy.h"
+#include <stdexcept>
+#include <vector>
+
+thread_local MemoPolicyStats memoPolicyStats;
+thread_local MemoPolicy activeMemoPolicy = MemoPolicy::STATIC;
+
+// lookups per decision of the adaptive policy
+constexpr uint32_t measuringWindow = 256;
+// subproblems a switched off key skips the memo for before it is measured again
+constexpr uint32_t switchedOffSubproblems = 64 * measuringWindow;
+// rough cost of a lookup plus the insert after a miss: hashing, comparing and copying the trace
+constexpr uint64_t memoOverheadNanos = 150;
+
+// by memo key; the keys are interned in order, so they are dense
+thread_local std::vector<AdaptiveMemoNode> adaptiveMemoNodes;
+
+MemoPolicy parseMemoPolicy(const std::string &name)
+{
+    if (name == "always")
+    {
+        return MemoPolicy::ALWAYS;
+    }
+    if (name == "static")
+    {
+        return MemoPolicy::STATIC;
+    }
+    if (name == "adaptive")
+    {
+        return MemoPolicy::ADAPTIVE;
+    }
+    throw std::invalid_argument("Unknown memo policy '" + name + "', expected 'always', 'static' or 'adaptive'.");
+}
+
+bool cheapChoice(const TreeNode &node)
+{
+    if (node.getOperation() != XOR || node.getActivities().size() > staticChoiceAlphabet)
+    {
+        return false;
+    }
+    for (const auto &child : node.getChildren())
+    {
+        if (child->getShape() == NodeShape::GENERIC)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+AdaptiveMemoNode &adaptiveMemoNode(int memoKey)
+{
+    if (static_cast<size_t>(memoKey) >= adaptiveMemoNodes.size())
+    {
+        adaptiveMemoNodes.resize(static_cast<size_t>(memoKey) + 1);
+    }
+    return adaptiveMemoNodes[memoKey];
+}
+
+bool skipMemo(AdaptiveMemoNode &node)
+{
+    if (node.skipsLeft == 0)
+    {
+        return false;
+    }
+    node.skipsLeft--;
+    memoPolicyStats.adaptiveSkips++;
+    return true;
+}
+
+void recordMemoLookup(AdaptiveMemoNode &node, bool hit)
+{
+    node.lookups++;
+    node.hits += hit ? 1 : 0;
+    if (node.lookups < measuringWindow)
+    {
+        return;
+    }
+
+    // every hit saves a recomputation, every lookup pays for the memo; without a timed miss the hits are all we know
+    const bool pays = node.hits > 0 && (node.computed == 0 || node.hits * (node.computeNanos / node.computed) >= node.lookups * memoOverheadNanos);
+    if (!pays)
+    {
+        node.skipsLeft = switchedOffSubproblems;
+        memoPolicyStats.switchedOff++;
+    }
+    node.lookups = 0;
+    node.hits = 0;
+    node.computed = 0;
+    node.computeNanos = 0;
+}
+
+void recordMemoCompute(AdaptiveMemoNode &node, uint64_t nanos)
+{
+    node.computed++;
+    node.computeNanos += nanos;
+}
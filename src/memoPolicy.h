@@ -0,0 +1,90 @@
+#ifndef MEMOPOLICY_H
+#define MEMOPOLICY_H
+#include "treeNode.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Which subproblems of dynAlign go through the memo. A lookup hashes and compares the trace and an insert copies it
+// into a new key, which costs more than solving some subproblems again. The closed-form shapes in NodeShape never
+// reach the memo; the policy decides for the generic nodes.
+enum class MemoPolicy
+{
+    // every subproblem of a generic node
+    ALWAYS,
+    // skips what is cheap by node type and alphabet: empty traces, which cost the cheapest run of the node, and
+    // choices over a small alphabet whose children all have a closed form
+    STATIC,
+    // STATIC, and measures the hit rate and recomputation time of every memo key on the thread. A key whose hits save
+    // less time than the memo costs it stops using the memo for a while and is then measured again.
+    ADAPTIVE
+};
+
+// "always", "static" or "adaptive"
+// @throws std::invalid_argument for any other name
+MemoPolicy parseMemoPolicy(const std::string &name);
+
+// choices over at most this many activities between closed-form children are solved without the memo
+constexpr size_t staticChoiceAlphabet = 8;
+
+// what the policy did on this thread
+struct MemoPolicyStats
+{
+    // subproblems solved without the memo by the static rules
+    size_t staticSkips = 0;
+    // subproblems of switched off memo keys
+    size_t adaptiveSkips = 0;
+    // times a memo key was switched off
+    size_t switchedOff = 0;
+};
+
+extern thread_local MemoPolicyStats memoPolicyStats;
+
+// policy of dynAlign on this thread
+extern thread_local MemoPolicy activeMemoPolicy;
+
+// installs a policy for the current thread and restores the previous one on exit
+struct MemoPolicyScope
+{
+    MemoPolicy previousPolicy;
+
+    explicit MemoPolicyScope(MemoPolicy policy) : previousPolicy(activeMemoPolicy)
+    {
+        activeMemoPolicy = policy;
+    }
+
+    ~MemoPolicyScope()
+    {
+        activeMemoPolicy = previousPolicy;
+    }
+};
+
+// a choice whose children all have a closed form over at most staticChoiceAlphabet activities
+bool cheapChoice(const TreeNode &node);
+
+// what the adaptive policy measured for one memo key on this thread since its last decision
+struct AdaptiveMemoNode
+{
+    uint32_t lookups = 0;
+    uint32_t hits = 0;
+    // misses whose recomputation was timed, see timedMissInterval
+    uint32_t computed = 0;
+    // while switched off, the subproblems left until the key is measured again
+    uint32_t skipsLeft = 0;
+    uint64_t computeNanos = 0;
+};
+
+// every this many lookups of a key, a miss is timed
+constexpr uint32_t timedMissInterval = 4;
+
+AdaptiveMemoNode &adaptiveMemoNode(int memoKey);
+
+// true while the key is switched off, counting down to its next measurement
+bool skipMemo(AdaptiveMemoNode &node);
+
+// counts a lookup; once a measuring window is full, switches the key off if its hits did not pay for the memo
+void recordMemoLookup(AdaptiveMemoNode &node, bool hit);
+
+void recordMemoCompute(AdaptiveMemoNode &node, uint64_t nanos);
+
+#endif // MEMOPOLICY_H
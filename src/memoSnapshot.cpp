@@ -0,0 +1,556 @@
+#include "memoSnapshot.h"
+#include "parser.h"
+#include "shardedAlignment.h"
+#include "traceView.h"
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+thread_local const MemoSnapshot *activeMemoSnapshot = nullptr;
+
+// bumped whenever the layout changes
+constexpr uint32_t snapshotVersion = 2;
+// written in native order, a file from a machine with the other byte order reads it reversed
+constexpr uint32_t byteOrderMark = 0x01020304;
+// label index of events that no label was known for when the trace was encoded
+constexpr uint32_t noLabel = std::numeric_limits<uint32_t>::max();
+
+struct SnapshotHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t byteOrder;
+    uint64_t model;
+    uint32_t sections;
+    uint32_t labels;
+    uint64_t labelsOffset;
+    uint64_t fileBytes;
+    // over the header with this field zeroed, the directory and the labels
+    uint64_t checksum;
+};
+
+// A section is its entries, each [fingerprint low, fingerprint high, cost, length, length label indices], followed
+// by slotCount word offsets of entries. The slots are an open addressing table over the fingerprints of the label
+// indices, empty slots hold emptySlot. The checksum covers the entries and the slots and is verified the first time
+// the section is used, so opening a snapshot does not read it whole.
+struct SnapshotSection
+{
+    uint64_t offset;
+    uint32_t entryCount;
+    uint32_t entryWords;
+    uint32_t slotCount;
+    uint32_t checksum;
+};
+
+constexpr uint32_t emptySlot = std::numeric_limits<uint32_t>::max();
+constexpr uint32_t entryHeaderWords = 4;
+
+static_assert(sizeof(SnapshotHeader) == 56 && sizeof(SnapshotSection) == 24, "the layout of the snapshot file is fixed");
+
+const char snapshotMagic[8] = {'P', 'T', 'A', 'M', 'E', 'M', 'O', '\0'};
+
+// FNV-1a, continued from hash
+uint64_t checksumBytes(const void *data, size_t bytes, uint64_t hash = 0xcbf29ce484222325ULL)
+{
+    const auto *byte = static_cast<const unsigned char *>(data);
+    for (size_t i = 0; i < bytes; ++i)
+    {
+        hash = (hash ^ byte[i]) * 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+uint32_t sectionChecksum(const uint32_t *entries, uint32_t entryWords, const uint32_t *slots, uint32_t slotCount)
+{
+    const uint64_t hash = checksumBytes(slots, slotCount * sizeof(uint32_t), checksumBytes(entries, entryWords * sizeof(uint32_t)));
+    return static_cast<uint32_t>(hash ^ (hash >> 32));
+}
+
+uint64_t headerChecksum(SnapshotHeader header, const void *directory, size_t directoryBytes, const void *labels, size_t labelBytes)
+{
+    header.checksum = 0;
+    return checksumBytes(labels, labelBytes, checksumBytes(directory, directoryBytes, checksumBytes(&header, sizeof(header))));
+}
+
+void describeStructure(const TreeNode &node, std::ostringstream &output)
+{
+    output << node.getOperation();
+    if (node.getOperation() == ACTIVITY)
+    {
+        output << ':' << activityLabel(node.getActivity()).size() << ':' << activityLabel(node.getActivity());
+    }
+    output << '(';
+    for (const auto &child : node.getChildren())
+    {
+        describeStructure(*child, output);
+        output << ',';
+    }
+    output << ')';
+}
+
+uint64_t structureFingerprint(const std::vector<std::shared_ptr<TreeNode>> &roots)
+{
+    std::ostringstream output;
+    for (const auto &root : roots)
+    {
+        describeStructure(*root, output);
+        output << ';';
+    }
+    return modelFingerprint(output.str());
+}
+
+void collectSubtreeKeys(const TreeNode &node, std::unordered_map<int, uint32_t> &sections, std::vector<int> &keys)
+{
+    if (!sections.try_emplace(node.getMemoKey(), static_cast<uint32_t>(keys.size())).second)
+    {
+        return;
+    }
+    keys.push_back(node.getMemoKey());
+    for (const auto &child : node.getChildren())
+    {
+        collectSubtreeKeys(*child, sections, keys);
+    }
+    if (node.getLoopHelper())
+    {
+        collectSubtreeKeys(*node.getLoopHelper(), sections, keys);
+    }
+}
+
+// memo keys of the distinct subtrees in a fixed order: the trees one after another, each in preorder with the
+// loop helper after the children. Equal trees give equal orders in every process.
+std::vector<int> subtreeKeys(const std::vector<std::shared_ptr<TreeNode>> &roots, std::unordered_map<int, uint32_t> &sections)
+{
+    std::vector<int> keys;
+    for (const auto &root : roots)
+    {
+        collectSubtreeKeys(*root, sections, keys);
+    }
+    return keys;
+}
+
+bool headerMatches(const SnapshotHeader &header, const std::vector<std::shared_ptr<TreeNode>> &roots)
+{
+    return std::memcmp(header.magic, snapshotMagic, sizeof(snapshotMagic)) == 0 && header.version == snapshotVersion &&
+           header.byteOrder == byteOrderMark && header.model == structureFingerprint(roots);
+}
+
+
+/**
+ * Maps a snapshot and checks its header, directory and labels, the sections are checked and read in place by find
+ *
+ * @param path Snapshot file
+ * @param roots The trees the snapshot is used with, in the order they were written
+ * @throws std::runtime_error if the file cannot be mapped, is damaged or was written for other trees
+ */
+MemoSnapshot::MemoSnapshot(const std::string &path, const std::vector<std::shared_ptr<TreeNode>> &roots)
+    : mapping(nullptr), mappingBytes(0), path(path)
+{
+    const int file = open(path.c_str(), O_RDONLY);
+    struct stat status;
+    if (file < 0 || fstat(file, &status) != 0)
+    {
+        if (file >= 0)
+        {
+            close(file);
+        }
+        throw std::runtime_error("Cannot open memo snapshot " + path + ".");
+    }
+    mappingBytes = static_cast<size_t>(status.st_size);
+    void *mapped = mappingBytes < sizeof(SnapshotHeader) ? MAP_FAILED : mmap(nullptr, mappingBytes, PROT_READ, MAP_PRIVATE, file, 0);
+    close(file);
+    if (mapped == MAP_FAILED)
+    {
+        throw std::runtime_error("Cannot map memo snapshot " + path + ".");
+    }
+    mapping = static_cast<const unsigned char *>(mapped);
+
+    try
+    {
+        SnapshotHeader header;
+        std::memcpy(&header, mapping, sizeof(header));
+        if (!headerMatches(header, roots))
+        {
+            throw std::runtime_error("Memo snapshot " + path + " was written by another version or for other process trees.");
+        }
+
+        const auto keys = subtreeKeys(roots, sections);
+        const uint64_t directoryEnd = sizeof(SnapshotHeader) + static_cast<uint64_t>(header.sections) * sizeof(SnapshotSection);
+        bool damaged = header.fileBytes != mappingBytes || header.sections != keys.size() || directoryEnd > header.labelsOffset ||
+                       header.labelsOffset > mappingBytes ||
+                       header.checksum != headerChecksum(header, mapping + sizeof(SnapshotHeader), directoryEnd - sizeof(SnapshotHeader),
+                                                         mapping + header.labelsOffset, mappingBytes - header.labelsOffset);
+        for (uint32_t index = 0; index < header.sections && !damaged; ++index)
+        {
+            SnapshotSection entry;
+            std::memcpy(&entry, mapping + sizeof(SnapshotHeader) + index * sizeof(SnapshotSection), sizeof(entry));
+            const uint64_t words = static_cast<uint64_t>(entry.entryWords) + entry.slotCount;
+            damaged = entry.offset % sizeof(uint32_t) != 0 || entry.offset < directoryEnd ||
+                      entry.offset + words * sizeof(uint32_t) > header.labelsOffset || (entry.slotCount & (entry.slotCount - 1)) != 0;
+        }
+
+        // labels are few, they are resolved right away
+        uint64_t position = header.labelsOffset;
+        for (uint32_t label = 0; label < header.labels && !damaged; ++label)
+        {
+            uint32_t length = 0;
+            damaged = position + sizeof(length) > mappingBytes;
+            if (!damaged)
+            {
+                std::memcpy(&length, mapping + position, sizeof(length));
+                position += sizeof(length);
+                damaged = position + length > mappingBytes;
+            }
+            if (!damaged)
+            {
+                labels.emplace_back(reinterpret_cast<const char *>(mapping + position), length);
+                position += length;
+                const int activity = registerActivity(labels.back());
+                if (activity >= static_cast<int>(labelIndexOf.size()))
+                {
+                    labelIndexOf.resize(activity + 1, -1);
+                }
+                labelIndexOf[activity] = static_cast<int>(label);
+            }
+        }
+        if (damaged)
+        {
+            throw std::runtime_error("Memo snapshot " + path + " is damaged.");
+        }
+        sectionChecks = std::make_unique<std::atomic<uint8_t>[]>(header.sections);
+    }
+    catch (...)
+    {
+        munmap(const_cast<unsigned char *>(mapping), mappingBytes);
+        throw;
+    }
+}
+
+MemoSnapshot::~MemoSnapshot()
+{
+    munmap(const_cast<unsigned char *>(mapping), mappingBytes);
+}
+
+// an empty section for subtrees the snapshot has nothing for and for damaged sections
+MemoSnapshot::Section MemoSnapshot::section(int memoKey) const
+{
+    const auto it = sections.find(memoKey);
+    if (it == sections.end())
+    {
+        return {nullptr, 0, 0, nullptr, 0, 0};
+    }
+    SnapshotSection entry;
+    std::memcpy(&entry, mapping + sizeof(SnapshotHeader) + it->second * sizeof(SnapshotSection), sizeof(entry));
+    // the mapping is page aligned and the offsets were checked to be multiples of 4
+    const auto *entries = reinterpret_cast<const uint32_t *>(mapping + entry.offset);
+    const Section found = {entries, entry.entryCount, entry.entryWords, entries + entry.entryWords, entry.slotCount, entry.checksum};
+
+    // a section without words has nothing to verify, the directory entry saying so is covered by the header checksum
+    if (found.entryWords == 0 && found.slotCount == 0)
+    {
+        return found;
+    }
+    // threads racing on the first use both verify the section, which gives the same answer
+    auto &check = sectionChecks[it->second];
+    uint8_t state = check.load(std::memory_order_acquire);
+    if (state == sectionUnchecked)
+    {
+        state = sectionChecksum(found.entries, found.entryWords, found.slots, found.slotCount) == found.checksum ? sectionIntact : sectionDamaged;
+        if (check.exchange(state, std::memory_order_acq_rel) == sectionUnchecked && state == sectionDamaged)
+        {
+            std::cerr << "Ignoring a damaged section of memo snapshot " << path << "." << std::endl;
+        }
+    }
+    return state == sectionIntact ? found : Section{nullptr, 0, 0, nullptr, 0, 0};
+}
+
+bool MemoSnapshot::encode(std::span<const int> trace, std::vector<int> &labelIndices) const
+{
+    labelIndices.clear();
+    for (const int activity : trace)
+    {
+        if (activity < 0)
+        {
+            labelIndices.push_back(static_cast<int>(noLabel));
+            continue;
+        }
+        if (activity >= static_cast<int>(labelIndexOf.size()) || labelIndexOf[activity] < 0)
+        {
+            return false;
+        }
+        labelIndices.push_back(labelIndexOf[activity]);
+    }
+    return true;
+}
+
+// index of the slot holding the entry with the label indices, or of the empty slot where it belongs; slotCount if
+// neither exists, which only happens in a damaged file
+uint32_t probeSlots(const uint32_t *entries, uint32_t entryWords, const uint32_t *slots, uint32_t slotCount, uint64_t fingerprint,
+                    std::span<const int> labelIndices)
+{
+    const uint32_t mask = slotCount - 1;
+    for (uint32_t step = 0, slot = static_cast<uint32_t>(fingerprint) & mask; step < slotCount; ++step, slot = (slot + 1) & mask)
+    {
+        const uint32_t offset = slots[slot];
+        if (offset == emptySlot)
+        {
+            return slot;
+        }
+        if (entryWords < entryHeaderWords || offset > entryWords - entryHeaderWords)
+        {
+            return slotCount;
+        }
+        const uint32_t *entry = entries + offset;
+        if (entry[0] == static_cast<uint32_t>(fingerprint) && entry[1] == static_cast<uint32_t>(fingerprint >> 32) &&
+            entry[3] == labelIndices.size() && entry[3] <= entryWords - entryHeaderWords - offset &&
+            std::equal(labelIndices.begin(), labelIndices.end(), entry + entryHeaderWords,
+                       [](int label, uint32_t stored)
+                       { return static_cast<uint32_t>(label) == stored; }))
+        {
+            return slot;
+        }
+    }
+    return slotCount;
+}
+
+int MemoSnapshot::find(int memoKey, std::span<const int> trace) const
+{
+    const Section found = section(memoKey);
+    // the buffer is reused, a lookup happens on every memo miss
+    thread_local std::vector<int> labelIndices;
+    if (found.slotCount == 0 || !encode(trace, labelIndices))
+    {
+        return -1;
+    }
+    const uint32_t slot = probeSlots(found.entries, found.entryWords, found.slots, found.slotCount, fingerprint(labelIndices), labelIndices);
+    if (slot == found.slotCount || found.slots[slot] == emptySlot)
+    {
+        return -1;
+    }
+    return static_cast<int>(found.entries[found.slots[slot] + 2]);
+}
+
+size_t MemoSnapshot::entries() const
+{
+    size_t total = 0;
+    for (const auto &[memoKey, index] : sections)
+    {
+        total += section(memoKey).entryCount;
+    }
+    return total;
+}
+
+std::shared_ptr<const MemoSnapshot> openMemoSnapshot(const std::string &path, const std::vector<std::shared_ptr<TreeNode>> &roots)
+{
+    std::ifstream input(path, std::ios::binary);
+    SnapshotHeader header;
+    if (!input || !input.read(reinterpret_cast<char *>(&header), sizeof(header)) || !headerMatches(header, roots))
+    {
+        return nullptr;
+    }
+    try
+    {
+        return std::make_shared<const MemoSnapshot>(path, roots);
+    }
+    catch (const std::runtime_error &error)
+    {
+        // the snapshot only saves time, so the run goes on cold and rewrites it afterwards
+        std::cerr << error.what() << " Starting with a cold memo." << std::endl;
+        return nullptr;
+    }
+}
+
+// the section of one subtree while it is written
+struct SectionBuilder
+{
+    std::vector<uint32_t> words;
+    std::vector<uint32_t> slots;
+    uint32_t entryCount = 0;
+
+    // false if the section already has the entry
+    bool add(uint64_t fingerprint, uint32_t cost, std::span<const int> labelIndices)
+    {
+        // a load factor of at most one half keeps the probes of find short
+        if ((entryCount + 1) * 2 > slots.size())
+        {
+            grow();
+        }
+        const uint32_t slot = probeSlots(words.data(), static_cast<uint32_t>(words.size()), slots.data(), static_cast<uint32_t>(slots.size()),
+                                         fingerprint, labelIndices);
+        if (slots[slot] != emptySlot)
+        {
+            return false;
+        }
+        if (words.size() + entryHeaderWords + labelIndices.size() >= emptySlot)
+        {
+            throw std::length_error("Memo snapshot section exceeds 16 GiB.");
+        }
+        slots[slot] = static_cast<uint32_t>(words.size());
+        words.insert(words.end(), {static_cast<uint32_t>(fingerprint), static_cast<uint32_t>(fingerprint >> 32), cost,
+                                   static_cast<uint32_t>(labelIndices.size())});
+        words.insert(words.end(), labelIndices.begin(), labelIndices.end());
+        entryCount++;
+        return true;
+    }
+
+    void grow()
+    {
+        std::vector<uint32_t> oldSlots(std::max<size_t>(8, slots.size() * 2), emptySlot);
+        oldSlots.swap(slots);
+        const uint32_t mask = static_cast<uint32_t>(slots.size()) - 1;
+        for (const uint32_t offset : oldSlots)
+        {
+            if (offset == emptySlot)
+            {
+                continue;
+            }
+            uint32_t slot = words[offset] & mask;
+            while (slots[slot] != emptySlot)
+            {
+                slot = (slot + 1) & mask;
+            }
+            slots[slot] = offset;
+        }
+    }
+};
+
+/**
+ * Writes a snapshot, see memoSnapshot.h. The sections of previous are copied as they are, entries and index, so
+ * writing costs little more than adding the new entries. The file is written under a temporary name and renamed, so a run that is opening the
+ * snapshot at the same time sees either the old or the new one.
+ *
+ * @param path Snapshot file, replaced if it exists
+ * @param roots The trees the memos were filled for
+ * @param memos Memos of the workers of the run
+ * @param previous Snapshot the run started from, its entries are kept
+ * @throws std::runtime_error if the file cannot be written
+ */
+void writeMemoSnapshot(const std::string &path, const std::vector<std::shared_ptr<TreeNode>> &roots,
+                       const std::vector<const CostTable *> &memos, const MemoSnapshot *previous)
+{
+    std::unordered_map<int, uint32_t> sectionOf;
+    const auto keys = subtreeKeys(roots, sectionOf);
+
+    // the labels of previous keep their indices, so its entries can be copied
+    std::vector<std::string> labels;
+    std::vector<int> labelIndexOf;
+    if (previous)
+    {
+        labels = previous->labels;
+        labelIndexOf = previous->labelIndexOf;
+    }
+    std::vector<int> labelIndices;
+    const auto encode = [&](std::span<const int> trace)
+    {
+        labelIndices.clear();
+        for (const int activity : trace)
+        {
+            if (activity < 0)
+            {
+                labelIndices.push_back(static_cast<int>(noLabel));
+                continue;
+            }
+            if (activity >= static_cast<int>(labelIndexOf.size()))
+            {
+                labelIndexOf.resize(activity + 1, -1);
+            }
+            if (labelIndexOf[activity] < 0)
+            {
+                labelIndexOf[activity] = static_cast<int>(labels.size());
+                labels.push_back(activityLabel(activity));
+            }
+            labelIndices.push_back(labelIndexOf[activity]);
+        }
+    };
+
+    // sections without new entries are written straight from the mapping of previous, the others are rebuilt
+    std::vector<SnapshotSection> directory(keys.size());
+    std::vector<SectionBuilder> rebuilt(keys.size());
+    uint64_t offset = sizeof(SnapshotHeader) + keys.size() * sizeof(SnapshotSection);
+    for (size_t index = 0; index < keys.size(); ++index)
+    {
+        const auto old = previous ? previous->section(keys[index]) : MemoSnapshot::Section{nullptr, 0, 0, nullptr, 0, 0};
+        auto &builder = rebuilt[index];
+        // the workers may have solved the same subproblem, the builder drops the duplicates
+        for (const CostTable *memo : memos)
+        {
+            const auto it = memo->find(keys[index]);
+            if (it == memo->end())
+            {
+                continue;
+            }
+            it->second.forEach([&](std::span<const int> trace, int cost)
+                               {
+                                   if (builder.slots.empty())
+                                   {
+                                       builder.words.assign(old.entries, old.entries + old.entryWords);
+                                       builder.slots.assign(old.slots, old.slots + old.slotCount);
+                                       builder.entryCount = old.entryCount;
+                                   }
+                                   encode(trace);
+                                   builder.add(fingerprint(labelIndices), static_cast<uint32_t>(cost), labelIndices); });
+        }
+
+        directory[index] = builder.slots.empty()
+                               ? SnapshotSection{offset, old.entryCount, old.entryWords, old.slotCount, old.checksum}
+                               : SnapshotSection{offset, builder.entryCount, static_cast<uint32_t>(builder.words.size()),
+                                                 static_cast<uint32_t>(builder.slots.size()),
+                                                 sectionChecksum(builder.words.data(), static_cast<uint32_t>(builder.words.size()),
+                                                                 builder.slots.data(), static_cast<uint32_t>(builder.slots.size()))};
+        offset += (static_cast<uint64_t>(directory[index].entryWords) + directory[index].slotCount) * sizeof(uint32_t);
+    }
+
+    std::string labelBytes;
+    for (const auto &label : labels)
+    {
+        const uint32_t length = static_cast<uint32_t>(label.size());
+        labelBytes.append(reinterpret_cast<const char *>(&length), sizeof(length));
+        labelBytes += label;
+    }
+
+    SnapshotHeader header;
+    std::memcpy(header.magic, snapshotMagic, sizeof(snapshotMagic));
+    header.version = snapshotVersion;
+    header.byteOrder = byteOrderMark;
+    header.model = structureFingerprint(roots);
+    header.sections = static_cast<uint32_t>(keys.size());
+    header.labels = static_cast<uint32_t>(labels.size());
+    header.labelsOffset = offset;
+    header.fileBytes = header.labelsOffset + labelBytes.size();
+    header.checksum = headerChecksum(header, directory.data(), directory.size() * sizeof(SnapshotSection), labelBytes.data(), labelBytes.size());
+
+    const std::string temporary = path + ".tmp";
+    {
+        std::ofstream output(temporary, std::ios::binary | std::ios::trunc);
+        output.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        output.write(reinterpret_cast<const char *>(directory.data()), directory.size() * sizeof(SnapshotSection));
+        for (size_t index = 0; index < keys.size(); ++index)
+        {
+            const auto &builder = rebuilt[index];
+            if (builder.slots.empty())
+            {
+                const auto old = previous ? previous->section(keys[index]) : MemoSnapshot::Section{nullptr, 0, 0, nullptr, 0, 0};
+                output.write(reinterpret_cast<const char *>(old.entries), (static_cast<size_t>(old.entryWords) + old.slotCount) * sizeof(uint32_t));
+                continue;
+            }
+            output.write(reinterpret_cast<const char *>(builder.words.data()), builder.words.size() * sizeof(uint32_t));
+            output.write(reinterpret_cast<const char *>(builder.slots.data()), builder.slots.size() * sizeof(uint32_t));
+        }
+        output << labelBytes;
+        if (!output)
+        {
+            throw std::runtime_error("Cannot write memo snapshot " + temporary + ".");
+        }
+    }
+    if (std::rename(temporary.c_str(), path.c_str()) != 0)
+    {
+        throw std::runtime_error("Cannot replace memo snapshot " + path + ".");
+    }
+}
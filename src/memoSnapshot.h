@@ -0,0 +1,111 @@
+#ifndef MEMOSNAPSHOT_H
+#define MEMOSNAPSHOT_H
+#include "treeNode.h"
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Memo snapshots carry the solved subproblems of one run over to the next, e.g. from one nightly log to the next
+// one that mostly repeats it. Memo keys and activity ids are only stable within a process, so a snapshot stores
+// every subtree by its position in the trees and every event by its label.
+//
+// The file is a header, a directory with one section per distinct subtree, the sections and the labels. A section
+// holds the entries of its subtree and an open addressing index over their fingerprints. A snapshot is mapped into
+// memory when it is opened and read in place: dynAlign looks a subproblem up in it when the memo of the thread misses,
+// so a run only touches the pages of the entries it needs. The header holds a fingerprint of the tree structures;
+// a snapshot of other trees, of another format version or of another byte order is rejected. Checksums cover the
+// header, directory and labels, which are verified on opening, and every section, which is verified on first use;
+// a damaged section is ignored, so a flipped byte costs hits but never gives a wrong cost.
+
+// fingerprint of the structure of the trees: operators, labels and child order
+uint64_t structureFingerprint(const std::vector<std::shared_ptr<TreeNode>> &roots);
+
+class MemoSnapshot
+{
+public:
+    // @throws std::runtime_error if the file cannot be mapped, is damaged or was written for other trees
+    MemoSnapshot(const std::string &path, const std::vector<std::shared_ptr<TreeNode>> &roots);
+
+    ~MemoSnapshot();
+
+    MemoSnapshot(const MemoSnapshot &) = delete;
+
+    MemoSnapshot &operator=(const MemoSnapshot &) = delete;
+
+    // cost of the trace in the subtree with the memo key, -1 if the snapshot does not have it
+    int find(int memoKey, std::span<const int> trace) const;
+
+    // entries over all subtrees
+    size_t entries() const;
+
+private:
+    friend void writeMemoSnapshot(const std::string &path, const std::vector<std::shared_ptr<TreeNode>> &roots,
+                                  const std::vector<const CostTable *> &memos, const MemoSnapshot *previous);
+
+    struct Section
+    {
+        const uint32_t *entries;
+        uint32_t entryCount;
+        uint32_t entryWords;
+        const uint32_t *slots;
+        uint32_t slotCount;
+        uint32_t checksum;
+    };
+
+    enum SectionCheck : uint8_t
+    {
+        sectionUnchecked,
+        sectionIntact,
+        sectionDamaged
+    };
+
+    Section section(int memoKey) const;
+
+    // the events as label indices of the file, false if one of them has no label in the file
+    bool encode(std::span<const int> trace, std::vector<int> &labelIndices) const;
+
+    const unsigned char *mapping;
+    size_t mappingBytes;
+    std::string path;
+    // SectionCheck per section
+    std::unique_ptr<std::atomic<uint8_t>[]> sectionChecks;
+    // memo key -> section
+    std::unordered_map<int, uint32_t> sections;
+    std::vector<std::string> labels;
+    // activity id of this process -> label index in the file, -1 for ids without one
+    std::vector<int> labelIndexOf;
+};
+
+// nullptr if the file does not exist, was written for other trees or is damaged, so the run starts cold;
+// damage is reported on stderr
+std::shared_ptr<const MemoSnapshot> openMemoSnapshot(const std::string &path, const std::vector<std::shared_ptr<TreeNode>> &roots);
+
+// Writes the entries of previous, if given, and those of the memos for the subtrees of the trees. Entries of nodes
+// that are not in the trees are left out.
+void writeMemoSnapshot(const std::string &path, const std::vector<std::shared_ptr<TreeNode>> &roots,
+                       const std::vector<const CostTable *> &memos, const MemoSnapshot *previous = nullptr);
+
+// the snapshot dynAlign falls back to when the memo of the current thread misses
+extern thread_local const MemoSnapshot *activeMemoSnapshot;
+
+// installs a snapshot for the current thread and restores the previous one on exit
+struct MemoSnapshotScope
+{
+    const MemoSnapshot *previousSnapshot;
+
+    explicit MemoSnapshotScope(const MemoSnapshot *snapshot) : previousSnapshot(activeMemoSnapshot)
+    {
+        activeMemoSnapshot = snapshot;
+    }
+
+    ~MemoSnapshotScope()
+    {
+        activeMemoSnapshot = previousSnapshot;
+    }
+};
+
+#endif // MEMOSNAPSHOT_H
@@ -0,0 +1,254 @@
+#include "memoTable.h"
+#include <stdexcept>
+
+int HashMemoTable::find(const TraceView &trace) const
+{
+    const auto it = entries.find(trace);
+    return it == entries.end() ? -1 : it->second;
+}
+
+void HashMemoTable::insert(const TraceView &trace, int cost)
+{
+    entries.insert_or_assign(MemoKey{trace.fingerprint(), std::vector<int>(trace.begin(), trace.end())}, cost);
+}
+
+size_t HashMemoTable::size() const
+{
+    return entries.size();
+}
+
+size_t HashMemoTable::memoryBytes() const
+{
+    // bucket array plus one node per entry, each owning the buffer of its trace
+    size_t bytes = entries.bucket_count() * sizeof(void *);
+    for (const auto &[key, cost] : entries)
+    {
+        bytes += sizeof(void *) + sizeof(key) + sizeof(cost) + key.trace.capacity() * sizeof(int);
+    }
+    return bytes;
+}
+
+void HashMemoTable::clear()
+{
+    entries.clear();
+}
+
+void HashMemoTable::forEach(const std::function<void(std::span<const int>, int)> &visit) const
+{
+    for (const auto &[key, cost] : entries)
+    {
+        visit(key.trace, cost);
+    }
+}
+
+namespace
+{
+    void appendVarint(std::vector<uint8_t> &out, uint64_t value)
+    {
+        while (value >= 0x80)
+        {
+            out.push_back(static_cast<uint8_t>(value) | 0x80);
+            value >>= 7;
+        }
+        out.push_back(static_cast<uint8_t>(value));
+    }
+
+    // compares the varint at in with value and advances in past it on a match
+    bool matchVarint(const uint8_t *&in, const uint8_t *end, uint64_t value)
+    {
+        while (value >= 0x80)
+        {
+            if (in == end || *in++ != (static_cast<uint8_t>(value) | 0x80))
+            {
+                return false;
+            }
+            value >>= 7;
+        }
+        return in != end && *in++ == static_cast<uint8_t>(value);
+    }
+
+    uint64_t zigzag(int previous, int activity)
+    {
+        const int64_t delta = static_cast<int64_t>(activity) - previous;
+        return (static_cast<uint64_t>(delta) << 1) ^ static_cast<uint64_t>(delta >> 63);
+    }
+
+    uint64_t readVarint(const uint8_t *&in)
+    {
+        uint64_t value = 0;
+        for (int shift = 0;; shift += 7)
+        {
+            const uint8_t byte = *in++;
+            value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+            if (byte < 0x80)
+            {
+                return value;
+            }
+        }
+    }
+}
+
+// Keys are the length followed by the zigzag encoded differences between consecutive events. Projected
+// traces hold the activities of one subtree, whose ids are close to each other, so most events take one byte.
+void CompactMemoTable::appendKey(const TraceView &trace)
+{
+    appendVarint(keys, trace.size());
+    int previous = 0;
+    for (const int activity : trace)
+    {
+        appendVarint(keys, zigzag(previous, activity));
+        previous = activity;
+    }
+}
+
+// compares without decoding, the expected bytes of every event are cheaper to produce than to parse
+bool CompactMemoTable::keyMatches(uint32_t keyOffset, const TraceView &trace) const
+{
+    const uint8_t *in = keys.data() + keyOffset;
+    const uint8_t *end = keys.data() + keys.size();
+    if (!matchVarint(in, end, trace.size()))
+    {
+        return false;
+    }
+    int previous = 0;
+    for (const int activity : trace)
+    {
+        if (!matchVarint(in, end, zigzag(previous, activity)))
+        {
+            return false;
+        }
+        previous = activity;
+    }
+    return true;
+}
+
+size_t CompactMemoTable::probe(const TraceView &trace, uint32_t fingerprint) const
+{
+    const size_t mask = slots.size() - 1;
+    for (size_t index = fingerprint & mask;; index = (index + 1) & mask)
+    {
+        const Slot &slot = slots[index];
+        if (slot.keyOffset == emptySlot || (slot.fingerprint == fingerprint && keyMatches(slot.keyOffset, trace)))
+        {
+            return index;
+        }
+    }
+}
+
+int CompactMemoTable::find(const TraceView &trace) const
+{
+    if (entries == 0)
+    {
+        return -1;
+    }
+    const Slot &slot = slots[probe(trace, static_cast<uint32_t>(trace.fingerprint()))];
+    if (slot.keyOffset == emptySlot)
+    {
+        return -1;
+    }
+    return slot.cost == costEscape ? wideCosts.at(slot.keyOffset) : slot.cost;
+}
+
+void CompactMemoTable::insert(const TraceView &trace, int cost)
+{
+    // keep the load factor below 0.7 so probe sequences stay short
+    if ((entries + 1) * 10 > slots.size() * 7)
+    {
+        grow();
+    }
+
+    const uint32_t fingerprint = static_cast<uint32_t>(trace.fingerprint());
+    Slot &slot = slots[probe(trace, fingerprint)];
+    if (slot.keyOffset == emptySlot)
+    {
+        if (keys.size() >= emptySlot)
+        {
+            throw std::length_error("Compact memo key slab of a node exceeds 4 GiB.");
+        }
+        // grow the slab by half instead of doubling it, it holds most of the bytes of the table
+        const size_t maxKeyBytes = 10 * (trace.size() + 1);
+        if (keys.size() + maxKeyBytes > keys.capacity())
+        {
+            keys.reserve(std::max(keys.size() + maxKeyBytes, keys.capacity() + keys.capacity() / 2));
+        }
+        slot.fingerprint = fingerprint;
+        slot.keyOffset = static_cast<uint32_t>(keys.size());
+        appendKey(trace);
+        ++entries;
+    }
+
+    if (cost >= costEscape)
+    {
+        slot.cost = costEscape;
+        wideCosts[slot.keyOffset] = cost;
+    }
+    else
+    {
+        slot.cost = static_cast<uint16_t>(cost);
+        wideCosts.erase(slot.keyOffset);
+    }
+}
+
+void CompactMemoTable::grow()
+{
+    std::vector<Slot> oldSlots(std::max<size_t>(16, slots.size() * 2), Slot{0, emptySlot, 0});
+    oldSlots.swap(slots);
+
+    // the stored fingerprints are enough to place the entries again, the keys are not read
+    const size_t mask = slots.size() - 1;
+    for (const Slot &slot : oldSlots)
+    {
+        if (slot.keyOffset == emptySlot)
+        {
+            continue;
+        }
+        size_t index = slot.fingerprint & mask;
+        while (slots[index].keyOffset != emptySlot)
+        {
+            index = (index + 1) & mask;
+        }
+        slots[index] = slot;
+    }
+}
+
+size_t CompactMemoTable::size() const
+{
+    return entries;
+}
+
+size_t CompactMemoTable::memoryBytes() const
+{
+    return slots.capacity() * sizeof(Slot) + keys.capacity() + wideCosts.size() * (sizeof(void *) * 2 + sizeof(uint32_t) + sizeof(int));
+}
+
+void CompactMemoTable::forEach(const std::function<void(std::span<const int>, int)> &visit) const
+{
+    std::vector<int> trace;
+    for (const Slot &slot : slots)
+    {
+        if (slot.keyOffset == emptySlot)
+        {
+            continue;
+        }
+        const uint8_t *in = keys.data() + slot.keyOffset;
+        trace.resize(readVarint(in));
+        int previous = 0;
+        for (int &activity : trace)
+        {
+            const uint64_t encoded = readVarint(in);
+            activity = static_cast<int>(previous + static_cast<int64_t>((encoded >> 1) ^ (~(encoded & 1) + 1)));
+            previous = activity;
+        }
+        visit(trace, slot.cost == costEscape ? wideCosts.at(slot.keyOffset) : slot.cost);
+    }
+}
+
+void CompactMemoTable::clear()
+{
+    slots.clear();
+    slots.shrink_to_fit();
+    keys.clear();
+    keys.shrink_to_fit();
+    wideCosts.clear();
+    entries = 0;
+}
@@ -0,0 +1,132 @@
+#ifndef MEMOTABLE_H
+#define MEMOTABLE_H
+#include "traceView.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <span>
+#include <unordered_map>
+#include <vector>
+
+// Memo of a single node: trace -> alignment cost. Costs are never negative, find returns -1 for a miss.
+// forEach visits the entries in no particular order.
+// Building with COMPACT_MEMO swaps the hash map for CompactMemoTable, see MemoTable below.
+
+// memo key: the trace is kept to verify fingerprint matches, the fingerprint to rehash without reading it
+struct MemoKey
+{
+    uint64_t fingerprint;
+    std::vector<int> trace;
+};
+
+struct MemoKeyHash
+{
+    using is_transparent = void;
+
+    size_t operator()(const MemoKey &key) const
+    {
+        return key.fingerprint;
+    }
+
+    size_t operator()(const TraceView &view) const
+    {
+        return view.fingerprint();
+    }
+};
+
+struct MemoKeyEqual
+{
+    using is_transparent = void;
+
+    bool operator()(const MemoKey &lhs, const MemoKey &rhs) const
+    {
+        return lhs.fingerprint == rhs.fingerprint && lhs.trace == rhs.trace;
+    }
+
+    bool operator()(const MemoKey &lhs, const TraceView &rhs) const
+    {
+        return lhs.trace.size() == rhs.size() && lhs.fingerprint == rhs.fingerprint() &&
+               std::equal(lhs.trace.begin(), lhs.trace.end(), rhs.begin());
+    }
+
+    bool operator()(const TraceView &lhs, const MemoKey &rhs) const
+    {
+        return (*this)(rhs, lhs);
+    }
+};
+
+// one heap-allocated trace per entry in a node-based hash map
+class HashMemoTable
+{
+public:
+    int find(const TraceView &trace) const;
+
+    void insert(const TraceView &trace, int cost);
+
+    size_t size() const;
+
+    // approximate heap usage
+    size_t memoryBytes() const;
+
+    void clear();
+
+    void forEach(const std::function<void(std::span<const int>, int)> &visit) const;
+
+private:
+    std::unordered_map<MemoKey, int, MemoKeyHash, MemoKeyEqual> entries;
+};
+
+// Open addressing over 12-byte slots without per-entry allocations. Keys are delta/varint encoded
+// into a byte slab, costs are 16 bits wide and larger costs escape into a side table.
+class CompactMemoTable
+{
+public:
+    int find(const TraceView &trace) const;
+
+    void insert(const TraceView &trace, int cost);
+
+    size_t size() const;
+
+    size_t memoryBytes() const;
+
+    void clear();
+
+    // decodes every key, so it is meant for exporting the table rather than for lookups
+    void forEach(const std::function<void(std::span<const int>, int)> &visit) const;
+
+private:
+    struct Slot
+    {
+        // low half of the fingerprint, enough to place the slot and to reject most mismatches
+        uint32_t fingerprint;
+        uint32_t keyOffset;
+        uint16_t cost;
+    };
+
+    static constexpr uint32_t emptySlot = UINT32_MAX;
+    static constexpr uint16_t costEscape = UINT16_MAX;
+
+    // index of the slot holding the trace, or of the empty slot where it belongs
+    size_t probe(const TraceView &trace, uint32_t fingerprint) const;
+
+    bool keyMatches(uint32_t keyOffset, const TraceView &trace) const;
+
+    void appendKey(const TraceView &trace);
+
+    void grow();
+
+    std::vector<Slot> slots;
+    std::vector<uint8_t> keys;
+    // slab offset -> cost for costs that do not fit into 16 bits
+    std::unordered_map<uint32_t, int> wideCosts;
+    size_t entries = 0;
+};
+
+#ifdef COMPACT_MEMO
+using MemoTable = CompactMemoTable;
+#else
+using MemoTable = HashMemoTable;
+#endif
+
+#endif // MEMOTABLE_H
@@ -0,0 +1,94 @@
+#include "modelRegistry.h"
+#include "parser.h"
+#include <algorithm>
+
+/**
+ * Parses and registers a tree. Parsing happens outside the lock, so alignments against the
+ * other models are not blocked by a large tree being loaded.
+ *
+ * @param name Name of the model, an existing model with this name is replaced
+ * @param tree Process tree string
+ * @param normalize Run normalizeTree on the parsed tree
+ * @return The loaded model
+ * @throws std::runtime_error if the tree cannot be parsed
+ */
+std::shared_ptr<const ProcessModel> ModelRegistry::load(const std::string &name, const std::string &tree, bool normalize)
+{
+    auto model = std::make_shared<ProcessModel>();
+    model->name = name;
+    model->root = parseProcessTreeString(tree);
+    if (normalize)
+    {
+        model->root = normalizeTree(model->root, &model->normalization);
+    }
+
+    std::lock_guard<std::mutex> lock(modelsMutex);
+    const auto it = std::find_if(loadedModels.begin(), loadedModels.end(), [&name](const auto &loaded)
+                                 { return loaded->name == name; });
+    if (it != loadedModels.end())
+    {
+        *it = model;
+    }
+    else
+    {
+        loadedModels.push_back(model);
+    }
+    return model;
+}
+
+bool ModelRegistry::unload(const std::string &name)
+{
+    std::lock_guard<std::mutex> lock(modelsMutex);
+    const auto it = std::find_if(loadedModels.begin(), loadedModels.end(), [&name](const auto &loaded)
+                                 { return loaded->name == name; });
+    if (it == loadedModels.end())
+    {
+        return false;
+    }
+    loadedModels.erase(it);
+    return true;
+}
+
+std::shared_ptr<const ProcessModel> ModelRegistry::find(const std::string &name) const
+{
+    std::lock_guard<std::mutex> lock(modelsMutex);
+    const auto it = std::find_if(loadedModels.begin(), loadedModels.end(), [&name](const auto &loaded)
+                                 { return loaded->name == name; });
+    return it == loadedModels.end() ? nullptr : *it;
+}
+
+std::vector<std::shared_ptr<const ProcessModel>> ModelRegistry::models() const
+{
+    std::lock_guard<std::mutex> lock(modelsMutex);
+    return loadedModels;
+}
+
+/**
+ * Aligns a grouped log against all loaded models in one pass over its variants
+ *
+ * @param log Log grouped with groupEvents, encoded with the shared activity dictionary
+ * @param options Timeout, thread count, schedule and memo limit of the workers
+ * @param alignedModels If given, receives the models the results belong to
+ * @param stats If given, receives the memo hit rate over all models
+ * @return One result vector per model, each parallel to log.caseIds
+ */
+std::vector<std::vector<AlignmentResult>> ModelRegistry::alignLog(const EventLog &log, const BatchOptions &options,
+                                                                  std::vector<std::shared_ptr<const ProcessModel>> *alignedModels,
+                                                                  BatchStats *stats) const
+{
+    // a snapshot, models loaded or unloaded meanwhile do not affect this call
+    const auto snapshot = models();
+    std::vector<std::shared_ptr<TreeNode>> roots;
+    roots.reserve(snapshot.size());
+    for (const auto &model : snapshot)
+    {
+        roots.push_back(model->root);
+    }
+
+    auto results = alignLogAgainst(roots, log, options, stats);
+    if (alignedModels)
+    {
+        *alignedModels = snapshot;
+    }
+    return results;
+}
@@ -0,0 +1,49 @@
+#ifndef MODELREGISTRY_H
+#define MODELREGISTRY_H
+#include "batchAlignment.h"
+#include "eventLog.h"
+#include "treeAlignment.h"
+#include "treeNode.h"
+#include "treeNormalization.h"
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+struct ProcessModel
+{
+    std::string name;
+    std::shared_ptr<TreeNode> root;
+    NormalizationStats normalization;
+};
+
+// Trees loaded side by side. Every tree numbers its own nodes and all of them share the
+// append-only activity dictionary of the parser, so a trace encoded once is valid for every model.
+// Unloading drops the registry's reference; alignments still running keep their model alive.
+class ModelRegistry
+{
+public:
+    // parses the tree and registers it under name, replacing a model with the same name
+    std::shared_ptr<const ProcessModel> load(const std::string &name, const std::string &tree, bool normalize = true);
+
+    // returns false if no model has that name
+    bool unload(const std::string &name);
+
+    // nullptr if no model has that name
+    std::shared_ptr<const ProcessModel> find(const std::string &name) const;
+
+    // in load order
+    std::vector<std::shared_ptr<const ProcessModel>> models() const;
+
+    // aligns every variant of the log against every model loaded at the time of the call;
+    // one result vector per model in the order of models(), each parallel to log.caseIds
+    std::vector<std::vector<AlignmentResult>> alignLog(const EventLog &log, const BatchOptions &options,
+                                                       std::vector<std::shared_ptr<const ProcessModel>> *alignedModels = nullptr,
+                                                       BatchStats *stats = nullptr) const;
+
+private:
+    mutable std::mutex modelsMutex;
+    std::vector<std::shared_ptr<const ProcessModel>> loadedModels;
+};
+
+#endif // MODELREGISTRY_H
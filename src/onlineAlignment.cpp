@@ -0,0 +1,193 @@
+#include "onlineAlignment.h"
+#include "traceView.h"
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+OnlineAligner::OnlineAligner(std::shared_ptr<TreeNode> root, size_t maxMemoEntries, std::chrono::milliseconds maxIdle, int timeoutMs)
+    : root(std::move(root)), maxMemoEntries(maxMemoEntries), maxIdle(maxIdle), timeoutMs(timeoutMs), nextCaseId(0),
+      lastSweep(std::chrono::steady_clock::now())
+{
+}
+
+int64_t OnlineAligner::openCase()
+{
+    std::lock_guard<std::mutex> lock(casesMutex);
+    const auto now = std::chrono::steady_clock::now();
+
+    // sweep at most once per idle period so opening stays O(1) amortized
+    if (maxIdle.count() > 0 && now - lastSweep > maxIdle)
+    {
+        evictIdleCasesLocked(now);
+    }
+
+    const int64_t caseId = nextCaseId++;
+    auto state = std::make_shared<CaseState>();
+    state->result = {0, 0, false};
+    state->resultValid = false;
+    state->lastAccess = now;
+    cases.emplace(caseId, std::move(state));
+    return caseId;
+}
+
+std::shared_ptr<OnlineAligner::CaseState> OnlineAligner::findCase(int64_t caseId)
+{
+    std::lock_guard<std::mutex> lock(casesMutex);
+    const auto it = cases.find(caseId);
+    if (it == cases.end())
+    {
+        throw std::out_of_range("Case " + std::to_string(caseId) + " is not open.");
+    }
+    it->second->lastAccess = std::chrono::steady_clock::now();
+    return it->second;
+}
+
+void OnlineAligner::appendEvent(int64_t caseId, int activity)
+{
+    const auto state = findCase(caseId);
+    std::lock_guard<std::mutex> lock(state->mutex);
+    state->trace.push_back(activity);
+    state->resultValid = false;
+}
+
+/**
+ * Shrinks a memo to at most keep entries by dropping the shortest traces. The entries of the longest subtraces cover
+ * most of the prefix and are the most expensive to solve again, while short ones are recomputed quickly, so the next
+ * prefix still finds most of its expensive subproblems.
+ *
+ * @param memo Memo of a case
+ * @param keep Entries to keep at most
+ */
+void keepLongestEntries(CostTable &memo, size_t keep)
+{
+    std::vector<size_t> entriesOfLength;
+    for (const auto &[memoKey, table] : memo)
+    {
+        table.forEach([&](std::span<const int> trace, int)
+                      {
+                          if (trace.size() >= entriesOfLength.size())
+                          {
+                              entriesOfLength.resize(trace.size() + 1);
+                          }
+                          entriesOfLength[trace.size()]++; });
+    }
+    // the shortest length that is kept, so that all entries at least as long fit
+    size_t minLength = entriesOfLength.size();
+    size_t kept = 0;
+    while (minLength > 0 && kept + entriesOfLength[minLength - 1] <= keep)
+    {
+        kept += entriesOfLength[--minLength];
+    }
+
+    CostTable trimmed;
+    for (const auto &[memoKey, table] : memo)
+    {
+        table.forEach([&, memoKey = memoKey](std::span<const int> trace, int cost)
+                      {
+                          if (trace.size() >= minLength)
+                          {
+                              const HashedTrace hashedTrace(trace);
+                              trimmed[memoKey].insert(hashedTrace.view(), cost);
+                          } });
+    }
+    memo = std::move(trimmed);
+}
+
+/**
+ * Aligns the current prefix of a case with the memo left behind by the previous prefixes
+ *
+ * @param caseId Case returned by openCase
+ * @return Alignment cost of the prefix, only bounds if the timeout was hit
+ * @throws std::out_of_range if the case is not open
+ */
+AlignmentResult OnlineAligner::currentCost(int64_t caseId)
+{
+    const auto state = findCase(caseId);
+    std::lock_guard<std::mutex> lock(state->mutex);
+    if (state->resultValid)
+    {
+        return state->result;
+    }
+
+    // the case memo becomes the memo of this thread for the duration of the alignment;
+    // entries are keyed by subtrace content, so every subproblem of the old prefix is a hit
+    std::swap(costTable, state->memo);
+    try
+    {
+        Deadline deadline{std::chrono::milliseconds(timeoutMs)};
+        state->result = alignAnytime(root, state->trace, deadline);
+    }
+    catch (...)
+    {
+        std::swap(costTable, state->memo);
+        throw;
+    }
+    std::swap(costTable, state->memo);
+    state->resultValid = true;
+
+    // halving the memo leaves room for the entries of the next few events before it has to be trimmed again
+    if (maxMemoEntries > 0 && costTableEntries(state->memo) > maxMemoEntries)
+    {
+        keepLongestEntries(state->memo, maxMemoEntries / 2);
+    }
+    return state->result;
+}
+
+void OnlineAligner::closeCase(int64_t caseId)
+{
+    std::lock_guard<std::mutex> lock(casesMutex);
+    cases.erase(caseId);
+}
+
+size_t OnlineAligner::evictIdleCases()
+{
+    std::lock_guard<std::mutex> lock(casesMutex);
+    return evictIdleCasesLocked(std::chrono::steady_clock::now());
+}
+
+size_t OnlineAligner::evictIdleCasesLocked(std::chrono::steady_clock::time_point now)
+{
+    if (maxIdle.count() <= 0)
+    {
+        return 0;
+    }
+
+    lastSweep = now;
+    const auto idleSince = now - maxIdle;
+    size_t evicted = 0;
+    for (auto it = cases.begin(); it != cases.end();)
+    {
+        if (it->second->lastAccess < idleSince)
+        {
+            it = cases.erase(it);
+            ++evicted;
+        }
+        else
+        {
+            ++it;
+        }
+    }
+    return evicted;
+}
+
+size_t OnlineAligner::openCases() const
+{
+    std::lock_guard<std::mutex> lock(casesMutex);
+    return cases.size();
+}
+
+size_t OnlineAligner::memoEntries(int64_t caseId) const
+{
+    std::shared_ptr<CaseState> state;
+    {
+        std::lock_guard<std::mutex> lock(casesMutex);
+        const auto it = cases.find(caseId);
+        if (it == cases.end())
+        {
+            return 0;
+        }
+        state = it->second;
+    }
+    std::lock_guard<std::mutex> lock(state->mutex);
+    return costTableEntries(state->memo);
+}
@@ -0,0 +1,66 @@
+#ifndef ONLINEALIGNMENT_H
+#define ONLINEALIGNMENT_H
+#include "treeAlignment.h"
+#include "treeNode.h"
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+// Conformance checking of running cases whose events arrive one at a time.
+// Every open case keeps its own memo between events, so after an append only the
+// subproblems that contain the new event have to be aligned again. The map of cases is only
+// locked to look a case up; alignments of different cases run concurrently.
+class OnlineAligner
+{
+public:
+    // maxMemoEntries caps the memo of a single case (0 = unlimited): above it, the case keeps the longest half of its
+    // entries. Cases untouched for longer than maxIdle are dropped by evictIdleCases and by openCase sweeps
+    // (non-positive = never)
+    OnlineAligner(std::shared_ptr<TreeNode> root, size_t maxMemoEntries, std::chrono::milliseconds maxIdle, int timeoutMs);
+
+    int64_t openCase();
+
+    void appendEvent(int64_t caseId, int activity);
+
+    // cost of the prefix seen so far
+    AlignmentResult currentCost(int64_t caseId);
+
+    void closeCase(int64_t caseId);
+
+    size_t evictIdleCases();
+
+    size_t openCases() const;
+
+    size_t memoEntries(int64_t caseId) const;
+
+private:
+    // guarded by its own mutex, except lastAccess which belongs to casesMutex
+    struct CaseState
+    {
+        std::mutex mutex;
+        std::vector<int> trace;
+        CostTable memo;
+        AlignmentResult result;
+        bool resultValid;
+        std::chrono::steady_clock::time_point lastAccess;
+    };
+
+    // pins the case, so closing or evicting it meanwhile does not free it under a running alignment
+    std::shared_ptr<CaseState> findCase(int64_t caseId);
+
+    size_t evictIdleCasesLocked(std::chrono::steady_clock::time_point now);
+
+    std::shared_ptr<TreeNode> root;
+    size_t maxMemoEntries;
+    std::chrono::milliseconds maxIdle;
+    int timeoutMs;
+    int64_t nextCaseId;
+    std::chrono::steady_clock::time_point lastSweep;
+    std::unordered_map<int64_t, std::shared_ptr<CaseState>> cases;
+    mutable std::mutex casesMutex;
+};
+
+#endif // ONLINEALIGNMENT_H
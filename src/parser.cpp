@@ -7,7 +7,10 @@
 #include <filesystem>
 #include <fstream>
 #include <iostream>
+#include <map>
+#include <mutex>
 #include <random>
+#include <shared_mutex>
 #include <span>
 #include <string>
 #include <unordered_map>
@@ -15,11 +18,66 @@
 
 /**
  * Global dictionaries for activity handling
- * These maps provide bidirectional mapping between activity names and their integer IDs
+ * These maps provide bidirectional mapping between activity names and their integer IDs.
+ * They are shared by all loaded trees and only ever grow, so an encoded trace stays valid
+ * for every tree and loading another tree never changes the id of a label. Reloading a
+ * tree adds nothing, so a long-running process does not grow them with every load.
  */
 std::unordered_map<std::string, int> activitiesToInt; // Maps activity names to integer IDs
 std::unordered_map<int, std::string> idToActivity;    // Maps integer IDs back to activity names
-std::unordered_map<int, std::shared_ptr<TreeNode>> tempNodeMap;
+// (label, occurrence) -> id of a shadowed duplicate leaf, so reloading a tree reuses the ids of its earlier loads
+std::map<std::pair<std::string, int>, int> shadowedActivities;
+std::shared_mutex activityDictionaryMutex;
+
+/**
+ * Returns the id of a label, adding it to the dictionary if it is new
+ *
+ * @param label Activity label
+ * @return Id shared by every tree containing the label
+ */
+int registerActivity(const std::string &label)
+{
+    std::unique_lock<std::shared_mutex> lock(activityDictionaryMutex);
+    const auto [it, inserted] = activitiesToInt.try_emplace(label, static_cast<int>(idToActivity.size()));
+    if (inserted)
+    {
+        idToActivity[it->second] = label;
+    }
+    return it->second;
+}
+
+/**
+ * Returns an id that no label maps to, so no event ever matches it. The id only depends on the label and the
+ * occurrence, so the dictionary grows with the most duplicates any tree has, not with the number of loads.
+ *
+ * @param label Activity label, only kept for printing
+ * @param occurrence Index of the shadowed leaf among the shadowed leaves with this label in its tree
+ * @return Id shared by the same occurrence in every tree
+ */
+int registerShadowedActivity(const std::string &label, int occurrence)
+{
+    std::unique_lock<std::shared_mutex> lock(activityDictionaryMutex);
+    const auto [it, inserted] = shadowedActivities.try_emplace({label, occurrence}, static_cast<int>(idToActivity.size()));
+    if (inserted)
+    {
+        idToActivity[it->second] = label;
+    }
+    return it->second;
+}
+
+std::string activityLabel(int activity)
+{
+    std::shared_lock<std::shared_mutex> lock(activityDictionaryMutex);
+    const auto it = idToActivity.find(activity);
+    return it != idToActivity.end() ? it->second : "Unknown Activity (ID: " + std::to_string(activity) + ")";
+}
+
+// node ids are numbered per tree, leaves get their activity ids once the whole tree is known
+struct ParseState
+{
+    int nextNodeId = 0;
+    std::vector<std::pair<std::shared_ptr<TreeNode>, std::string>> leaves;
+};
 
 /**
  * Advances the position pointer past any whitespace characters
@@ -88,15 +146,52 @@ std::string parseQuotedString(const std::string &s, size_t &pos)
     return value;
 }
 
+/**
+ * Builds the sequence node ->(redo, do) with the negated loop id,
+ * dynAlignLoop aligns the (redo do)* part of a loop trace with it
+ *
+ * @param loopNode A REDO_LOOP node with its two children already set
+ * @return The helper, to be stored with setLoopHelper
+ */
+std::shared_ptr<TreeNode> createLoopHelper(const std::shared_ptr<TreeNode> &loopNode)
+{
+    const auto &children = loopNode->getChildren();
+    const int tempNodeId = loopNode->getId() * -1;
+    std::shared_ptr<TreeNode> tempNode = std::make_shared<TreeNode>(SEQUENCE, tempNodeId);
+    tempNode->addChild(children[1]);
+    tempNode->addChild(children[0]);
+    tempNode->fillActivityMaps();
+    return tempNode;
+}
+
+/**
+ * Computes alphabets and loop helpers bottom up, once every leaf has its activity id
+ *
+ * @param node Root of the subtree
+ */
+void fillTreeMaps(const std::shared_ptr<TreeNode> &node)
+{
+    for (const auto &child : node->getChildren())
+    {
+        fillTreeMaps(child);
+    }
+    node->fillActivityMaps();
+    if (node->getOperation() == REDO_LOOP)
+    {
+        node->setLoopHelper(createLoopHelper(node));
+    }
+}
+
 /**
  * Recursively parses a tree node from the input string
  *
  * @param treeString The input string representing the process tree
  * @param pos Position reference that will be updated
+ * @param state Node id counter and leaves of the tree parsed so far
  * @return A shared pointer to the parsed TreeNode
  * @throws std::runtime_error for various parsing errors
  */
-std::shared_ptr<TreeNode> parseNode(const std::string &treeString, size_t &pos)
+std::shared_ptr<TreeNode> parseNode(const std::string &treeString, size_t &pos, ParseState &state)
 {
     skipWhitespace(treeString, pos);
 
@@ -109,16 +204,15 @@ std::shared_ptr<TreeNode> parseNode(const std::string &treeString, size_t &pos)
     if (treeString[pos] == '\'')
     {
         std::string activityName = parseQuotedString(treeString, pos);
-        auto newNode = std::make_shared<TreeNode>(ACTIVITY);
-        idToActivity[newNode->getId()] = activityName;
-        activitiesToInt[activityName] = newNode->getId();
+        auto newNode = std::make_shared<TreeNode>(ACTIVITY, ++state.nextNodeId);
+        state.leaves.emplace_back(newNode, std::move(activityName));
         return newNode;
     }
 
     // Case 2: Silent activity (tau)
     if (matchString(treeString, pos, "tau"))
     {
-        return std::make_shared<TreeNode>(SILENT_ACTIVITY);
+        return std::make_shared<TreeNode>(SILENT_ACTIVITY, ++state.nextNodeId);
     }
 
     // Case 3: Operator node
@@ -162,7 +256,7 @@ std::shared_ptr<TreeNode> parseNode(const std::string &treeString, size_t &pos)
 
     while (pos < treeString.length() && treeString[pos] != ')')
     {
-        children.push_back(parseNode(treeString, pos)); // Recursive call to parse child
+        children.push_back(parseNode(treeString, pos, state)); // Recursive call to parse child
 
         skipWhitespace(treeString, pos);
 
@@ -195,7 +289,7 @@ std::shared_ptr<TreeNode> parseNode(const std::string &treeString, size_t &pos)
     pos++; // Consume ')'
 
     // Create the appropriate node based on operation type
-    std::shared_ptr<TreeNode> node = std::make_shared<TreeNode>(operation);
+    std::shared_ptr<TreeNode> node = std::make_shared<TreeNode>(operation, ++state.nextNodeId);
 
     // Add all children to the node
     for (const auto &child : children)
@@ -204,34 +298,11 @@ std::shared_ptr<TreeNode> parseNode(const std::string &treeString, size_t &pos)
     }
 
     // Validate redo loop has exactly 2 children
-    if (operation == REDO_LOOP)
+    if (operation == REDO_LOOP && children.size() != 2)
     {
-        if (children.size() != 2)
-        {
-            throw std::runtime_error("Loop node does not exactly have 2 children");
-        }
-        else
-        {
-            const int tempNodeId = node->getId() * -1;
-            std::shared_ptr<TreeNode> tempNode = std::make_shared<TreeNode>(SEQUENCE, tempNodeId);
-            tempNodeMap[tempNodeId] = tempNode;
-            tempNode->addChild(children[1]);
-            tempNode->addChild(children[0]);
-            std::unordered_set<int> allActivities;
-            allActivities.reserve(children[0]->getActivities().size() + children[1]->getActivities().size());
-
-            std::set_union(
-                children[0]->getActivities().begin(), children[0]->getActivities().end(),
-                children[1]->getActivities().begin(), children[1]->getActivities().end(),
-                std::inserter(allActivities, allActivities.begin()));
-
-            tempNode->setActivities(allActivities);
-        }
+        throw std::runtime_error("Loop node does not exactly have 2 children");
     }
 
-    // not very efficient for frequent tree building but fine if align many traces with a tree
-    /// TODO perhaps change this function if everything works
-    node->fillActivityMaps();
     return node;
 }
 
@@ -245,6 +316,7 @@ std::vector<int> convertStringTrace(const std::vector<std::string> &trace)
 {
     std::vector<int> intTrace;
     intTrace.reserve(trace.size());
+    std::shared_lock<std::shared_mutex> lock(activityDictionaryMutex);
 
     for (const auto &activity : trace)
     {
@@ -274,7 +346,8 @@ std::shared_ptr<TreeNode> parseProcessTreeString(const std::string &treeString)
 {
     // Start parsing from the beginning of the string
     size_t pos = 0;
-    std::shared_ptr<TreeNode> root = parseNode(treeString, pos);
+    ParseState state;
+    std::shared_ptr<TreeNode> root = parseNode(treeString, pos, state);
 
     // Ensure the entire string was consumed
     skipWhitespace(treeString, pos);
@@ -285,11 +358,21 @@ std::shared_ptr<TreeNode> parseProcessTreeString(const std::string &treeString)
                                  treeString.substr(pos, std::min(treeString.length() - pos, (size_t)20)) + "...'.");
     }
 
-    // After successfully parsing, initialize activity maps for the entire tree
-    if (root)
+    // The alignment assumes unique labels: as before, only the last leaf with a label matches its events,
+    // earlier leaves with the same label get ids no event maps to
+    std::unordered_map<std::string, std::shared_ptr<TreeNode>> lastLeaf;
+    for (const auto &[leaf, label] : state.leaves)
+    {
+        lastLeaf[label] = leaf;
+    }
+    std::unordered_map<std::string, int> shadowedLeaves;
+    for (const auto &[leaf, label] : state.leaves)
     {
-        root->fillActivityMaps(); // Traverses the tree to build complete activity maps
+        leaf->setActivity(lastLeaf[label] == leaf ? registerActivity(label) : registerShadowedActivity(label, shadowedLeaves[label]++));
     }
 
+    // After successfully parsing, initialize activity maps for the entire tree
+    fillTreeMaps(root);
+
     return root; // Return the root node
 }
\ No newline at end of file
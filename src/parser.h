@@ -7,8 +7,10 @@
 
 extern std::unordered_map<std::string, int> activitiesToInt;
 extern std::unordered_map<int, std::string> idToActivity;
-extern std::unordered_map<int, std::shared_ptr<TreeNode>> tempNodeMap;
 
+int registerActivity(const std::string &label);
+std::string activityLabel(int activity);
+std::shared_ptr<TreeNode> createLoopHelper(const std::shared_ptr<TreeNode> &loopNode);
 std::vector<int> convertStringTrace(const std::vector<std::string> &trace);
 std::shared_ptr<TreeNode> parseProcessTreeString(const std::string& treeString);
-#endif PARSER_H
\ No newline at end of file
+#endif // PARSER_H
\ No newline at end of file
@@ -0,0 +1,194 @@
+#include "perfectFit.h"
+#include <algorithm>
+#include <vector>
+
+// Activity ids are unique within a parsed tree (the parser gives shadowed duplicates private ids), so every event
+// belongs to exactly one child of an operator. That makes the decomposition of a fitting trace unique up to empty
+// loop iterations: a sequence sees its children's events in child order, a parallel sees the projections and an
+// xor the child of the first event. Each step builds a run of the tree, so an accepted trace always fits.
+
+// splitting a loop run into iterations is quadratic and nested loops multiply the splits, so beyond this many
+// attempts over the whole check it gives up and leaves the trace to the full alignment
+constexpr size_t maxSplitAttempts = 1 << 16;
+
+// attempts counts the iteration splits tried so far by the whole check
+bool accepts(const TreeNode &node, std::span<const int> trace, size_t &attempts);
+
+bool containsLoop(const TreeNode &node)
+{
+    if (node.getOperation() == REDO_LOOP)
+    {
+        return true;
+    }
+    for (const auto &child : node.getChildren())
+    {
+        if (containsLoop(*child))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+// run is one or more iterations of a loop child; between two of them the other child runs empty, which needs repeatable
+bool acceptsIterations(const TreeNode &child, std::span<const int> run, bool repeatable, size_t &attempts)
+{
+    if (accepts(child, run, attempts))
+    {
+        return true;
+    }
+    if (!repeatable)
+    {
+        return false;
+    }
+
+    // without a loop inside, an iteration holds every activity of the child at most once
+    const size_t maxLength = containsLoop(child) ? run.size() : child.getActivities().size();
+
+    // word break over the run: reachable[i] if run[0..i) splits into whole iterations
+    std::vector<char> reachable(run.size() + 1, false);
+    reachable[0] = true;
+    for (size_t start = 0; start < run.size(); ++start)
+    {
+        if (!reachable[start])
+        {
+            continue;
+        }
+        for (size_t end = start + 1; end <= std::min(run.size(), start + maxLength); ++end)
+        {
+            if (reachable[end] || end - start == run.size())
+            {
+                continue;
+            }
+            if (++attempts > maxSplitAttempts)
+            {
+                return false;
+            }
+            if (accepts(child, run.subspan(start, end - start), attempts))
+            {
+                reachable[end] = true;
+            }
+        }
+    }
+    return reachable[run.size()];
+}
+
+bool accepts(const TreeNode &node, std::span<const int> trace, size_t &attempts)
+{
+    // every visible move of the cheapest run is an event
+    if (static_cast<int>(trace.size()) < node.getMinModelCost())
+    {
+        return false;
+    }
+
+    const auto &children = node.getChildren();
+    switch (node.getOperation())
+    {
+    case ACTIVITY:
+        return trace.size() == 1 && trace[0] == node.getActivity();
+    case SILENT_ACTIVITY:
+        return trace.empty();
+    case XOR:
+    {
+        if (trace.empty())
+        {
+            // minModelCost is 0, so some child can be skipped
+            return true;
+        }
+        const int child = node.childIndexOf(trace[0]);
+        return child >= 0 && accepts(*children[child], trace, attempts);
+    }
+    case SEQUENCE:
+    {
+        // bounds[i] is where the part of child i starts, the child indices of the events must not decrease
+        std::vector<size_t> bounds(children.size() + 1, trace.size());
+        size_t position = 0;
+        for (size_t child = 0; child < children.size(); ++child)
+        {
+            bounds[child] = position;
+            while (position < trace.size() && node.childIndexOf(trace[position]) == static_cast<int>(child))
+            {
+                ++position;
+            }
+        }
+        if (position < trace.size())
+        {
+            return false;
+        }
+        for (size_t child = 0; child < children.size(); ++child)
+        {
+            if (!accepts(*children[child], trace.subspan(bounds[child], bounds[child + 1] - bounds[child]), attempts))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+    case PARALLEL:
+    {
+        std::vector<std::vector<int>> projections(children.size());
+        for (const int activity : trace)
+        {
+            const int child = node.childIndexOf(activity);
+            if (child < 0)
+            {
+                return false;
+            }
+            projections[child].push_back(activity);
+        }
+        for (size_t child = 0; child < children.size(); ++child)
+        {
+            if (!accepts(*children[child], projections[child], attempts))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+    case REDO_LOOP:
+    {
+        // do (redo do)*: maximal runs of do and redo events alternate, a trace starting or ending
+        // with redo events has an empty do part there
+        const bool doSkippable = children[0]->getMinModelCost() == 0;
+        const bool redoSkippable = children[1]->getMinModelCost() == 0;
+        if (trace.empty())
+        {
+            return doSkippable;
+        }
+
+        size_t start = 0;
+        while (start < trace.size())
+        {
+            const int child = node.childIndexOf(trace[start]);
+            if (child < 0)
+            {
+                return false;
+            }
+            size_t end = start + 1;
+            while (end < trace.size() && node.childIndexOf(trace[end]) == child)
+            {
+                ++end;
+            }
+            if (child == 1 && (start == 0 || end == trace.size()) && !doSkippable)
+            {
+                return false;
+            }
+            if (!acceptsIterations(*children[child], trace.subspan(start, end - start), child == 0 ? redoSkippable : doSkippable,
+                                   attempts))
+            {
+                return false;
+            }
+            start = end;
+        }
+        return true;
+    }
+    default:
+        return false;
+    }
+}
+
+bool fitsPerfectly(const TreeNode &root, std::span<const int> trace)
+{
+    size_t attempts = 0;
+    return accepts(root, trace, attempts);
+}
@@ -0,0 +1,11 @@
+#ifndef PERFECTFIT_H
+#define PERFECTFIT_H
+#include "treeNode.h"
+#include <span>
+
+// Whether the trace is a word of the language of the tree, i.e. aligns with cost 0. Runs in O(|trace| * depth)
+// unless a loop has to split a run into several iterations. Never accepts a trace that does not fit; it may only
+// miss fitting traces of hand-built trees in which two leaves share an activity.
+bool fitsPerfectly(const TreeNode &root, std::span<const int> trace);
+
+#endif // PERFECTFIT_H
@@ -0,0 +1,361 @@
+#include "shardedAlignment.h"
+#include "eventLog.h"
+#include "parser.h"
+#include "treeNormalization.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <stdexcept>
+
+// first line of a partial result file, bumped whenever the layout changes
+const std::string partialResultHeader = "tree-alignment-partial 2";
+
+constexpr uint64_t fnvOffset = 0xcbf29ce484222325;
+constexpr uint64_t fnvPrime = 0x100000001b3;
+
+uint64_t fnv1a(const std::string &text, uint64_t hash = fnvOffset)
+{
+    for (const unsigned char c : text)
+    {
+        hash = (hash ^ c) * fnvPrime;
+    }
+    return hash;
+}
+
+uint64_t variantHash(const std::vector<std::string> &trace)
+{
+    uint64_t hash = fnvOffset;
+    for (const auto &activity : trace)
+    {
+        // a separator keeps ["ab"] and ["a", "b"] apart
+        hash = (fnv1a(activity, hash) ^ 0x1f) * fnvPrime;
+    }
+    return hash;
+}
+
+uint64_t modelFingerprint(const std::string &tree)
+{
+    return fnv1a(tree);
+}
+
+void ShardStats::add(const ShardStats &other)
+{
+    cases += other.cases;
+    variants += other.variants;
+    fitting += other.fitting;
+    exact += other.exact;
+    totalCost += other.totalCost;
+    memoHits += other.memoHits;
+    memoMisses += other.memoMisses;
+    memoSkips += other.memoSkips;
+    memoBytes += other.memoBytes;
+    millis += other.millis;
+}
+
+double ShardStats::memoHitRate() const
+{
+    const size_t lookups = memoHits + memoMisses;
+    return lookups == 0 ? 0.0 : static_cast<double>(memoHits) / lookups;
+}
+
+std::vector<std::string> splitTabs(const std::string &line)
+{
+    std::vector<std::string> fields;
+    std::stringstream stream(line);
+    std::string field;
+    while (std::getline(stream, field, '\t'))
+    {
+        fields.push_back(field);
+    }
+    return fields;
+}
+
+/**
+ * Reads a trace file with one case per line: the case id, then the activities in order, separated by tabs.
+ * Empty fields are ignored, so a case id alone is an empty trace; empty lines are skipped.
+ *
+ * @param path Path of the trace file
+ * @return The cases in file order
+ * @throws std::runtime_error if the file cannot be read
+ */
+TraceFile readTraceFile(const std::string &path)
+{
+    std::ifstream input(path);
+    if (!input)
+    {
+        throw std::runtime_error("Cannot open trace file " + path + ".");
+    }
+
+    TraceFile log;
+    std::string line;
+    while (std::getline(input, line))
+    {
+        if (!line.empty() && line.back() == '\r')
+        {
+            line.pop_back();
+        }
+        if (line.empty())
+        {
+            continue;
+        }
+        auto fields = splitTabs(line);
+        log.caseNames.push_back(fields[0]);
+        auto &trace = log.traces.emplace_back();
+        for (size_t i = 1; i < fields.size(); ++i)
+        {
+            if (!fields[i].empty())
+            {
+                trace.push_back(std::move(fields[i]));
+            }
+        }
+    }
+    return log;
+}
+
+/**
+ * Aligns one shard of a trace file. Cases are assigned by the hash of their trace, so all cases of a variant
+ * end up in the same shard and are aligned once; the trie schedule and warm memos work within the shard as usual.
+ *
+ * @param tree Process tree string, its fingerprint is stored in the result
+ * @param log All cases of the trace file
+ * @param shard Index of the shard to align
+ * @param shards Number of shards
+ * @param options Batch options of the worker process
+ * @return The results of the cases in the shard, in trace file order
+ * @throws std::invalid_argument if shard is not below shards
+ */
+PartialResult alignShard(const std::string &tree, const TraceFile &log, size_t shard, size_t shards, const BatchOptions &options)
+{
+    if (shard >= shards)
+    {
+        throw std::invalid_argument("Shard " + std::to_string(shard) + " does not exist, there are " + std::to_string(shards) + " shards.");
+    }
+
+    const auto root = normalizeTree(parseProcessTreeString(tree));
+
+    std::vector<size_t> indices;
+    std::vector<std::vector<int>> traces;
+    for (size_t i = 0; i < log.traces.size(); ++i)
+    {
+        if (variantHash(log.traces[i]) % shards == shard)
+        {
+            indices.push_back(i);
+            traces.push_back(convertStringTrace(log.traces[i]));
+        }
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    const EventLog grouped = groupTraces(traces);
+    BatchStats batchStats;
+    const auto results = alignLog(root, grouped, options, &batchStats);
+
+    PartialResult partial;
+    partial.model = modelFingerprint(tree);
+    partial.shard = shard;
+    partial.shards = shards;
+    partial.stats.millis = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    partial.stats.variants = grouped.variants.size();
+    partial.stats.memoHits = batchStats.memoHits;
+    partial.stats.memoMisses = batchStats.memoMisses;
+    partial.stats.memoSkips = batchStats.memoSkips;
+    partial.stats.memoBytes = batchStats.memoBytes;
+
+    partial.cases.reserve(results.size());
+    for (size_t i = 0; i < results.size(); ++i)
+    {
+        const size_t index = indices[grouped.caseIds[i]];
+        partial.cases.push_back({index, log.caseNames[index], results[i]});
+
+        partial.stats.cases++;
+        partial.stats.fitting += results[i].exact && results[i].cost == 0;
+        partial.stats.exact += results[i].exact;
+        partial.stats.totalCost += results[i].cost;
+    }
+    return partial;
+}
+
+std::string hex(uint64_t value)
+{
+    std::ostringstream stream;
+    stream << std::hex << std::setw(16) << std::setfill('0') << value;
+    return stream.str();
+}
+
+// writes to a temporary file first, so a reader on a shared filesystem never sees a half-written result
+void writeAtomically(const std::string &path, const std::string &content)
+{
+    const std::string temporary = path + ".tmp";
+    {
+        std::ofstream output(temporary, std::ios::binary | std::ios::trunc);
+        output << content;
+        if (!output.flush())
+        {
+            throw std::runtime_error("Cannot write " + temporary + ".");
+        }
+    }
+    if (std::rename(temporary.c_str(), path.c_str()) != 0)
+    {
+        throw std::runtime_error("Cannot move " + temporary + " to " + path + ".");
+    }
+}
+
+void writePartialResult(const PartialResult &partial, const std::string &path)
+{
+    std::ostringstream output;
+    output << std::setprecision(17);
+    output << partialResultHeader << "\n";
+    output << "model " << hex(partial.model) << "\n";
+    output << "shard " << partial.shard << " " << partial.shards << "\n";
+    const auto &stats = partial.stats;
+    output << "stats " << stats.cases << " " << stats.variants << " " << stats.fitting << " " << stats.exact << " " << stats.totalCost << " "
+           << stats.memoHits << " " << stats.memoMisses << " " << stats.memoSkips << " " << stats.memoBytes << " " << stats.millis << "\n";
+    // the case id goes last and is read up to the end of the line
+    for (const auto &row : partial.cases)
+    {
+        output << row.index << "\t" << row.result.cost << "\t" << row.result.lowerBound << "\t" << row.result.exact << "\t" << row.caseName << "\n";
+    }
+    writeAtomically(path, output.str());
+}
+
+/**
+ * Reads a file written by writePartialResult
+ *
+ * @param path Path of the partial result
+ * @return The partial result
+ * @throws std::runtime_error if the file is missing, of another version or truncated
+ */
+PartialResult readPartialResult(const std::string &path)
+{
+    std::ifstream input(path);
+    if (!input)
+    {
+        throw std::runtime_error("Cannot open partial result " + path + ".");
+    }
+    const auto malformed = [&path](const std::string &what)
+    {
+        return std::runtime_error("Partial result " + path + " is malformed: " + what + ".");
+    };
+
+    std::string line;
+    if (!std::getline(input, line) || line != partialResultHeader)
+    {
+        throw malformed("unknown header");
+    }
+
+    PartialResult partial;
+    std::string key;
+    std::string model;
+    if (!(input >> key >> model) || key != "model")
+    {
+        throw malformed("missing model fingerprint");
+    }
+    partial.model = std::stoull(model, nullptr, 16);
+    if (!(input >> key >> partial.shard >> partial.shards) || key != "shard")
+    {
+        throw malformed("missing shard");
+    }
+    auto &stats = partial.stats;
+    if (!(input >> key >> stats.cases >> stats.variants >> stats.fitting >> stats.exact >> stats.totalCost >> stats.memoHits >> stats.memoMisses >>
+          stats.memoSkips >> stats.memoBytes >> stats.millis) ||
+        key != "stats")
+    {
+        throw malformed("missing stats");
+    }
+    std::getline(input, line);
+
+    partial.cases.reserve(stats.cases);
+    while (std::getline(input, line))
+    {
+        std::istringstream row(line);
+        CaseResult result;
+        int exact;
+        if (!(row >> result.index >> result.result.cost >> result.result.lowerBound >> exact) || row.get() != '\t')
+        {
+            throw malformed("bad case line '" + line + "'");
+        }
+        result.result.exact = exact != 0;
+        std::getline(row, result.caseName);
+        partial.cases.push_back(std::move(result));
+    }
+    if (partial.cases.size() != stats.cases)
+    {
+        throw malformed("expected " + std::to_string(stats.cases) + " cases, found " + std::to_string(partial.cases.size()));
+    }
+    return partial;
+}
+
+/**
+ * Combines the partial results of all shards. The result does not depend on the order of the partials or on
+ * which process computed which shard: cases are ordered by their line in the trace file.
+ *
+ * @param partials One partial result per shard
+ * @return All cases in trace file order with the summed stats
+ * @throws std::runtime_error if the partials belong to different trees or shardings, or a shard is missing or duplicated
+ */
+MergedResult mergePartialResults(const std::vector<PartialResult> &partials)
+{
+    if (partials.empty())
+    {
+        throw std::runtime_error("Nothing to merge.");
+    }
+
+    MergedResult merged;
+    merged.model = partials[0].model;
+    merged.shards = partials[0].shards;
+    std::vector<bool> seen(merged.shards, false);
+    for (const auto &partial : partials)
+    {
+        if (partial.model != merged.model)
+        {
+            throw std::runtime_error("Partial results were computed against different trees (" + hex(merged.model) + " and " + hex(partial.model) + ").");
+        }
+        if (partial.shards != merged.shards || partial.shard >= merged.shards)
+        {
+            throw std::runtime_error("Partial results come from different shardings.");
+        }
+        if (seen[partial.shard])
+        {
+            throw std::runtime_error("Shard " + std::to_string(partial.shard) + " was given twice.");
+        }
+        seen[partial.shard] = true;
+
+        merged.stats.add(partial.stats);
+        merged.maxShardMillis = std::max(merged.maxShardMillis, partial.stats.millis);
+        merged.cases.insert(merged.cases.end(), partial.cases.begin(), partial.cases.end());
+    }
+
+    const auto missing = std::find(seen.begin(), seen.end(), false);
+    if (missing != seen.end())
+    {
+        throw std::runtime_error("Shard " + std::to_string(missing - seen.begin()) + " of " + std::to_string(merged.shards) + " is missing.");
+    }
+
+    std::sort(merged.cases.begin(), merged.cases.end(), [](const CaseResult &lhs, const CaseResult &rhs)
+              { return lhs.index < rhs.index; });
+    const auto duplicate = std::adjacent_find(merged.cases.begin(), merged.cases.end(), [](const CaseResult &lhs, const CaseResult &rhs)
+                                              { return lhs.index == rhs.index; });
+    if (duplicate != merged.cases.end())
+    {
+        throw std::runtime_error("Case on line " + std::to_string(duplicate->index) + " appears in more than one shard.");
+    }
+    return merged;
+}
+
+void writeMergedResult(const MergedResult &merged, const std::string &path)
+{
+    std::ostringstream output;
+    output << "case\tcost\tlowerBound\texact\n";
+    for (const auto &row : merged.cases)
+    {
+        output << row.caseName << "\t" << row.result.cost << "\t" << row.result.lowerBound << "\t" << row.result.exact << "\n";
+    }
+    writeAtomically(path, output.str());
+}
+
+std::string partialResultPath(const std::string &output, size_t shard, size_t shards)
+{
+    return output + ".shard" + std::to_string(shard) + "-of-" + std::to_string(shards);
+}
@@ -0,0 +1,89 @@
+#ifndef SHARDEDALIGNMENT_H
+#define SHARDEDALIGNMENT_H
+#include "batchAlignment.h"
+#include "treeAlignment.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Cases of a trace file, one line per case: the case id followed by its activities, all separated by tabs
+struct TraceFile
+{
+    std::vector<std::string> caseNames;
+    std::vector<std::vector<std::string>> traces;
+};
+
+TraceFile readTraceFile(const std::string &path);
+
+// FNV-1a over the labels, so the shard of a variant is the same on every machine and in every run
+uint64_t variantHash(const std::vector<std::string> &trace);
+
+// identifies the tree a partial result was computed against
+uint64_t modelFingerprint(const std::string &tree);
+
+struct ShardStats
+{
+    size_t cases = 0;
+    size_t variants = 0;
+    // cases with cost 0
+    size_t fitting = 0;
+    size_t exact = 0;
+    int64_t totalCost = 0;
+    size_t memoHits = 0;
+    size_t memoMisses = 0;
+    // subproblems solved without the memo
+    size_t memoSkips = 0;
+    // approximate bytes of the memos held at the end
+    size_t memoBytes = 0;
+    // wall time of the alignment, summed over shards after merging
+    double millis = 0;
+
+    void add(const ShardStats &other);
+
+    double memoHitRate() const;
+};
+
+struct CaseResult
+{
+    // line of the case in the trace file
+    size_t index;
+    std::string caseName;
+    AlignmentResult result;
+};
+
+// what a worker process writes for its shard
+struct PartialResult
+{
+    uint64_t model = 0;
+    size_t shard = 0;
+    size_t shards = 1;
+    ShardStats stats;
+    std::vector<CaseResult> cases;
+};
+
+struct MergedResult
+{
+    uint64_t model = 0;
+    size_t shards = 0;
+    ShardStats stats;
+    // the slowest shard bounds the wall time of a run with one process per shard
+    double maxShardMillis = 0;
+    // in trace file order
+    std::vector<CaseResult> cases;
+};
+
+// aligns the cases of the trace file whose variant hash falls into the shard
+PartialResult alignShard(const std::string &tree, const TraceFile &log, size_t shard, size_t shards, const BatchOptions &options);
+
+void writePartialResult(const PartialResult &partial, const std::string &path);
+
+PartialResult readPartialResult(const std::string &path);
+
+MergedResult mergePartialResults(const std::vector<PartialResult> &partials);
+
+void writeMergedResult(const MergedResult &merged, const std::string &path);
+
+// path of the partial result of a shard next to the merged output
+std::string partialResultPath(const std::string &output, size_t shard, size_t shards);
+
+#endif // SHARDEDALIGNMENT_H
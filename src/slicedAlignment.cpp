@@ -0,0 +1,177 @@
+#include "slicedAlignment.h"
+#include "batchAlignment.h"
+#include <algorithm>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+AlignmentTask::AlignmentTask(std::shared_ptr<TreeNode> root, std::vector<int> trace, CostTable checkpoint, const std::string &frames)
+    : alignment(std::move(root), std::move(trace)), memo(std::move(checkpoint)), slicesRun(0), timeSpent(0)
+{
+    if (!frames.empty())
+    {
+        alignment.loadFrames(frames);
+    }
+}
+
+/**
+ * Continues the alignment for at most one slice on the calling thread
+ *
+ * @param slice Time until the task is suspended again, non-positive runs it to the end
+ * @return Whether the cost is exact now
+ */
+bool AlignmentTask::resume(std::chrono::milliseconds slice)
+{
+    if (alignment.done())
+    {
+        return true;
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    // the task memo becomes the memo of this thread for the duration of the slice
+    std::swap(costTable, memo);
+    try
+    {
+        Deadline deadline{slice};
+        alignment.run(deadline);
+    }
+    catch (...)
+    {
+        std::swap(costTable, memo);
+        throw;
+    }
+    std::swap(costTable, memo);
+
+    slicesRun++;
+    timeSpent += std::chrono::steady_clock::now() - start;
+    return alignment.done();
+}
+
+bool AlignmentTask::done() const
+{
+    return alignment.done();
+}
+
+AlignmentResult AlignmentTask::result() const
+{
+    return alignment.bounds();
+}
+
+size_t AlignmentTask::slices() const
+{
+    return slicesRun;
+}
+
+std::chrono::nanoseconds AlignmentTask::elapsed() const
+{
+    return timeSpent;
+}
+
+const CostTable &AlignmentTask::checkpoint() const
+{
+    return memo;
+}
+
+std::string AlignmentTask::suspendedFrames() const
+{
+    return alignment.saveFrames();
+}
+
+void AlignmentTask::release()
+{
+    CostTable().swap(memo);
+}
+
+/**
+ * Aligns every variant on a pool of threads. Workers take the task at the front of a shared queue, run one slice
+ * and put it back at the end unless it finished or used up its time, so all unfinished variants advance at the
+ * same pace. Tasks move freely between workers since all their state is in their frames and their memo.
+ *
+ * @param root Root of the process tree
+ * @param variants Encoded traces
+ * @param options Threads, slice length and time per variant
+ * @return One result per variant, in input order
+ */
+std::vector<AlignmentResult> alignVariantsSliced(const std::shared_ptr<TreeNode> &root, const std::vector<std::vector<int>> &variants,
+                                                 const SlicedOptions &options)
+{
+    std::vector<std::unique_ptr<AlignmentTask>> tasks;
+    tasks.reserve(variants.size());
+    std::deque<size_t> queue;
+    for (size_t variant = 0; variant < variants.size(); ++variant)
+    {
+        tasks.push_back(std::make_unique<AlignmentTask>(root, variants[variant]));
+        queue.push_back(variant);
+    }
+
+    std::vector<AlignmentResult> results(variants.size());
+    std::mutex queueMutex;
+    std::exception_ptr failure;
+    const auto timeout = std::chrono::milliseconds(options.timeoutMs);
+
+    const auto worker = [&]()
+    {
+        while (true)
+        {
+            size_t variant;
+            {
+                std::lock_guard<std::mutex> lock(queueMutex);
+                if (queue.empty() || failure)
+                {
+                    return;
+                }
+                variant = queue.front();
+                queue.pop_front();
+            }
+
+            auto &task = *tasks[variant];
+            try
+            {
+                // the last slice of a variant only gets the time it has left; a non-positive slice would mean no limit
+                auto slice = options.slice;
+                if (timeout.count() > 0)
+                {
+                    const auto left = std::max(std::chrono::milliseconds(1),
+                                               std::chrono::duration_cast<std::chrono::milliseconds>(timeout - task.elapsed()));
+                    slice = slice.count() > 0 ? std::min(slice, left) : left;
+                }
+                const bool finished = task.resume(slice) || (timeout.count() > 0 && task.elapsed() >= timeout);
+                if (finished)
+                {
+                    results[variant] = task.result();
+                    task.release();
+                    continue;
+                }
+            }
+            catch (...)
+            {
+                std::lock_guard<std::mutex> lock(queueMutex);
+                failure = std::current_exception();
+                return;
+            }
+
+            std::lock_guard<std::mutex> lock(queueMutex);
+            queue.push_back(variant);
+        }
+    };
+
+    const unsigned threadCount = resolveThreadCount(options.threads, variants.size());
+    std::vector<std::thread> pool;
+    for (unsigned i = 1; i < threadCount; ++i)
+    {
+        pool.emplace_back(worker);
+    }
+    worker();
+    for (auto &thread : pool)
+    {
+        thread.join();
+    }
+
+    if (failure)
+    {
+        std::rethrow_exception(failure);
+    }
+    return results;
+}
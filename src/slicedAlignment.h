@@ -0,0 +1,64 @@
+#ifndef SLICEDALIGNMENT_H
+#define SLICEDALIGNMENT_H
+#include "treeAlignment.h"
+#include "treeNode.h"
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+
+// An alignment that runs in time slices and stays suspended in between. Each slice steps a SuspendableAlignment with
+// the memo of the task swapped in, so a suspended task is its frames and its memo: it continues where it stopped, with
+// the split DPs of its sequences and loops half done, on any thread, or from a checkpoint in another process.
+class AlignmentTask
+{
+public:
+    // checkpoint is the memo of an earlier task, its entries for subtrees this tree shares with that one are reused;
+    // frames are the suspendedFrames of a task of the same trace against a tree of the same structure
+    AlignmentTask(std::shared_ptr<TreeNode> root, std::vector<int> trace, CostTable checkpoint = {},
+                  const std::string &frames = {});
+
+    // runs one slice (non-positive = until done), returns true once the cost is exact
+    bool resume(std::chrono::milliseconds slice);
+
+    bool done() const;
+
+    // exact once done, otherwise the bounds of the trace and of the best alignment found so far
+    AlignmentResult result() const;
+
+    size_t slices() const;
+
+    // time spent in resume
+    std::chrono::nanoseconds elapsed() const;
+
+    // the solved subproblems, the memo part of a checkpoint
+    const CostTable &checkpoint() const;
+
+    // the subproblems in progress, the frame part of a checkpoint
+    std::string suspendedFrames() const;
+
+    // frees the memo of a finished task, the result is kept
+    void release();
+
+private:
+    SuspendableAlignment alignment;
+    CostTable memo;
+    size_t slicesRun;
+    std::chrono::nanoseconds timeSpent;
+};
+
+struct SlicedOptions
+{
+    // 0 uses all hardware threads
+    unsigned threads = 0;
+    std::chrono::milliseconds slice{20};
+    // time per variant summed over its slices, <= 0 disables it
+    int timeoutMs = 60000;
+};
+
+// Aligns the variants on a fixed pool in round-robin time slices, so a few long traces cannot hold up the rest.
+// A variant that runs out of time keeps the bounds it reached.
+std::vector<AlignmentResult> alignVariantsSliced(const std::shared_ptr<TreeNode> &root, const std::vector<std::vector<int>> &variants,
+                                                 const SlicedOptions &options);
+
+#endif // SLICEDALIGNMENT_H
@@ -0,0 +1,133 @@
+#include "traceEvents.h"
+#include <fstream>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+std::atomic<bool> traceEventsEnabled(false);
+
+namespace
+{
+    struct TraceEvent
+    {
+        int nodeId;
+        Operation operation;
+        size_t traceLength;
+        bool memoHit;
+        int threadId;
+        double startMicros;
+        double durationMicros;
+    };
+
+    // guards the events and the settings below it
+    std::mutex traceMutex;
+    std::vector<TraceEvent> traceEvents;
+    std::chrono::steady_clock::time_point traceStart;
+    size_t traceMaxEvents = 0;
+    // read by every span before it takes the lock, so that short spans never contend for it
+    std::atomic<long long> traceThresholdMicros(0);
+    std::atomic<int> nextThreadId(0);
+
+    int currentThreadId()
+    {
+        thread_local const int threadId = nextThreadId.fetch_add(1);
+        return threadId;
+    }
+}
+
+/**
+ * Starts recording dynAlign spans, discarding anything recorded before
+ *
+ * @param thresholdMicros Spans shorter than this are not recorded
+ * @param maxEvents Recording stops silently once this many spans were kept
+ */
+void startTraceEvents(long long thresholdMicros, size_t maxEvents)
+{
+    std::lock_guard<std::mutex> lock(traceMutex);
+    traceEvents.clear();
+    traceStart = std::chrono::steady_clock::now();
+    traceThresholdMicros.store(thresholdMicros, std::memory_order_relaxed);
+    traceMaxEvents = maxEvents;
+    traceEventsEnabled.store(true);
+}
+
+void stopTraceEvents()
+{
+    traceEventsEnabled.store(false);
+}
+
+size_t recordedTraceEvents()
+{
+    std::lock_guard<std::mutex> lock(traceMutex);
+    return traceEvents.size();
+}
+
+/**
+ * Writes the recorded spans in the Chrome trace-event JSON format,
+ * which can be opened in chrome://tracing or ui.perfetto.dev
+ *
+ * @param path Output file
+ * @throws std::runtime_error if the file cannot be opened
+ */
+void writeTraceEvents(const std::string &path)
+{
+    std::ofstream out(path);
+    if (!out)
+    {
+        throw std::runtime_error("Could not open trace event file: " + path);
+    }
+
+    std::lock_guard<std::mutex> lock(traceMutex);
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    for (size_t i = 0; i < traceEvents.size(); ++i)
+    {
+        const auto &event = traceEvents[i];
+        out << "{\"name\":\"" << operationToString(event.operation) << " " << event.nodeId
+            << "\",\"cat\":\"dynAlign\",\"ph\":\"X\",\"pid\":1,\"tid\":" << event.threadId
+            << ",\"ts\":" << event.startMicros << ",\"dur\":" << event.durationMicros
+            << ",\"args\":{\"node\":" << event.nodeId
+            << ",\"operator\":\"" << operationToString(event.operation)
+            << "\",\"length\":" << event.traceLength
+            << ",\"memoHit\":" << (event.memoHit ? "true" : "false") << "}}";
+        out << (i + 1 < traceEvents.size() ? ",\n" : "\n");
+    }
+    out << "]}\n";
+}
+
+TraceSpan::TraceSpan(const TreeNode &node, size_t traceLength)
+    : active(traceEventsEnabled.load(std::memory_order_relaxed)), memoHit(false),
+      nodeId(node.getId()), operation(node.getOperation()), traceLength(traceLength)
+{
+    if (active)
+    {
+        start = std::chrono::steady_clock::now();
+    }
+}
+
+void TraceSpan::setMemoHit()
+{
+    memoHit = true;
+}
+
+TraceSpan::~TraceSpan()
+{
+    if (!active)
+    {
+        return;
+    }
+
+    const auto end = std::chrono::steady_clock::now();
+    const double durationMicros = std::chrono::duration<double, std::micro>(end - start).count();
+    if (durationMicros < traceThresholdMicros.load(std::memory_order_relaxed))
+    {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(traceMutex);
+    if (traceEvents.size() >= traceMaxEvents)
+    {
+        return;
+    }
+    const double startMicros = std::chrono::duration<double, std::micro>(start - traceStart).count();
+    traceEvents.push_back({nodeId, operation, traceLength, memoHit, currentThreadId(), startMicros, durationMicros});
+}
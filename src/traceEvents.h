@@ -0,0 +1,38 @@
+#ifndef TRACEEVENTS_H
+#define TRACEEVENTS_H
+#include "treeNode.h"
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <string>
+
+// Opt-in recording of dynAlign invocations as Chrome/Perfetto trace events.
+// Every dynAlign call opens a TraceSpan; spans shorter than the threshold are dropped
+// so that only the expensive parts of the recursion end up in the file.
+
+extern std::atomic<bool> traceEventsEnabled;
+
+void startTraceEvents(long long thresholdMicros, size_t maxEvents = 1000000);
+void stopTraceEvents();
+size_t recordedTraceEvents();
+void writeTraceEvents(const std::string &path);
+
+class TraceSpan
+{
+public:
+    TraceSpan(const TreeNode &node, size_t traceLength);
+
+    ~TraceSpan();
+
+    void setMemoHit();
+
+private:
+    bool active;
+    bool memoHit;
+    int nodeId;
+    Operation operation;
+    size_t traceLength;
+    std::chrono::steady_clock::time_point start;
+};
+
+#endif // TRACEEVENTS_H
@@ -0,0 +1,110 @@
+#include "traceView.h"
+#include <algorithm>
+
+namespace
+{
+    constexpr uint64_t fingerprintModulus = (uint64_t(1) << 61) - 1;
+    // fixed, so fingerprints can be compared across processes
+    constexpr uint64_t fingerprintBase = 0x1f3d5b79a2c4e6bULL % fingerprintModulus;
+
+    uint64_t mulMod(uint64_t lhs, uint64_t rhs)
+    {
+        const __uint128_t product = static_cast<__uint128_t>(lhs) * rhs;
+        const uint64_t folded = static_cast<uint64_t>(product & fingerprintModulus) + static_cast<uint64_t>(product >> 61);
+        return folded >= fingerprintModulus ? folded - fingerprintModulus : folded;
+    }
+
+    uint64_t appendEvent(uint64_t hash, int activity)
+    {
+        // + 1 keeps every event nonzero, negative ids (unknown activities) wrap into the upper range
+        const uint64_t value = static_cast<uint64_t>(static_cast<uint32_t>(activity)) + 1;
+        const uint64_t sum = mulMod(hash, fingerprintBase) + value;
+        return sum >= fingerprintModulus ? sum - fingerprintModulus : sum;
+    }
+}
+
+uint64_t fingerprint(std::span<const int> events)
+{
+    uint64_t hash = 0;
+    for (const int activity : events)
+    {
+        hash = appendEvent(hash, activity);
+    }
+    return hash;
+}
+
+TraceView::TraceView(std::span<const int> events, const uint64_t *prefixHashes, const uint64_t *basePowers)
+    : trace(events), prefixHashes(prefixHashes), basePowers(basePowers)
+{
+}
+
+size_t TraceView::size() const
+{
+    return trace.size();
+}
+
+bool TraceView::empty() const
+{
+    return trace.empty();
+}
+
+int TraceView::operator[](size_t index) const
+{
+    return trace[index];
+}
+
+int TraceView::back() const
+{
+    return trace.back();
+}
+
+std::span<const int>::iterator TraceView::begin() const
+{
+    return trace.begin();
+}
+
+std::span<const int>::iterator TraceView::end() const
+{
+    return trace.end();
+}
+
+TraceView TraceView::subspan(size_t offset, size_t count) const
+{
+    // powers go by length, so a subtrace shares them
+    return TraceView(trace.subspan(offset, count), prefixHashes + offset, basePowers);
+}
+
+std::span<const int> TraceView::events() const
+{
+    return trace;
+}
+
+TraceView::operator std::span<const int>() const
+{
+    return trace;
+}
+
+// hash(a..b) = prefix(b) - prefix(a) * base^(b - a)
+uint64_t TraceView::fingerprint() const
+{
+    const uint64_t shifted = mulMod(prefixHashes[0], basePowers[trace.size()]);
+    const uint64_t end = prefixHashes[trace.size()];
+    return end >= shifted ? end - shifted : end + fingerprintModulus - shifted;
+}
+
+HashedTrace::HashedTrace(std::span<const int> events)
+    : events(events), prefixHashes(events.size() + 1), basePowers(events.size() + 1)
+{
+    prefixHashes[0] = 0;
+    basePowers[0] = 1;
+    for (size_t i = 0; i < events.size(); ++i)
+    {
+        prefixHashes[i + 1] = appendEvent(prefixHashes[i], events[i]);
+        basePowers[i + 1] = mulMod(basePowers[i], fingerprintBase);
+    }
+}
+
+TraceView HashedTrace::view() const
+{
+    return TraceView(events, prefixHashes.data(), basePowers.data());
+}
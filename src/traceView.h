@@ -0,0 +1,63 @@
+#ifndef TRACEVIEW_H
+#define TRACEVIEW_H
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+// Content fingerprints of traces. A fingerprint is the polynomial hash of the events modulo 2^61 - 1
+// with a fixed base, so equal traces get equal fingerprints in every thread and every process.
+// Prefix hashes give the fingerprint of any subtrace in O(1). The powers of the base they need are kept
+// next to them, so a view can be used on any thread, not only on the one that hashed the trace.
+
+uint64_t fingerprint(std::span<const int> events);
+
+// A subtrace together with the prefix hashes of the trace it was cut from
+class TraceView
+{
+public:
+    // prefixHashes[i] is the hash of the underlying trace up to events[i], it needs events.size() + 1 entries;
+    // basePowers[i] is the base to the power of i for every i up to events.size()
+    TraceView(std::span<const int> events, const uint64_t *prefixHashes, const uint64_t *basePowers);
+
+    size_t size() const;
+
+    bool empty() const;
+
+    int operator[](size_t index) const;
+
+    int back() const;
+
+    std::span<const int>::iterator begin() const;
+
+    std::span<const int>::iterator end() const;
+
+    TraceView subspan(size_t offset, size_t count) const;
+
+    std::span<const int> events() const;
+
+    operator std::span<const int>() const;
+
+    uint64_t fingerprint() const;
+
+private:
+    std::span<const int> trace;
+    const uint64_t *prefixHashes;
+    const uint64_t *basePowers;
+};
+
+// Prefix hashes of a trace owned by the caller, the trace has to outlive it and its views
+class HashedTrace
+{
+public:
+    explicit HashedTrace(std::span<const int> events);
+
+    TraceView view() const;
+
+private:
+    std::span<const int> events;
+    std::vector<uint64_t> prefixHashes;
+    std::vector<uint64_t> basePowers;
+};
+
+#endif // TRACEVIEW_H
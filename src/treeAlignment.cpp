@@ -1,28 +1,111 @@
+#include "treeAlignment.h"
 #include "treeNode.h"
 #include "utils.h"
 #include "parser.h"
+#include "traceEvents.h"
+#include "perfectFit.h"
+#include "costModel.h"
+#include "memoPolicy.h"
+#include "memoSnapshot.h"
 #include <memory>
 #include <string>
 #include <numeric>
+#include <optional>
 #include <limits>
 #include <stack>
 #include <vector>
 #include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <cstring>
 #include <iostream>
 #include <unordered_map>
+#include <unordered_set>
+#include <stdexcept>
 #include <queue>
 
 using IntVec = std::vector<int>;
 using IntPair = std::pair<int, int>;
 
-std::atomic<bool> stop_flag;
+// deadline of the alignment running on this thread, if any
+thread_local Deadline *activeDeadline = nullptr;
+
+// budget of searches that have to stay exact; large enough that tracking it can never overflow
+constexpr int unbounded = std::numeric_limits<int>::max() / 2;
+
+// lower bounds of the subproblems that ran out of budget in the alignWithin call on this thread, keyed like costTable
+thread_local CostTable *activeBudgetBounds = nullptr;
+
+// weights of the alignment running on this thread with WeightedCost
+thread_local const CostModel *activeCostModel = nullptr;
+
+thread_local MemoStats memoStats;
+
+Deadline::Deadline()
+    : end(), limited(false), timedOut(false), callsUntilCheck(checkInterval), cancelled(false)
+{
+}
+
+Deadline::Deadline(std::chrono::milliseconds timeout)
+    : end(std::chrono::steady_clock::now() + timeout), limited(timeout.count() > 0), timedOut(false), callsUntilCheck(checkInterval), cancelled(false)
+{
+}
+
+void Deadline::cancel()
+{
+    cancelled.store(true, std::memory_order_relaxed);
+}
+
+bool Deadline::expired()
+{
+    if (timedOut)
+    {
+        return true;
+    }
+    if (--callsUntilCheck > 0)
+    {
+        return false;
+    }
+    callsUntilCheck = checkInterval;
+    timedOut = cancelled.load(std::memory_order_relaxed) || (limited && std::chrono::steady_clock::now() >= end);
+    return timedOut;
+}
+
+bool Deadline::hasExpired() const
+{
+    return timedOut;
+}
+
+// lets the operators stop exploring once the deadline hit; what they found so far is still an upper bound
+bool deadlineExpired()
+{
+    return activeDeadline && activeDeadline->hasExpired();
+}
+
+// log moves for every event plus the cheapest run through the model
+template <typename Cost>
+int trivialUpperBound(const std::shared_ptr<TreeNode> &node, const std::span<const int> trace)
+{
+    return Cost::logMoves(trace) + Cost::minModelCost(*node);
+}
+
+// budget of a subproblem that is only worth solving below limit; exact searches stay unbounded so that
+// every subproblem they solve can go to the memo
+int tighten(int budget, int limit)
+{
+    return budget == unbounded ? unbounded : std::min(budget, limit);
+}
 
 // Forward declaration necessary in C++ (unlike Python where functions can be called before definition)
-const int dynAlign(std::shared_ptr<TreeNode> node, const std::span<const int> trace);
+int dynAlign(const std::shared_ptr<TreeNode> &node, TraceView trace);
+
+// Exact cost under the cost model if it is at most budget, otherwise any value above budget
+template <typename Cost>
+int dynAlign(const std::shared_ptr<TreeNode> &node, TraceView trace, int budget);
 
 
 // Helper function to get segments - analogous to get_segments_for_sequence in Python
-const std::vector<IntPair> getSegmentsForSequence(const std::span<const int> trace, std::shared_ptr<TreeNode> node)
+const std::vector<IntPair> getSegmentsForSequence(const TraceView trace, const std::shared_ptr<TreeNode> &node)
 {
     const auto &children = node->getChildren();
     if (children.size() != 2)
@@ -65,11 +148,11 @@ struct PairCost
 
 // Generates outgoing edges for Dijkstra algorithm
 // analogous to Python version
-const std::vector<PairCost> outgoingEdges(const IntPair v, const std::span<const int> trace, std::shared_ptr<TreeNode> node, size_t upperBound)
+const std::vector<PairCost> outgoingEdges(const IntPair v, const TraceView trace, const std::shared_ptr<TreeNode> &node, size_t upperBound)
 {
-    const size_t n = trace.size();
+    const int n = trace.size();
     const auto &children = node->getChildren();
-    const size_t numChildren = children.size();
+    const int numChildren = children.size();
 
     std::vector<PairCost> result;
     if (v.first == numChildren)
@@ -88,7 +171,7 @@ const std::vector<PairCost> outgoingEdges(const IntPair v, const std::span<const
         }
         const auto subTrace = trace.subspan(v.second, k - v.second);
         const int tempCost = dynAlign(children.at(v.first), subTrace);
-        if (tempCost > upperBound)
+        if (static_cast<size_t>(tempCost) > upperBound)
         {
             continue;
         }
@@ -98,10 +181,10 @@ const std::vector<PairCost> outgoingEdges(const IntPair v, const std::span<const
 }
 
 
-std::vector<IntPair> outgoingEdges(const IntPair &vertex, std::shared_ptr<TreeNode> node, std::vector<size_t> &splitPositions)
+std::vector<IntPair> outgoingEdges(const IntPair &vertex, const std::shared_ptr<TreeNode> &node, std::vector<size_t> &splitPositions)
 {
     std::vector<IntPair> result;
-    size_t const numChildren = node->getChildren().size();
+    const int numChildren = node->getChildren().size();
 
     if (vertex.first >= numChildren - 1)
     {
@@ -126,11 +209,11 @@ std::vector<IntPair> outgoingEdges(const IntPair &vertex, std::shared_ptr<TreeNo
 }
 
 // has an upper bound estimation
-const std::vector<PairCost> outgoingEdges(const IntPair v, const std::span<const int> trace, std::shared_ptr<TreeNode> node)
+const std::vector<PairCost> outgoingEdges(const IntPair v, const TraceView trace, const std::shared_ptr<TreeNode> &node)
 {
-    const size_t n = trace.size();
+    const int n = trace.size();
     const auto &children = node->getChildren();
-    const size_t numChildren = children.size();
+    const int numChildren = children.size();
 
     std::vector<PairCost> result;
     if (v.first == numChildren)
@@ -154,8 +237,11 @@ const std::vector<PairCost> outgoingEdges(const IntPair v, const std::span<const
     return result;
 }
 
-// Implements _dyn_align_sequence from Python with C++ idioms
-const int dynAlignSequence(const std::shared_ptr<TreeNode> node, const std::span<const int> trace)
+// Implements _dyn_align_sequence from Python with C++ idioms. If cuts is given, it receives where the part of every
+// child starts followed by where the last one ends; the events after that are log moves.
+template <typename Cost>
+int dynAlignSequence(const std::shared_ptr<TreeNode> &node, const TraceView trace, const int budget,
+                     std::vector<size_t> *cuts = nullptr)
 {
 
     const auto &children = node->getChildren();
@@ -165,19 +251,31 @@ const int dynAlignSequence(const std::shared_ptr<TreeNode> node, const std::span
 
     if (traceLength == 0)
     {
+        if (cuts)
+        {
+            cuts->assign(numChildren + 1, 0);
+        }
         // C++ uses std::accumulate with lambda instead of Python's sum() with list comprehension
-        return std::accumulate(children.begin(), children.end(), 0, [&trace](int sum, const auto &child)
-                               { return sum + dynAlign(child, trace); });
+        return std::accumulate(children.begin(), children.end(), 0, [&trace, budget](int sum, const auto &child)
+                               { return sum + dynAlign<Cost>(child, trace, tighten(budget, budget - sum)); });
     }
 
     if (numChildren == 1)
     {
-        return dynAlign(children[0], trace);
+        if (cuts)
+        {
+            *cuts = {0, trace.size()};
+        }
+        return dynAlign<Cost>(children[0], trace, budget);
     }
 
     size_t pos = 0;
     size_t old_pos = 0;
     bestCost = 0;
+    if (cuts)
+    {
+        cuts->assign(1, 0);
+    }
 
     // Try greedy approach first - attempt to partition trace by activity membership
     if (traceLength > numChildren &&
@@ -191,14 +289,37 @@ const int dynAlignSequence(const std::shared_ptr<TreeNode> node, const std::span
                 pos += 1;
             }
             const auto subTrace = trace.subspan(old_pos, pos - old_pos);
-            bestCost += dynAlign(child, subTrace);
+            bestCost += dynAlign<Cost>(child, subTrace, tighten(budget, budget - bestCost));
             old_pos = pos;
+            if (cuts)
+            {
+                cuts->push_back(pos);
+            }
+        }
+    }
+    else
+    {
+        // every event becomes a log move, so the bound has to pay for skipping all children
+        for (const auto &child : children)
+        {
+            bestCost += dynAlign<Cost>(child, trace.subspan(0, 0), tighten(budget, budget - bestCost));
+        }
+        if (cuts)
+        {
+            cuts->assign(numChildren + 1, 0);
         }
     }
 
     if (pos < trace.size())
     {
-        bestCost += trace.size() - pos;
+        bestCost += Cost::logMoves(trace.subspan(pos, trace.size() - pos));
+    }
+    // anything above the budget is as good as failing, so the greedy bound never has to be beaten by more
+    bestCost = std::min(bestCost, budget + 1);
+    // no split beats a perfect alignment, e.g. when the greedy partition already fits
+    if (bestCost == 0)
+    {
+        return 0;
     }
 
     if (numChildren == 2)
@@ -206,8 +327,13 @@ const int dynAlignSequence(const std::shared_ptr<TreeNode> node, const std::span
         const auto segments = getSegmentsForSequence(trace, node);
         for (const auto &[split, _] : segments)
         {
+            if (deadlineExpired())
+            {
+                break;
+            }
+
             const auto firstPart = trace.subspan(0, split);
-            const auto leftCost = dynAlign(children[0], firstPart);
+            const auto leftCost = dynAlign<Cost>(children[0], firstPart, tighten(budget, bestCost - 1));
 
             if (leftCost >= bestCost)
             {
@@ -215,37 +341,33 @@ const int dynAlignSequence(const std::shared_ptr<TreeNode> node, const std::span
             }
 
             const auto secondPart = trace.subspan(split, traceLength - split);
-            const auto rightCost = dynAlign(children[1], secondPart);
+            const auto rightCost = dynAlign<Cost>(children[1], secondPart, tighten(budget, bestCost - 1 - leftCost));
 
-            // TODO check if 0 and then early exit
+            if (cuts && leftCost + rightCost < bestCost)
+            {
+                *cuts = {0, static_cast<size_t>(split), trace.size()};
+            }
             bestCost = std::min(leftCost + rightCost, bestCost);
+            if (bestCost == 0)
+            {
+                break;
+            }
         }
         return bestCost;
     }
 
-    std::unordered_map<int, size_t> activityToChildIndex;
-    size_t childIndex = 0;
-    for (const auto &child : children)
-    {
-        for (const auto activity : child->getActivities())
-        {
-            activityToChildIndex[activity] = childIndex;
-        }
-        ++childIndex;
-    }
-
     std::vector<size_t> splitPositions = {0};
-    for (size_t i = 1; i < traceLength; i++)
+    for (int i = 1; i < traceLength; i++)
     {
-        if (activityToChildIndex[trace[i]] != activityToChildIndex[trace[i - 1]])
+        if (node->childIndexOf(trace[i]) != node->childIndexOf(trace[i - 1]))
         {
             splitPositions.push_back(i);
         }
     }
     splitPositions.push_back(traceLength);
 
-    std::unordered_map<IntPair, size_t, PairHash> vertexCosts;
-    for (size_t i = 0; i < numChildren - 1; i++)
+    std::unordered_map<IntPair, int, PairHash> vertexCosts;
+    for (int i = 0; i < numChildren - 1; i++)
     {
         for (const auto splitPosition : splitPositions)
         {
@@ -261,6 +383,8 @@ const int dynAlignSequence(const std::shared_ptr<TreeNode> node, const std::span
 
     std::stack<IntPair> stack;
     std::unordered_map<IntPair, IntPair, PairHash> prevVertices;
+    // the predecessor each vertex had when its cost last went down, only kept for cuts
+    std::unordered_map<IntPair, IntPair, PairHash> bestPrevious;
 
     for (const size_t splitPosition : splitPositions)
     {
@@ -269,20 +393,22 @@ const int dynAlignSequence(const std::shared_ptr<TreeNode> node, const std::span
         prevVertices[initialVertex] = startVertex;
     }
 
-    while (!stack.empty())
+    while (bestCost > 0 && !stack.empty() && !deadlineExpired())
     {
         const IntPair currVertex = stack.top();
         stack.pop();
         const IntPair prevVertex = prevVertices[currVertex];
 
+        // a child that cannot undercut the best path found so far is cut off at its budget
+        const int childBudget = tighten(budget, bestCost - 1 - vertexCosts[prevVertex]);
         int tempCost;
         if (prevVertex.first == -1)
         {
-            tempCost = dynAlign(children[currVertex.first], trace.subspan(0, currVertex.second));
+            tempCost = dynAlign<Cost>(children[currVertex.first], trace.subspan(0, currVertex.second), childBudget);
         }
         else
         {
-            tempCost = dynAlign(children[currVertex.first], trace.subspan(prevVertex.second, currVertex.second - prevVertex.second));
+            tempCost = dynAlign<Cost>(children[currVertex.first], trace.subspan(prevVertex.second, currVertex.second - prevVertex.second), childBudget);
         }
 
         const int newCost = tempCost + vertexCosts[prevVertex];
@@ -291,10 +417,19 @@ const int dynAlignSequence(const std::shared_ptr<TreeNode> node, const std::span
             continue;
         }
         vertexCosts[currVertex] = newCost;
+        if (cuts)
+        {
+            bestPrevious[currVertex] = prevVertex;
+        }
 
         if (currVertex == finalVertex)
         {
             bestCost = newCost;
+            // vertex (i, p): child i ends at p
+            for (IntPair vertex = finalVertex; cuts && vertex.first >= 0; vertex = bestPrevious.at(vertex))
+            {
+                (*cuts)[vertex.first + 1] = vertex.second;
+            }
             continue;
         }
 
@@ -309,7 +444,8 @@ const int dynAlignSequence(const std::shared_ptr<TreeNode> node, const std::span
 }
 
 // Equivalent to Python's _dyn_align_shuffle
-const int dynAlignParallel(const std::shared_ptr<TreeNode> node, const std::span<const int> trace)
+template <typename Cost>
+int dynAlignParallel(const std::shared_ptr<TreeNode> &node, const TraceView trace, const int budget)
 {
     // std::cout << "parallel" << std::endl;
 
@@ -319,33 +455,43 @@ const int dynAlignParallel(const std::shared_ptr<TreeNode> node, const std::span
     std::generate(subTraces.begin(), subTraces.end(), []
                   { return IntVec(); });
 
-    // Count unmatched activities and assign activities to child subtraces
-    const int unmatched = std::count_if(trace.begin(), trace.end(), [&](const int &activity)
-                                        {
-            for (size_t i = 0; i < children.size(); i++) {
-                if (children[i]->getActivities().count(activity)) {
-                    subTraces[i].push_back(activity);
-                    return false;
-                }
-            }
-        return true; });
+    // Cost of the unmatched activities and assign activities to child subtraces
+    int unmatched = 0;
+    for (const int activity : trace)
+    {
+        const int child = node->childIndexOf(activity);
+        if (child < 0)
+        {
+            unmatched += Cost::logMove(activity);
+        }
+        else
+        {
+            subTraces[child].push_back(activity);
+        }
+    }
 
-    int cost = 0;
+    int cost = unmatched;
     for (size_t i = 0; i < children.size(); ++i)
     {
-        cost += dynAlign(children[i], std::span<const int>(subTraces[i]));
+        const HashedTrace subTrace(subTraces[i]);
+        cost += dynAlign<Cost>(children[i], subTrace.view(), tighten(budget, budget - cost));
+        if (cost > budget)
+        {
+            return cost;
+        }
     }
 
-    return cost + unmatched;
+    return cost;
 }
 
 // Equivalent to Python's _dyn_align_xor
-const int dynAlignXor(const std::shared_ptr<TreeNode> node, const std::span<const int> trace)
+template <typename Cost>
+int dynAlignXor(const std::shared_ptr<TreeNode> &node, const TraceView trace, const int budget)
 {
-    int minCost = std::numeric_limits<int>::max();
+    int minCost = budget + 1;
     for (const auto &child : node->getChildren())
     {
-        const int cost = dynAlign(child, trace);
+        const int cost = dynAlign<Cost>(child, trace, tighten(budget, minCost - 1));
         if (cost == 0)
         {
             return cost;
@@ -356,8 +502,11 @@ const int dynAlignXor(const std::shared_ptr<TreeNode> node, const std::span<cons
     return minCost;
 }
 
-// for traces of form R(QR)*
-const int dynAlignLoop(const std::shared_ptr<TreeNode> node, const std::span<const int> trace)
+// For traces of form R(QR)*. If cuts is given, it receives where R ends followed by where every QR part of the loop
+// helper ends.
+template <typename Cost>
+int dynAlignLoop(const std::shared_ptr<TreeNode> &node, const TraceView trace, const int budget,
+                 std::vector<size_t> *cuts = nullptr)
 {
     // std::cout << "looop" << std::endl;
     const auto &children = node->getChildren();
@@ -370,10 +519,13 @@ const int dynAlignLoop(const std::shared_ptr<TreeNode> node, const std::span<con
     const size_t n = trace.size();
     if (n == 0)
     {
-        return dynAlign(children[0], trace);
+        if (cuts)
+        {
+            *cuts = {0};
+        }
+        return dynAlign<Cost>(children[0], trace, budget);
     }
-    // TODO upperbound is not used yet
-    int upperBound = std::numeric_limits<int>::max();
+    int upperBound = budget + 1;
 
     const auto &rChildrenActv = children[0]->getActivities();
     const auto firstTraceVal = trace[0];
@@ -381,8 +533,8 @@ const int dynAlignLoop(const std::shared_ptr<TreeNode> node, const std::span<con
 
     if (rChildrenActv.count(firstTraceVal) && rChildrenActv.count(lastTraceVal))
     {
-        std::vector<std::span<const int>> rParts;
-        std::vector<std::span<const int>> qParts;
+        std::vector<TraceView> rParts;
+        std::vector<TraceView> qParts;
 
         size_t i = 0;
         while (i < n && rChildrenActv.count(trace[i]))
@@ -411,17 +563,29 @@ const int dynAlignLoop(const std::shared_ptr<TreeNode> node, const std::span<con
             rParts.push_back(rPart);
         }
 
-        upperBound = 0;
+        int partsCost = 0;
 
         for (size_t i = 0; i < rParts.size(); i++)
         {
-            upperBound += dynAlign(children[0], rParts[i]);
+            partsCost += dynAlign<Cost>(children[0], rParts[i], tighten(budget, budget - partsCost));
         }
 
         for (size_t i = 0; i < qParts.size(); i++)
         {
-            upperBound += dynAlign(children[1], qParts[i]);
+            partsCost += dynAlign<Cost>(children[1], qParts[i], tighten(budget, budget - partsCost));
         }
+        if (cuts && partsCost < upperBound)
+        {
+            // every Q part with the R part after it is one part of the helper
+            cuts->clear();
+            size_t end = 0;
+            for (size_t i = 0; i < rParts.size(); i++)
+            {
+                end += (i > 0 ? qParts[i - 1].size() : 0) + rParts[i].size();
+                cuts->push_back(end);
+            }
+        }
+        upperBound = std::min(upperBound, partsCost);
     }
 
     if (upperBound == 0)
@@ -431,48 +595,21 @@ const int dynAlignLoop(const std::shared_ptr<TreeNode> node, const std::span<con
 
     // QR bits are aligned by introducing a temporary sequence node
     // and using alignSequence
-    const int tempNodeId = node->getId() * -1;
-    std::shared_ptr<TreeNode> tempNode;
-
-    auto it = tempNodeMap.find(tempNodeId);
-    if (it != tempNodeMap.end())
-    {
-        tempNode = it->second;
-    }
-    else
+    std::shared_ptr<TreeNode> tempNode = node->getLoopHelper();
+    if (!tempNode)
     {
-        std::cerr << "Didn't find tempnode for node with id: " << std::to_string(static_cast<int>(node->getId())) << std::endl;
-        tempNode = std::make_shared<TreeNode>(SEQUENCE, tempNodeId);
-        tempNodeMap[tempNodeId] = tempNode;
-        std::unordered_set<int> allActivities;
-        allActivities.reserve(children[0]->getActivities().size() + children[1]->getActivities().size());
-
-        std::set_union(
-            children[0]->getActivities().begin(), children[0]->getActivities().end(),
-            children[1]->getActivities().begin(), children[1]->getActivities().end(),
-            std::inserter(allActivities, allActivities.begin()));
-
-        tempNode->setActivities(allActivities);
+        // trees built without the parser have no helper, a local one aligns the same under the same memo id
+        tempNode = createLoopHelper(node);
     }
-    std::shared_ptr<TreeNode> tempNode = std::make_shared<TreeNode>(SEQUENCE);
-    std::unordered_set<int> allActivities;
-    allActivities.reserve(children[0]->getActivities().size() + children[1]->getActivities().size());
-
-    std::set_union(
-        children[0]->getActivities().begin(), children[0]->getActivities().end(),
-        children[1]->getActivities().begin(), children[1]->getActivities().end(),
-        std::inserter(allActivities, allActivities.begin()));
-
-    tempNode->setActivities(allActivities);
-    tempNode->addChild(children[1]);
-    tempNode->addChild(children[0]);
     std::unordered_map<IntPair, int, PairHash>
         qrCosts;
+    // where the part ending at a position started when its cost last went down, -1 for R alone; only kept for cuts
+    std::vector<int> bestStart(cuts ? n + 1 : 0, -1);
 
     std::stack<IntPair> stack;
-    for (size_t i = 0; i <= n; i++)
+    for (size_t i = 0; i <= n && !deadlineExpired(); i++)
     {
-        const int rCost = dynAlign(children[0], trace.subspan(0, i));
+        const int rCost = dynAlign<Cost>(children[0], trace.subspan(0, i), tighten(budget, upperBound - 1));
 
         stack.push(IntPair(i, i));
         bool firstStackElement = true;
@@ -510,9 +647,10 @@ const int dynAlignLoop(const std::shared_ptr<TreeNode> node, const std::span<con
             else
             {
                 // Calculate alignment cost for this segment
-                edgesCost = prevEdgesCost + dynAlign(
+                edgesCost = prevEdgesCost + dynAlign<Cost>(
                                                 tempNode,
-                                                trace.subspan(edge.first, edge.second - edge.first));
+                                                trace.subspan(edge.first, edge.second - edge.first),
+                                                tighten(budget, upperBound - 1 - prevEdgesCost));
             }
 
             if (edgesCost >= upperBound)
@@ -527,10 +665,26 @@ const int dynAlignLoop(const std::shared_ptr<TreeNode> node, const std::span<con
             }
 
             qrCosts[totalEdge] = edgesCost;
+            if (cuts)
+            {
+                bestStart[edge.second] = edge.second == edge.first ? -1 : edge.first;
+            }
 
-            if (totalEdge.second == n)
+            if (static_cast<size_t>(totalEdge.second) == n)
             {
                 upperBound = edgesCost;
+                if (cuts)
+                {
+                    cuts->clear();
+                    for (int end = static_cast<int>(n); end >= 0; end = bestStart[end])
+                    {
+                        cuts->insert(cuts->begin(), static_cast<size_t>(end));
+                        if (bestStart[end] < 0)
+                        {
+                            break;
+                        }
+                    }
+                }
             }
             else
             {
@@ -548,101 +702,2146 @@ const int dynAlignLoop(const std::shared_ptr<TreeNode> node, const std::span<con
 
 // Activity node alignment - equivalent to _dyn_align_leaf in Python
 // C++ needs to explicitly check if element exists in vector using std::find
-const int dynAlignActivity(const std::shared_ptr<TreeNode> node, const std::span<const int> trace)
+template <typename Cost>
+int dynAlignActivity(const std::shared_ptr<TreeNode> &node, const std::span<const int> trace)
 {
     // std::cout << "activity" << std::endl;
 
-    const int activity = node->getId();
+    const int activity = node->getActivity();
 
     if (std::find(trace.begin(), trace.end(), activity) == trace.end())
     {
-        return trace.size() + 1;
+        return Cost::logMoves(trace) + Cost::modelMove(activity);
     }
     else
     {
-        return trace.size() - 1;
+        return Cost::logMoves(trace) - Cost::logMove(activity);
     }
 }
 
-const int dynAlignSilentActivity(const std::shared_ptr<TreeNode> node, const std::span<const int> trace)
+template <typename Cost>
+int dynAlignSilentActivity(const std::shared_ptr<TreeNode> &, const std::span<const int> trace)
+{
+    return Cost::logMoves(trace);
+}
+
+// Closed-form costs of the shapes in NodeShape. Events outside the alphabet of the node are log moves,
+// so the kernels work on the unprojected trace and need neither recursion nor the memo.
+template <NodeShape shape>
+int alignShape(const TreeNode &node, std::span<const int> trace);
+
+template <>
+int alignShape<NodeShape::LEAF>(const TreeNode &node, std::span<const int> trace)
+{
+    const int n = trace.size();
+    return std::find(trace.begin(), trace.end(), node.getActivity()) == trace.end() ? n + 1 : n - 1;
+}
+
+template <>
+int alignShape<NodeShape::SILENT_LEAF>(const TreeNode &, std::span<const int> trace)
 {
     return trace.size();
 }
 
-const int dynAlign(const std::shared_ptr<TreeNode> node, std::span<const int> trace)
+// one leaf matches a single event, a tau matches nothing and skipping everything costs a model move
+template <>
+int alignShape<NodeShape::LEAF_CHOICE>(const TreeNode &node, std::span<const int> trace)
 {
-    if (stop_flag.load())
+    const int n = trace.size();
+    const auto &activities = node.getActivities();
+    if (std::any_of(trace.begin(), trace.end(), [&activities](const int activity)
+                    { return activities.count(activity) != 0; }))
     {
-        return -1;
+        return n - 1;
     }
+    return node.getMinModelCost() == 0 ? n : n + 1;
+}
 
-    const int nodeId = node->getId();
+// every leaf sees exactly the events with its activity: one match if it occurs, a model move otherwise
+template <>
+int alignShape<NodeShape::LEAF_PARALLEL>(const TreeNode &node, std::span<const int> trace)
+{
+    const auto &activities = node.getActivities();
+    const int leaves = activities.size();
+    int matched = 0;
+    if (leaves > 64)
+    {
+        std::unordered_set<int> present;
+        for (const int activity : trace)
+        {
+            if (activities.count(activity) != 0)
+            {
+                present.insert(activity);
+            }
+        }
+        matched = present.size();
+    }
+    else
+    {
+        // parallels are narrow, a linear scan over the matched leaves beats hashing
+        int present[64];
+        for (const int activity : trace)
+        {
+            if (activities.count(activity) != 0 && std::find(present, present + matched, activity) == present + matched)
+            {
+                present[matched++] = activity;
+            }
+        }
+    }
+    return static_cast<int>(trace.size()) + leaves - 2 * matched;
+}
 
-    auto [mapIt, wasInserted] = costTable.try_emplace(nodeId);
-    auto &innerMap = mapIt->second;
+// The cost of a chain of distinct leaves is |trace| + |chain| - 2 * LCS(trace, chain). The LCS is computed
+// bit-parallel (Hyyrö): bit i of v is cleared once chain[0..i] gained a match, and every event updates v with
+// one addition, so a chain of up to 64 leaves costs a few word operations per event.
+template <>
+int alignShape<NodeShape::LEAF_SEQUENCE>(const TreeNode &node, std::span<const int> trace)
+{
+    const int n = trace.size();
+    const int chainLength = node.getChildren().size();
+    int lcs;
 
-    const auto it = innerMap.find(trace);
-    if (it != innerMap.end())
+    if (chainLength <= 64)
     {
-        return it->second;
+        const uint64_t mask = chainLength == 64 ? ~uint64_t(0) : (uint64_t(1) << chainLength) - 1;
+        uint64_t v = mask;
+        for (const int activity : trace)
+        {
+            const int position = node.childIndexOf(activity);
+            if (position < 0)
+            {
+                continue;
+            }
+            const uint64_t u = v & (uint64_t(1) << position);
+            v = ((v + u) | (v - u)) & mask;
+        }
+        lcs = chainLength - std::popcount(v);
     }
-
-    size_t aliens = 0;
-    auto &activities = node->getActivities();
-    std::vector<int> prunedTrace;
-    for (const auto x : trace)
+    else
     {
-        if (activities.count(x) == 0)
+        // the match mask of a leaf has a single bit, so the addition only starts at its word and carries upwards
+        const int words = (chainLength + 63) / 64;
+        std::vector<uint64_t> v(words, ~uint64_t(0));
+        if (chainLength % 64 != 0)
         {
-            for (const int val : trace)
+            v.back() = (uint64_t(1) << (chainLength % 64)) - 1;
+        }
+        for (const int activity : trace)
+        {
+            const int position = node.childIndexOf(activity);
+            if (position < 0)
             {
-                if (activities.count(val) != 0)
-                {
-                    prunedTrace.push_back(val);
-                }
-                else
-                {
-                    aliens++;
-                }
+                continue;
             }
-            trace = std::span(prunedTrace);
-            break;
+            const int word = position / 64;
+            const uint64_t u = v[word] & (uint64_t(1) << (position % 64));
+            if (u == 0)
+            {
+                continue;
+            }
+            const uint64_t sum = v[word] + u;
+            uint64_t carry = sum < v[word];
+            v[word] = sum | (v[word] - u);
+            for (int next = word + 1; carry != 0 && next < words; ++next)
+            {
+                const uint64_t nextSum = v[next] + carry;
+                carry = nextSum < v[next];
+                v[next] |= nextSum;
+            }
+        }
+        if (chainLength % 64 != 0)
+        {
+            v.back() &= (uint64_t(1) << (chainLength % 64)) - 1;
+        }
+        lcs = chainLength;
+        for (const uint64_t word : v)
+        {
+            lcs -= std::popcount(word);
         }
     }
+    return n + chainLength - 2 * lcs;
+}
 
-    int costs;
-    switch (node->getOperation())
+// a+ matches every occurrence of a, but needs at least one
+template <>
+int alignShape<NodeShape::LEAF_LOOP>(const TreeNode &node, std::span<const int> trace)
+{
+    const int n = trace.size();
+    const int occurrences = std::count(trace.begin(), trace.end(), node.getChildren()[0]->getActivity());
+    return occurrences == 0 ? n + 1 : n - occurrences;
+}
+
+template <>
+int alignShape<NodeShape::SKIPPABLE_LEAF_LOOP>(const TreeNode &node, std::span<const int> trace)
+{
+    const int n = trace.size();
+    return n - static_cast<int>(std::count(trace.begin(), trace.end(), node.getChildren()[1]->getActivity()));
+}
+
+// The shapes under per-activity costs. Log moves of events outside the alphabet are summed up like the unmatched
+// events of the unit kernels, matching an event saves its log move and, where the run has to execute the leaf, its
+// model move.
+template <NodeShape shape>
+int alignWeightedShape(const TreeNode &node, std::span<const int> trace);
+
+int weightedLogMoves(std::span<const int> trace)
+{
+    int cost = 0;
+    for (const int activity : trace)
     {
-    case SEQUENCE:
-        costs = dynAlignSequence(node, trace);
-        break;
-    case PARALLEL:
-        costs = dynAlignParallel(node, trace);
-        break;
-    case XOR:
-        costs = dynAlignXor(node, trace);
-        break;
-    case REDO_LOOP:
-        costs = dynAlignLoop(node, trace);
-        break;
-    case ACTIVITY:
-        costs = dynAlignActivity(node, trace);
-        break;
-    case SILENT_ACTIVITY:
-        costs = dynAlignSilentActivity(node, trace);
-        break;
-    default:
-        throw std::runtime_error("Unknown node operation: " + std::to_string(node->getOperation()));
+        cost += activeCostModel->logMove(activity);
+    }
+    return cost;
+}
+
+template <>
+int alignWeightedShape<NodeShape::LEAF>(const TreeNode &node, std::span<const int> trace)
+{
+    const int activity = node.getActivity();
+    const int logMoves = weightedLogMoves(trace);
+    return std::find(trace.begin(), trace.end(), activity) == trace.end() ? logMoves + activeCostModel->modelMove(activity)
+                                                                          : logMoves - activeCostModel->logMove(activity);
+}
+
+template <>
+int alignWeightedShape<NodeShape::SILENT_LEAF>(const TreeNode &, std::span<const int> trace)
+{
+    return weightedLogMoves(trace);
+}
+
+// the cheapest option is skipping through the cheapest child or matching the event with the most expensive log move
+template <>
+int alignWeightedShape<NodeShape::LEAF_CHOICE>(const TreeNode &node, std::span<const int> trace)
+{
+    const auto &activities = node.getActivities();
+    int best = activeCostModel->minModelCost(node);
+    for (const int activity : trace)
+    {
+        if (activities.count(activity) != 0)
+        {
+            best = std::min(best, -activeCostModel->logMove(activity));
+        }
     }
+    return weightedLogMoves(trace) + best;
+}
 
-    if (!prunedTrace.empty())
+template <>
+int alignWeightedShape<NodeShape::LEAF_PARALLEL>(const TreeNode &node, std::span<const int> trace)
+{
+    const auto &activities = node.getActivities();
+    std::unordered_set<int> present;
+    for (const int activity : trace)
     {
-        costTable[nodeId][std::move(prunedTrace)] = costs;
+        if (activities.count(activity) != 0)
+        {
+            present.insert(activity);
+        }
     }
-    else
+    int cost = weightedLogMoves(trace) + activeCostModel->minModelCost(node);
+    for (const int activity : present)
     {
-        const std::vector<int> traceVector(trace.begin(), trace.end());
-        costTable[nodeId][std::move(traceVector)] = costs;
+        cost -= activeCostModel->logMove(activity) + activeCostModel->modelMove(activity);
     }
-    return costs + aliens;
+    return cost;
+}
+
+// weights break the bit-parallel LCS, so this is the weighted LCS as a heaviest increasing subsequence of chain
+// positions: gain[p] is the largest saving of a common subsequence whose last match is chain[p]
+template <>
+int alignWeightedShape<NodeShape::LEAF_SEQUENCE>(const TreeNode &node, std::span<const int> trace)
+{
+    const auto &children = node.getChildren();
+    std::vector<int> gain(children.size(), 0);
+    for (const int activity : trace)
+    {
+        const int position = node.childIndexOf(activity);
+        if (position < 0)
+        {
+            continue;
+        }
+        int before = 0;
+        for (int p = 0; p < position; ++p)
+        {
+            before = std::max(before, gain[p]);
+        }
+        gain[position] = std::max(gain[position], before + activeCostModel->logMove(activity) + activeCostModel->modelMove(activity));
+    }
+    const int saving = gain.empty() ? 0 : *std::max_element(gain.begin(), gain.end());
+    return weightedLogMoves(trace) + activeCostModel->minModelCost(node) - saving;
+}
+
+template <>
+int alignWeightedShape<NodeShape::LEAF_LOOP>(const TreeNode &node, std::span<const int> trace)
+{
+    const int activity = node.getChildren()[0]->getActivity();
+    const int occurrences = std::count(trace.begin(), trace.end(), activity);
+    const int logMoves = weightedLogMoves(trace);
+    return occurrences == 0 ? logMoves + activeCostModel->modelMove(activity) : logMoves - occurrences * activeCostModel->logMove(activity);
+}
+
+template <>
+int alignWeightedShape<NodeShape::SKIPPABLE_LEAF_LOOP>(const TreeNode &node, std::span<const int> trace)
+{
+    const int activity = node.getChildren()[1]->getActivity();
+    const int occurrences = std::count(trace.begin(), trace.end(), activity);
+    return weightedLogMoves(trace) - occurrences * activeCostModel->logMove(activity);
+}
+
+// Cost model policies the kernels are instantiated with. UnitCost is the classic cost function in which every
+// log and model move costs 1; its members fold to the plain counting of the kernels before they were templated.
+struct UnitCost
+{
+    static constexpr int logMove(int)
+    {
+        return 1;
+    }
+
+    static constexpr int modelMove(int)
+    {
+        return 1;
+    }
+
+    static int logMoves(std::span<const int> trace)
+    {
+        return static_cast<int>(trace.size());
+    }
+
+    static int modelMoves(std::span<const int> trace)
+    {
+        return static_cast<int>(trace.size());
+    }
+
+    static int minModelCost(const TreeNode &node)
+    {
+        return node.getMinModelCost();
+    }
+
+    static int memoKey(const TreeNode &node)
+    {
+        return node.getMemoKey();
+    }
+
+    template <NodeShape shape>
+    static int alignShape(const TreeNode &node, std::span<const int> trace)
+    {
+        return ::alignShape<shape>(node, trace);
+    }
+};
+
+// per-activity costs of activeCostModel
+struct WeightedCost
+{
+    static int logMove(int activity)
+    {
+        return activeCostModel->logMove(activity);
+    }
+
+    static int modelMove(int activity)
+    {
+        return activeCostModel->modelMove(activity);
+    }
+
+    static int logMoves(std::span<const int> trace)
+    {
+        return weightedLogMoves(trace);
+    }
+
+    static int modelMoves(std::span<const int> trace)
+    {
+        int cost = 0;
+        for (const int activity : trace)
+        {
+            cost += activeCostModel->modelMove(activity);
+        }
+        return cost;
+    }
+
+    static int minModelCost(const TreeNode &node)
+    {
+        return activeCostModel->minModelCost(node);
+    }
+
+    static int memoKey(const TreeNode &node)
+    {
+        return activeCostModel->memoKey(node);
+    }
+
+    template <NodeShape shape>
+    static int alignShape(const TreeNode &node, std::span<const int> trace)
+    {
+        return alignWeightedShape<shape>(node, trace);
+    }
+};
+
+template <typename Cost>
+int dynAlign(const std::shared_ptr<TreeNode> &node, TraceView trace, int budget)
+{
+    switch (node->getShape())
+    {
+    case NodeShape::GENERIC:
+        break;
+    case NodeShape::LEAF:
+        return Cost::template alignShape<NodeShape::LEAF>(*node, trace.events());
+    case NodeShape::SILENT_LEAF:
+        return Cost::template alignShape<NodeShape::SILENT_LEAF>(*node, trace.events());
+    case NodeShape::LEAF_CHOICE:
+        return Cost::template alignShape<NodeShape::LEAF_CHOICE>(*node, trace.events());
+    case NodeShape::LEAF_PARALLEL:
+        return Cost::template alignShape<NodeShape::LEAF_PARALLEL>(*node, trace.events());
+    case NodeShape::LEAF_SEQUENCE:
+        return Cost::template alignShape<NodeShape::LEAF_SEQUENCE>(*node, trace.events());
+    case NodeShape::LEAF_LOOP:
+        return Cost::template alignShape<NodeShape::LEAF_LOOP>(*node, trace.events());
+    case NodeShape::SKIPPABLE_LEAF_LOOP:
+        return Cost::template alignShape<NodeShape::SKIPPABLE_LEAF_LOOP>(*node, trace.events());
+    }
+
+    const int memoKey = Cost::memoKey(*node);
+    TraceSpan span(*node, trace.size());
+
+    const MemoPolicy policy = activeMemoPolicy;
+    if (policy != MemoPolicy::ALWAYS)
+    {
+        // an empty trace is the cheapest run of the node as model moves
+        if (trace.size() == 0)
+        {
+            memoPolicyStats.staticSkips++;
+            return Cost::minModelCost(*node);
+        }
+        // the children scan the unprojected trace in closed form
+        if (cheapChoice(*node))
+        {
+            memoPolicyStats.staticSkips++;
+            return dynAlignXor<Cost>(node, trace, budget);
+        }
+    }
+    // the adaptive policy still projects the trace and solves it, it only leaves the memo alone
+    // valid until the children run, they may grow the counters
+    AdaptiveMemoNode *measured = policy == MemoPolicy::ADAPTIVE ? &adaptiveMemoNode(memoKey) : nullptr;
+    const bool memoize = !measured || !skipMemo(*measured);
+    if (!memoize)
+    {
+        measured = nullptr;
+    }
+
+    auto [mapIt, wasInserted] = costTable.try_emplace(memoKey);
+    auto &innerMap = mapIt->second;
+
+    int cachedCost = memoize ? innerMap.find(trace) : -1;
+    // what an earlier run solved stays in the snapshot, so the memo only collects the entries that are new to it
+    if (cachedCost < 0 && memoize && activeMemoSnapshot)
+    {
+        cachedCost = activeMemoSnapshot->find(memoKey, trace);
+    }
+    if (cachedCost >= 0)
+    {
+        if (measured)
+        {
+            recordMemoLookup(*measured, true);
+        }
+        span.setMemoHit();
+        memoStats.hits++;
+        return cachedCost;
+    }
+
+    if (activeDeadline && activeDeadline->expired())
+    {
+        return trivialUpperBound<Cost>(node, trace);
+    }
+
+    int aliens = 0;
+    auto &activities = node->getActivities();
+    std::vector<int> prunedTrace;
+    std::optional<HashedTrace> prunedHashes;
+    for (const auto x : trace)
+    {
+        if (activities.count(x) == 0)
+        {
+            for (const int val : trace)
+            {
+                if (activities.count(val) != 0)
+                {
+                    prunedTrace.push_back(val);
+                }
+                else
+                {
+                    aliens += Cost::logMove(val);
+                }
+            }
+            trace = prunedHashes.emplace(prunedTrace).view();
+            if (policy != MemoPolicy::ALWAYS && trace.size() == 0)
+            {
+                memoPolicyStats.staticSkips++;
+                return Cost::minModelCost(*node) + aliens;
+            }
+
+            // the memo is keyed by projected traces, so other traces with the same projection hit here
+            const int prunedCost = memoize ? innerMap.find(trace) : -1;
+            if (prunedCost >= 0)
+            {
+                if (measured)
+                {
+                    recordMemoLookup(*measured, true);
+                }
+                span.setMemoHit();
+                memoStats.hits++;
+                return prunedCost + aliens;
+            }
+            break;
+        }
+    }
+    // a sample of the misses is timed, the clock costs about as much as a lookup
+    bool timed = false;
+    if (measured)
+    {
+        recordMemoLookup(*measured, false);
+        timed = measured->lookups % timedMissInterval == 0;
+    }
+
+    if (budget != unbounded)
+    {
+        // aliens are log moves whatever the subtree does, and so is every visible activity the cheapest run cannot match
+        budget -= aliens;
+        if (Cost::minModelCost(*node) - Cost::modelMoves(trace) > budget)
+        {
+            return budget + 1 + aliens;
+        }
+        if (activeBudgetBounds)
+        {
+            const auto boundsIt = activeBudgetBounds->find(memoKey);
+            const int lowerBound = boundsIt == activeBudgetBounds->end() ? -1 : boundsIt->second.find(trace);
+            if (lowerBound > budget)
+            {
+                return lowerBound + aliens;
+            }
+        }
+    }
+
+    if (memoize)
+    {
+        memoStats.misses++;
+    }
+    const auto computeStart = timed ? std::chrono::steady_clock::now() : std::chrono::steady_clock::time_point();
+    int costs;
+    switch (node->getOperation())
+    {
+    case SEQUENCE:
+        costs = dynAlignSequence<Cost>(node, trace, budget);
+        break;
+    case PARALLEL:
+        costs = dynAlignParallel<Cost>(node, trace, budget);
+        break;
+    case XOR:
+        costs = dynAlignXor<Cost>(node, trace, budget);
+        break;
+    case REDO_LOOP:
+        costs = dynAlignLoop<Cost>(node, trace, budget);
+        break;
+    case ACTIVITY:
+        costs = dynAlignActivity<Cost>(node, trace);
+        break;
+    case SILENT_ACTIVITY:
+        costs = dynAlignSilentActivity<Cost>(node, trace);
+        break;
+    default:
+        throw std::runtime_error("Unknown node operation: " + std::to_string(node->getOperation()));
+    }
+
+    // results computed after the deadline hit are only upper bounds and must not reach the memo
+    if (deadlineExpired())
+    {
+        return std::min(costs, trivialUpperBound<Cost>(node, trace)) + aliens;
+    }
+    if (timed)
+    {
+        // the children may have grown the adaptive counters, so the key is looked up again
+        recordMemoCompute(adaptiveMemoNode(memoKey), std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                                         std::chrono::steady_clock::now() - computeStart)
+                                                         .count());
+    }
+
+    // the search was cut off, which only proves a lower bound; a larger budget has to search again
+    if (costs > budget)
+    {
+        if (activeBudgetBounds)
+        {
+            auto &bounds = (*activeBudgetBounds)[memoKey];
+            if (bounds.find(trace) <= budget)
+            {
+                bounds.insert(trace, budget + 1);
+            }
+        }
+        return budget + 1 + aliens;
+    }
+
+    if (memoize)
+    {
+        innerMap.insert(trace, costs);
+    }
+    return costs + aliens;
+}
+
+int dynAlign(const std::shared_ptr<TreeNode> &node, TraceView trace)
+{
+    return dynAlign<UnitCost>(node, trace, unbounded);
+}
+
+// hashes the trace once, every subtrace the recursion looks at is then fingerprinted in O(1)
+template <typename Cost>
+int alignTrace(const std::shared_ptr<TreeNode> &node, const std::span<const int> trace)
+{
+    // most traces of real logs fit, which a linear walk over the tree proves without any search;
+    // costs are positive, so a fitting trace costs 0 under every cost model
+    if (fitsPerfectly(*node, trace))
+    {
+        return 0;
+    }
+    const HashedTrace hashedTrace(trace);
+    return dynAlign<Cost>(node, hashedTrace.view(), unbounded);
+}
+
+int dynAlign(const std::shared_ptr<TreeNode> &node, const std::span<const int> trace)
+{
+    return alignTrace<UnitCost>(node, trace);
+}
+
+// installs a deadline for the current thread and restores the previous one on exit
+struct DeadlineScope
+{
+    Deadline *previousDeadline;
+
+    explicit DeadlineScope(Deadline &deadline) : previousDeadline(activeDeadline)
+    {
+        activeDeadline = &deadline;
+    }
+
+    ~DeadlineScope()
+    {
+        activeDeadline = previousDeadline;
+    }
+};
+
+// events outside the model alphabet are log moves in every alignment, and every
+// visible activity of the cheapest run that is not matched is a model move
+template <typename Cost>
+int trivialLowerBound(const std::shared_ptr<TreeNode> &root, std::span<const int> trace)
+{
+    const auto &activities = root->getActivities();
+    int aliens = 0;
+    int matchable = 0;
+    for (const int activity : trace)
+    {
+        if (activities.count(activity) == 0)
+        {
+            aliens += Cost::logMove(activity);
+        }
+        else
+        {
+            matchable += Cost::modelMove(activity);
+        }
+    }
+    return aliens + std::max(0, Cost::minModelCost(*root) - matchable);
+}
+
+// installs a cost model for the current thread and restores the previous one on exit
+struct CostModelScope
+{
+    const CostModel *previousCostModel;
+
+    explicit CostModelScope(const CostModel &costs) : previousCostModel(activeCostModel)
+    {
+        activeCostModel = &costs;
+    }
+
+    ~CostModelScope()
+    {
+        activeCostModel = previousCostModel;
+    }
+};
+
+template <typename Cost>
+AlignmentResult alignAnytime(const std::shared_ptr<TreeNode> &root, std::span<const int> trace, Deadline &deadline)
+{
+    DeadlineScope scope(deadline);
+    const int cost = alignTrace<Cost>(root, trace);
+
+    if (!deadline.hasExpired())
+    {
+        return {cost, cost, true};
+    }
+    return {cost, trivialLowerBound<Cost>(root, trace), false};
+}
+
+AlignmentResult alignAnytime(const std::shared_ptr<TreeNode> &root, std::span<const int> trace, Deadline &deadline, const CostModel *costs)
+{
+    if (!costs)
+    {
+        return alignAnytime<UnitCost>(root, trace, deadline);
+    }
+    CostModelScope scope(*costs);
+    return alignAnytime<WeightedCost>(root, trace, deadline);
+}
+
+// installs a fresh table of budget lower bounds for the current thread and restores the previous one on exit
+struct BudgetScope
+{
+    CostTable bounds;
+    CostTable *previousBounds;
+
+    BudgetScope() : previousBounds(activeBudgetBounds)
+    {
+        activeBudgetBounds = &bounds;
+    }
+
+    ~BudgetScope()
+    {
+        activeBudgetBounds = previousBounds;
+    }
+};
+
+/**
+ * Decides whether a trace can be aligned with at most budget moves. The operators hand every child the part of the
+ * budget that is left once the rest of their candidate alignment is paid for, and a subproblem whose lower bound
+ * exceeds its budget is abandoned without being searched, so small budgets are much cheaper than exact alignment.
+ * Costs at most budget are exact and shared with the memo of the thread.
+ *
+ * @param root Root of the process tree
+ * @param trace Encoded trace
+ * @param budget Largest cost of interest
+ * @param deadline Cancels the search early, the bounds are those of alignAnytime then
+ * @return The exact cost if it is at most budget, otherwise a result with exact unset and lowerBound above budget
+ */
+template <typename Cost>
+AlignmentResult alignWithin(const std::shared_ptr<TreeNode> &root, std::span<const int> trace, int budget, Deadline &deadline)
+{
+    // every alignment costs less than this, so a larger budget is a plain exact alignment
+    budget = std::min(budget, trivialUpperBound<Cost>(root, trace));
+
+    if (fitsPerfectly(*root, trace))
+    {
+        return {0, 0, true};
+    }
+
+    DeadlineScope scope(deadline);
+    BudgetScope budgetScope;
+    const HashedTrace hashedTrace(trace);
+    const int cost = dynAlign<Cost>(root, hashedTrace.view(), budget);
+
+    const int lowerBound = trivialLowerBound<Cost>(root, trace);
+    if (deadline.hasExpired())
+    {
+        return {trivialUpperBound<Cost>(root, trace), lowerBound, false};
+    }
+    if (cost <= budget)
+    {
+        return {cost, cost, true};
+    }
+    return {trivialUpperBound<Cost>(root, trace), std::max(lowerBound, budget + 1), false};
+}
+
+// @throws std::invalid_argument if budget is negative
+AlignmentResult alignWithin(const std::shared_ptr<TreeNode> &root, std::span<const int> trace, int budget, Deadline &deadline,
+                            const CostModel *costs)
+{
+    if (budget < 0)
+    {
+        throw std::invalid_argument("Alignment budget must not be negative.");
+    }
+    if (!costs)
+    {
+        return alignWithin<UnitCost>(root, trace, budget, deadline);
+    }
+    CostModelScope scope(*costs);
+    return alignWithin<WeightedCost>(root, trace, budget, deadline);
+}
+
+int alignWithin(const std::shared_ptr<TreeNode> &root, std::span<const int> trace, int budget)
+{
+    Deadline deadline;
+    const AlignmentResult result = alignWithin(root, trace, budget, deadline);
+    return result.exact ? result.cost : -1;
+}
+
+int alignWithDeadline(const std::shared_ptr<TreeNode> &root, std::span<const int> trace, Deadline &deadline, const CostModel *costs)
+{
+    const AlignmentResult result = alignAnytime(root, trace, deadline, costs);
+    return result.exact ? result.cost : -1;
+}
+
+// Steps of the frames of SuspendableAlignment. A step that needs a child either finds its cost right away or pushes
+// a frame for it and runs again, unchanged, once the child delivered its cost.
+enum class FramePhase : uint8_t
+{
+    START,
+    // sequence
+    EMPTY_CHILDREN,
+    SINGLE_CHILD,
+    GREEDY_PARTS,
+    SKIPPED_CHILDREN,
+    SEGMENT_LEFT,
+    SEGMENT_RIGHT,
+    SPLIT_PATHS,
+    // parallel and xor
+    CHILDREN,
+    // loop
+    EMPTY_LOOP,
+    R_PARTS,
+    Q_PARTS,
+    LOOP_STARTS,
+    LOOP_EDGES
+};
+
+// A subproblem that missed the memo, with the locals of dynAlign and of the kernel of its operator
+struct AlignmentFrame
+{
+    std::shared_ptr<TreeNode> node;
+    FramePhase phase = FramePhase::START;
+    int memoKey = 0;
+    // cheap choices are solved on the unprojected trace and stay out of the memo
+    bool memoize = true;
+    // log moves of the events the projection dropped, added to the cost the caller gets
+    int aliens = 0;
+    // a view into the caller, or owned if the trace was projected, is the root trace or was loaded
+    std::vector<int> events;
+    std::optional<HashedTrace> hashes;
+    TraceView trace{{}, nullptr, nullptr};
+    // cost of the child the current step waits for
+    bool hasResult = false;
+    int result = 0;
+    // cheapest alignment found so far; unbounded + 1 before the first, or for parallel nodes
+    int bestCost = unbounded + 1;
+    // child or part, trace position and the cost of the parts done
+    size_t index = 0;
+    size_t position = 0;
+    int partial = 0;
+    // sequence of two children: the splits to try
+    std::vector<IntPair> segments;
+    // sequence split DP
+    std::vector<size_t> splitPositions;
+    std::unordered_map<IntPair, int, PairHash> vertexCosts;
+    std::unordered_map<IntPair, IntPair, PairHash> prevVertices;
+    // pending vertices of the split DP or QR edges of the loop DP, the top is the back
+    std::vector<IntPair> stack;
+    // parallel: the events of every child
+    std::vector<IntVec> parts;
+    std::vector<HashedTrace> partHashes;
+    // loop: greedy R and Q parts as (offset, length), and the QR edge DP
+    std::vector<IntPair> rParts;
+    std::vector<IntPair> qParts;
+    std::unordered_map<IntPair, int, PairHash> qrCosts;
+    std::shared_ptr<TreeNode> helper;
+    int rCost = 0;
+    bool firstEdge = false;
+
+    void ownTrace()
+    {
+        events.assign(trace.begin(), trace.end());
+        trace = hashes.emplace(events).view();
+    }
+};
+
+// dynAlign and the kernels of the operators with their recursion turned into steps on the frames of an alignment
+template <typename Cost>
+struct FrameEvaluator
+{
+    SuspendableAlignment &alignment;
+
+    // dynAlign up to the kernel: closed forms, memo and projection. Returns true with the cost if that settles it,
+    // otherwise pushes a frame for the kernel and caller has to run the same step again once the frame is done.
+    bool value(AlignmentFrame *caller, const std::shared_ptr<TreeNode> &node, TraceView trace, int &cost)
+    {
+        if (caller && caller->hasResult)
+        {
+            caller->hasResult = false;
+            cost = caller->result;
+            return true;
+        }
+
+        switch (node->getShape())
+        {
+        case NodeShape::GENERIC:
+            break;
+        case NodeShape::LEAF:
+            cost = Cost::template alignShape<NodeShape::LEAF>(*node, trace.events());
+            return true;
+        case NodeShape::SILENT_LEAF:
+            cost = Cost::template alignShape<NodeShape::SILENT_LEAF>(*node, trace.events());
+            return true;
+        case NodeShape::LEAF_CHOICE:
+            cost = Cost::template alignShape<NodeShape::LEAF_CHOICE>(*node, trace.events());
+            return true;
+        case NodeShape::LEAF_PARALLEL:
+            cost = Cost::template alignShape<NodeShape::LEAF_PARALLEL>(*node, trace.events());
+            return true;
+        case NodeShape::LEAF_SEQUENCE:
+            cost = Cost::template alignShape<NodeShape::LEAF_SEQUENCE>(*node, trace.events());
+            return true;
+        case NodeShape::LEAF_LOOP:
+            cost = Cost::template alignShape<NodeShape::LEAF_LOOP>(*node, trace.events());
+            return true;
+        case NodeShape::SKIPPABLE_LEAF_LOOP:
+            cost = Cost::template alignShape<NodeShape::SKIPPABLE_LEAF_LOOP>(*node, trace.events());
+            return true;
+        }
+
+        const int memoKey = Cost::memoKey(*node);
+        // the adaptive policy times the misses, which a suspension would distort, so it memoizes like the static one
+        const MemoPolicy policy = activeMemoPolicy;
+        if (policy != MemoPolicy::ALWAYS)
+        {
+            if (trace.size() == 0)
+            {
+                memoPolicyStats.staticSkips++;
+                cost = Cost::minModelCost(*node);
+                return true;
+            }
+            if (cheapChoice(*node))
+            {
+                memoPolicyStats.staticSkips++;
+                auto frame = std::make_unique<AlignmentFrame>();
+                frame->node = node;
+                frame->memoKey = memoKey;
+                frame->memoize = false;
+                frame->trace = trace;
+                alignment.frames.push_back(std::move(frame));
+                return false;
+            }
+        }
+
+        auto &innerMap = costTable[memoKey];
+        int cachedCost = innerMap.find(trace);
+        if (cachedCost < 0 && activeMemoSnapshot)
+        {
+            cachedCost = activeMemoSnapshot->find(memoKey, trace);
+        }
+        if (cachedCost >= 0)
+        {
+            memoStats.hits++;
+            cost = cachedCost;
+            return true;
+        }
+
+        auto frame = std::make_unique<AlignmentFrame>();
+        frame->node = node;
+        frame->memoKey = memoKey;
+        frame->trace = trace;
+        const auto &activities = node->getActivities();
+        if (std::any_of(trace.begin(), trace.end(), [&activities](int x)
+                        { return activities.count(x) == 0; }))
+        {
+            for (const int val : trace)
+            {
+                if (activities.count(val) != 0)
+                {
+                    frame->events.push_back(val);
+                }
+                else
+                {
+                    frame->aliens += Cost::logMove(val);
+                }
+            }
+            frame->trace = frame->hashes.emplace(frame->events).view();
+            if (policy != MemoPolicy::ALWAYS && frame->trace.size() == 0)
+            {
+                memoPolicyStats.staticSkips++;
+                cost = Cost::minModelCost(*node) + frame->aliens;
+                return true;
+            }
+            const int prunedCost = innerMap.find(frame->trace);
+            if (prunedCost >= 0)
+            {
+                memoStats.hits++;
+                cost = prunedCost + frame->aliens;
+                return true;
+            }
+        }
+
+        memoStats.misses++;
+        switch (node->getOperation())
+        {
+        case SEQUENCE:
+        case PARALLEL:
+        case XOR:
+        case REDO_LOOP:
+            alignment.frames.push_back(std::move(frame));
+            return false;
+        case ACTIVITY:
+            cost = dynAlignActivity<Cost>(node, frame->trace);
+            break;
+        case SILENT_ACTIVITY:
+            cost = dynAlignSilentActivity<Cost>(node, frame->trace);
+            break;
+        default:
+            throw std::runtime_error("Unknown node operation: " + std::to_string(node->getOperation()));
+        }
+        innerMap.insert(frame->trace, cost);
+        cost += frame->aliens;
+        return true;
+    }
+
+    // the top frame is solved: memoize it and hand its cost to the frame below
+    void finish(int cost)
+    {
+        AlignmentFrame &frame = *alignment.frames.back();
+        if (frame.memoize)
+        {
+            costTable[frame.memoKey].insert(frame.trace, cost);
+        }
+        cost += frame.aliens;
+        alignment.frames.pop_back();
+        if (alignment.frames.empty())
+        {
+            alignment.finished = true;
+            alignment.cost = cost;
+            return;
+        }
+        alignment.frames.back()->hasResult = true;
+        alignment.frames.back()->result = cost;
+    }
+
+    // dynAlignSequence once the greedy partition (or skipping every child) is paid for
+    void settleGreedy(AlignmentFrame &frame)
+    {
+        const TraceView trace = frame.trace;
+        const int numChildren = frame.node->getChildren().size();
+        frame.bestCost = frame.partial;
+        if (frame.position < trace.size())
+        {
+            frame.bestCost += Cost::logMoves(trace.subspan(frame.position, trace.size() - frame.position));
+        }
+        if (frame.bestCost == 0)
+        {
+            return finish(0);
+        }
+
+        frame.index = 0;
+        if (numChildren == 2)
+        {
+            frame.segments = getSegmentsForSequence(trace, frame.node);
+            frame.phase = FramePhase::SEGMENT_LEFT;
+            return;
+        }
+
+        frame.splitPositions = {0};
+        for (size_t i = 1; i < trace.size(); i++)
+        {
+            if (frame.node->childIndexOf(trace[i]) != frame.node->childIndexOf(trace[i - 1]))
+            {
+                frame.splitPositions.push_back(i);
+            }
+        }
+        frame.splitPositions.push_back(trace.size());
+
+        for (int i = 0; i < numChildren - 1; i++)
+        {
+            for (const size_t splitPosition : frame.splitPositions)
+            {
+                frame.vertexCosts[{i, static_cast<int>(splitPosition)}] = std::numeric_limits<int>::max();
+            }
+        }
+        const IntPair startVertex = {-1, 0};
+        frame.vertexCosts[startVertex] = 0;
+        frame.vertexCosts[{numChildren - 1, static_cast<int>(frame.splitPositions.back())}] = std::numeric_limits<int>::max();
+        for (const size_t splitPosition : frame.splitPositions)
+        {
+            const IntPair initialVertex = {0, static_cast<int>(splitPosition)};
+            frame.stack.push_back(initialVertex);
+            frame.prevVertices[initialVertex] = startVertex;
+        }
+        frame.phase = FramePhase::SPLIT_PATHS;
+    }
+
+    void stepSequence(AlignmentFrame &frame)
+    {
+        const auto &children = frame.node->getChildren();
+        const size_t numChildren = children.size();
+        const TraceView trace = frame.trace;
+        const size_t n = trace.size();
+        int cost;
+
+        switch (frame.phase)
+        {
+        case FramePhase::START:
+            if (n == 0)
+            {
+                frame.phase = FramePhase::EMPTY_CHILDREN;
+            }
+            else if (numChildren == 1)
+            {
+                frame.phase = FramePhase::SINGLE_CHILD;
+            }
+            else if (n > numChildren && children[0]->getActivities().count(trace[0]) &&
+                     children.back()->getActivities().count(trace.back()))
+            {
+                frame.phase = FramePhase::GREEDY_PARTS;
+            }
+            else
+            {
+                frame.phase = FramePhase::SKIPPED_CHILDREN;
+            }
+            return;
+        case FramePhase::EMPTY_CHILDREN:
+            if (frame.index == numChildren)
+            {
+                return finish(frame.partial);
+            }
+            if (!value(&frame, children[frame.index], trace, cost))
+            {
+                return;
+            }
+            frame.partial += cost;
+            frame.index++;
+            return;
+        case FramePhase::SINGLE_CHILD:
+            if (value(&frame, children[0], trace, cost))
+            {
+                finish(cost);
+            }
+            return;
+        case FramePhase::GREEDY_PARTS:
+        {
+            if (frame.index == numChildren)
+            {
+                return settleGreedy(frame);
+            }
+            size_t end = frame.position;
+            while (end < n && children[frame.index]->getActivities().count(trace[end]))
+            {
+                end++;
+            }
+            if (!value(&frame, children[frame.index], trace.subspan(frame.position, end - frame.position), cost))
+            {
+                return;
+            }
+            frame.partial += cost;
+            frame.position = end;
+            frame.index++;
+            return;
+        }
+        case FramePhase::SKIPPED_CHILDREN:
+            if (frame.index == numChildren)
+            {
+                return settleGreedy(frame);
+            }
+            if (!value(&frame, children[frame.index], trace.subspan(0, 0), cost))
+            {
+                return;
+            }
+            frame.partial += cost;
+            frame.index++;
+            return;
+        case FramePhase::SEGMENT_LEFT:
+        {
+            if (frame.index == frame.segments.size())
+            {
+                return finish(frame.bestCost);
+            }
+            const size_t split = frame.segments[frame.index].first;
+            if (!value(&frame, children[0], trace.subspan(0, split), cost))
+            {
+                return;
+            }
+            if (cost >= frame.bestCost)
+            {
+                frame.index++;
+                return;
+            }
+            frame.partial = cost;
+            frame.phase = FramePhase::SEGMENT_RIGHT;
+            return;
+        }
+        case FramePhase::SEGMENT_RIGHT:
+        {
+            const size_t split = frame.segments[frame.index].first;
+            if (!value(&frame, children[1], trace.subspan(split, n - split), cost))
+            {
+                return;
+            }
+            frame.bestCost = std::min(frame.bestCost, frame.partial + cost);
+            if (frame.bestCost == 0)
+            {
+                return finish(0);
+            }
+            frame.index++;
+            frame.phase = FramePhase::SEGMENT_LEFT;
+            return;
+        }
+        case FramePhase::SPLIT_PATHS:
+        {
+            if (frame.bestCost == 0 || frame.stack.empty())
+            {
+                return finish(frame.bestCost);
+            }
+            // the vertex stays on the stack until its child is solved, so the step can run again unchanged
+            const IntPair currVertex = frame.stack.back();
+            const IntPair prevVertex = frame.prevVertices[currVertex];
+            if (!value(&frame, children[currVertex.first], trace.subspan(prevVertex.second, currVertex.second - prevVertex.second), cost))
+            {
+                return;
+            }
+            frame.stack.pop_back();
+
+            const int newCost = cost + frame.vertexCosts[prevVertex];
+            if (newCost >= frame.bestCost || newCost >= frame.vertexCosts[currVertex])
+            {
+                return;
+            }
+            frame.vertexCosts[currVertex] = newCost;
+            if (currVertex == IntPair(static_cast<int>(numChildren) - 1, static_cast<int>(frame.splitPositions.back())))
+            {
+                frame.bestCost = newCost;
+                return;
+            }
+            for (const auto &nextEdge : outgoingEdges(currVertex, frame.node, frame.splitPositions))
+            {
+                frame.prevVertices[nextEdge] = currVertex;
+                frame.stack.push_back(nextEdge);
+            }
+            return;
+        }
+        default:
+            throw std::logic_error("Sequence frame in a phase of another operator.");
+        }
+    }
+
+    void stepParallel(AlignmentFrame &frame)
+    {
+        const auto &children = frame.node->getChildren();
+        if (frame.phase == FramePhase::START)
+        {
+            frame.parts.resize(children.size());
+            for (const int activity : frame.trace)
+            {
+                const int child = frame.node->childIndexOf(activity);
+                if (child < 0)
+                {
+                    frame.partial += Cost::logMove(activity);
+                }
+                else
+                {
+                    frame.parts[child].push_back(activity);
+                }
+            }
+            for (const auto &part : frame.parts)
+            {
+                frame.partHashes.emplace_back(part);
+            }
+            frame.phase = FramePhase::CHILDREN;
+            return;
+        }
+
+        if (frame.index == children.size())
+        {
+            return finish(frame.partial);
+        }
+        int cost;
+        if (!value(&frame, children[frame.index], frame.partHashes[frame.index].view(), cost))
+        {
+            return;
+        }
+        frame.partial += cost;
+        frame.index++;
+    }
+
+    void stepXor(AlignmentFrame &frame)
+    {
+        const auto &children = frame.node->getChildren();
+        frame.phase = FramePhase::CHILDREN;
+        if (frame.index == children.size())
+        {
+            return finish(frame.bestCost);
+        }
+        int cost;
+        if (!value(&frame, children[frame.index], frame.trace, cost))
+        {
+            return;
+        }
+        if (cost == 0)
+        {
+            return finish(0);
+        }
+        frame.bestCost = std::min(frame.bestCost, cost);
+        frame.index++;
+    }
+
+    // dynAlignLoop once the greedy parts are paid for
+    void startEdges(AlignmentFrame &frame)
+    {
+        if (frame.bestCost == 0)
+        {
+            return finish(0);
+        }
+        frame.helper = frame.node->getLoopHelper() ? frame.node->getLoopHelper() : createLoopHelper(frame.node);
+        frame.position = 0;
+        frame.phase = FramePhase::LOOP_STARTS;
+    }
+
+    void stepLoop(AlignmentFrame &frame)
+    {
+        const auto &children = frame.node->getChildren();
+        const TraceView trace = frame.trace;
+        const size_t n = trace.size();
+        int cost;
+
+        switch (frame.phase)
+        {
+        case FramePhase::START:
+        {
+            if (children.size() != 2)
+            {
+                throw std::runtime_error("Loop node with id: " + std::to_string(frame.node->getId()) + " does not have exactly two children.");
+            }
+            if (n == 0)
+            {
+                frame.phase = FramePhase::EMPTY_LOOP;
+                return;
+            }
+            const auto &rActivities = children[0]->getActivities();
+            if (!rActivities.count(trace[0]) || !rActivities.count(trace[n - 1]))
+            {
+                return startEdges(frame);
+            }
+            size_t i = 0;
+            while (i < n && rActivities.count(trace[i]))
+            {
+                i++;
+            }
+            frame.rParts.push_back({0, static_cast<int>(i)});
+            while (i < n)
+            {
+                size_t j = i;
+                while (j < n && !rActivities.count(trace[j]))
+                {
+                    j++;
+                }
+                frame.qParts.push_back({static_cast<int>(i), static_cast<int>(j - i)});
+                i = j;
+                while (i < n && rActivities.count(trace[i]))
+                {
+                    i++;
+                }
+                frame.rParts.push_back({static_cast<int>(j), static_cast<int>(i - j)});
+            }
+            frame.phase = FramePhase::R_PARTS;
+            return;
+        }
+        case FramePhase::EMPTY_LOOP:
+            if (value(&frame, children[0], trace, cost))
+            {
+                finish(cost);
+            }
+            return;
+        case FramePhase::R_PARTS:
+        case FramePhase::Q_PARTS:
+        {
+            const bool rPart = frame.phase == FramePhase::R_PARTS;
+            const auto &parts = rPart ? frame.rParts : frame.qParts;
+            if (frame.index == parts.size())
+            {
+                frame.index = 0;
+                if (rPart)
+                {
+                    frame.phase = FramePhase::Q_PARTS;
+                    return;
+                }
+                frame.bestCost = std::min(frame.bestCost, frame.partial);
+                return startEdges(frame);
+            }
+            const IntPair part = parts[frame.index];
+            if (!value(&frame, children[rPart ? 0 : 1], trace.subspan(part.first, part.second), cost))
+            {
+                return;
+            }
+            frame.partial += cost;
+            frame.index++;
+            return;
+        }
+        case FramePhase::LOOP_STARTS:
+            if (frame.position > n)
+            {
+                return finish(frame.bestCost);
+            }
+            if (!value(&frame, children[0], trace.subspan(0, frame.position), cost))
+            {
+                return;
+            }
+            frame.rCost = cost;
+            frame.stack = {{static_cast<int>(frame.position), static_cast<int>(frame.position)}};
+            frame.firstEdge = true;
+            frame.phase = FramePhase::LOOP_EDGES;
+            return;
+        case FramePhase::LOOP_EDGES:
+        {
+            if (frame.stack.empty())
+            {
+                frame.position++;
+                frame.phase = FramePhase::LOOP_STARTS;
+                return;
+            }
+            const IntPair edge = frame.stack.back();
+            const IntPair totalEdge(0, edge.second);
+            const int prevEdgesCost = frame.firstEdge ? frame.rCost : frame.qrCosts[{0, edge.first}];
+            int edgesCost = prevEdgesCost;
+            if (prevEdgesCost < frame.bestCost && edge.second != edge.first)
+            {
+                if (!value(&frame, frame.helper, trace.subspan(edge.first, edge.second - edge.first), cost))
+                {
+                    return;
+                }
+                edgesCost += cost;
+            }
+            frame.stack.pop_back();
+            frame.firstEdge = false;
+
+            if (prevEdgesCost >= frame.bestCost || edgesCost >= frame.bestCost)
+            {
+                return;
+            }
+            const auto existingEdge = frame.qrCosts.find(totalEdge);
+            if (existingEdge != frame.qrCosts.end() && edgesCost >= existingEdge->second)
+            {
+                return;
+            }
+            frame.qrCosts[totalEdge] = edgesCost;
+            if (static_cast<size_t>(totalEdge.second) == n)
+            {
+                frame.bestCost = edgesCost;
+                return;
+            }
+            for (size_t j = totalEdge.second + 1; j <= n; j++)
+            {
+                frame.stack.push_back({totalEdge.second, static_cast<int>(j)});
+            }
+            return;
+        }
+        default:
+            throw std::logic_error("Loop frame in a phase of another operator.");
+        }
+    }
+
+    void step(AlignmentFrame &frame)
+    {
+        switch (frame.node->getOperation())
+        {
+        case SEQUENCE:
+            return stepSequence(frame);
+        case PARALLEL:
+            return stepParallel(frame);
+        case XOR:
+            return stepXor(frame);
+        case REDO_LOOP:
+            return stepLoop(frame);
+        default:
+            throw std::runtime_error("Unknown node operation: " + std::to_string(frame.node->getOperation()));
+        }
+    }
+
+    bool run(Deadline &deadline)
+    {
+        if (!alignment.started)
+        {
+            alignment.started = true;
+            // no fitsPerfectly shortcut, its walk recurses over the tree
+            const HashedTrace hashedTrace(alignment.trace);
+            int cost;
+            if (value(nullptr, alignment.root, hashedTrace.view(), cost))
+            {
+                alignment.finished = true;
+                alignment.cost = cost;
+                return true;
+            }
+            if (!alignment.frames.front()->hashes)
+            {
+                alignment.frames.front()->ownTrace();
+            }
+        }
+        while (!alignment.frames.empty())
+        {
+            if (deadline.expired())
+            {
+                return false;
+            }
+            step(*alignment.frames.back());
+        }
+        return alignment.finished;
+    }
+
+    static AlignmentResult bounds(const SuspendableAlignment &alignment)
+    {
+        if (alignment.finished)
+        {
+            return {alignment.cost, alignment.cost, true};
+        }
+        int upperBound = trivialUpperBound<Cost>(alignment.root, alignment.trace);
+        if (!alignment.frames.empty() && alignment.frames.front()->bestCost <= unbounded)
+        {
+            upperBound = std::min(upperBound, alignment.frames.front()->bestCost + alignment.frames.front()->aliens);
+        }
+        return {upperBound, trivialLowerBound<Cost>(alignment.root, alignment.trace), false};
+    }
+};
+
+SuspendableAlignment::SuspendableAlignment(std::shared_ptr<TreeNode> root, std::vector<int> trace, const CostModel *costs)
+    : root(std::move(root)), trace(std::move(trace)), costs(costs), frames(), started(false), finished(false), cost(0)
+{
+}
+
+SuspendableAlignment::SuspendableAlignment(SuspendableAlignment &&other) noexcept = default;
+
+SuspendableAlignment &SuspendableAlignment::operator=(SuspendableAlignment &&other) noexcept = default;
+
+SuspendableAlignment::~SuspendableAlignment() = default;
+
+/**
+ * Evaluates subproblems until the alignment is exact or the deadline expires. Every step solves at most one child of
+ * the top frame, so the deadline is polled at least once per child and memo hits count as steps too.
+ *
+ * @param deadline Suspends the alignment when it expires; it can run again with a new one
+ * @return Whether the cost is exact
+ */
+bool SuspendableAlignment::run(Deadline &deadline)
+{
+    if (!costs)
+    {
+        return FrameEvaluator<UnitCost>{*this}.run(deadline);
+    }
+    CostModelScope scope(*costs);
+    return FrameEvaluator<WeightedCost>{*this}.run(deadline);
+}
+
+bool SuspendableAlignment::done() const
+{
+    return finished;
+}
+
+AlignmentResult SuspendableAlignment::bounds() const
+{
+    if (!costs)
+    {
+        return FrameEvaluator<UnitCost>::bounds(*this);
+    }
+    CostModelScope scope(*costs);
+    return FrameEvaluator<WeightedCost>::bounds(*this);
+}
+
+size_t SuspendableAlignment::depth() const
+{
+    return frames.size();
+}
+
+// Saved frames are frameMagic followed by int words: the format version, the structure fingerprint of the tree, the
+// trace, the state of the alignment, the frames from the bottom up and a checksum.
+// Nodes are stored by preorder position, events by the index of the first event of the trace with their activity,
+// so neither depends on the activity ids or memo keys of the process.
+constexpr char frameMagic[8] = {'P', 'T', 'F', 'R', 'A', 'M', 'E', 'S'};
+constexpr int frameFormatVersion = 1;
+
+// the nodes of the tree by their preorderPositions
+std::vector<std::shared_ptr<TreeNode>> preorderNodes(const std::shared_ptr<TreeNode> &root)
+{
+    const auto positions = preorderPositions(root);
+    std::vector<std::shared_ptr<TreeNode>> nodes(positions.size());
+    std::vector<std::shared_ptr<TreeNode>> stack = {root};
+    while (!stack.empty())
+    {
+        const auto node = stack.back();
+        stack.pop_back();
+        nodes[positions.at(node.get())] = node;
+        stack.insert(stack.end(), node->getChildren().rbegin(), node->getChildren().rend());
+    }
+    return nodes;
+}
+
+// index of the first event of the trace with each activity
+std::unordered_map<int, int> eventIndices(const std::vector<int> &trace)
+{
+    std::unordered_map<int, int> indices;
+    for (const int event : trace)
+    {
+        indices.try_emplace(event, static_cast<int>(indices.size()));
+    }
+    return indices;
+}
+
+struct FrameWriter
+{
+    const std::unordered_map<int, int> &eventIndex;
+    std::vector<int> words;
+
+    void put(int64_t value)
+    {
+        words.push_back(static_cast<int>(value));
+    }
+
+    void putWide(uint64_t value)
+    {
+        put(static_cast<int32_t>(static_cast<uint32_t>(value)));
+        put(static_cast<int32_t>(static_cast<uint32_t>(value >> 32)));
+    }
+
+    void putEvents(std::span<const int> events)
+    {
+        put(events.size());
+        for (const int event : events)
+        {
+            put(eventIndex.at(event));
+        }
+    }
+
+    void putPairs(const std::vector<IntPair> &pairs)
+    {
+        put(pairs.size());
+        for (const auto &[first, second] : pairs)
+        {
+            put(first);
+            put(second);
+        }
+    }
+
+    void putCosts(const std::unordered_map<IntPair, int, PairHash> &costs)
+    {
+        put(costs.size());
+        for (const auto &[vertex, cost] : costs)
+        {
+            put(vertex.first);
+            put(vertex.second);
+            put(cost);
+        }
+    }
+};
+
+[[noreturn]] void framesDamaged()
+{
+    throw std::invalid_argument("Suspended frames are damaged.");
+}
+
+struct FrameReader
+{
+    std::span<const int> words;
+    const std::vector<int> &events;
+    size_t next = 0;
+
+    int get()
+    {
+        if (next == words.size())
+        {
+            framesDamaged();
+        }
+        return words[next++];
+    }
+
+    // a count or an index of at most limit
+    size_t getSize(size_t limit)
+    {
+        const int value = get();
+        if (value < 0 || static_cast<size_t>(value) > limit)
+        {
+            framesDamaged();
+        }
+        return static_cast<size_t>(value);
+    }
+
+    uint64_t getWide()
+    {
+        const uint64_t low = static_cast<uint32_t>(get());
+        const uint64_t high = static_cast<uint32_t>(get());
+        return low | high << 32;
+    }
+
+    std::vector<int> getEvents()
+    {
+        std::vector<int> result(getSize(words.size()));
+        for (int &event : result)
+        {
+            const size_t index = getSize(events.size());
+            if (index == events.size())
+            {
+                framesDamaged();
+            }
+            event = events[index];
+        }
+        return result;
+    }
+
+    IntPair getPair()
+    {
+        const int first = get();
+        return {first, get()};
+    }
+
+    std::vector<IntPair> getPairs()
+    {
+        std::vector<IntPair> pairs(getSize(words.size()));
+        for (auto &pair : pairs)
+        {
+            pair = getPair();
+        }
+        return pairs;
+    }
+
+    std::unordered_map<IntPair, int, PairHash> getCosts()
+    {
+        std::unordered_map<IntPair, int, PairHash> costs;
+        for (size_t count = getSize(words.size()); count > 0; count--)
+        {
+            const IntPair vertex = getPair();
+            costs[vertex] = get();
+        }
+        return costs;
+    }
+};
+
+/**
+ * Writes the frames with everything a step looks at: the trace, the phase and the state of the kernel such as the
+ * vertex costs and pending vertices of a split DP. The memo is not part of it, see writeMemoSnapshot.
+ *
+ * @return Bytes for loadFrames of an alignment of the same trace against a tree of the same structure
+ */
+std::string SuspendableAlignment::saveFrames() const
+{
+    const auto positions = preorderPositions(root);
+    const auto eventIndex = eventIndices(trace);
+    FrameWriter writer{eventIndex, {}};
+    writer.put(frameFormatVersion);
+    writer.putWide(structureFingerprint({root}));
+    writer.putEvents(trace);
+    writer.put(started);
+    writer.put(finished);
+    writer.put(cost);
+    writer.put(frames.size());
+    for (const auto &frame : frames)
+    {
+        // a loop helper is only ever pushed by its loop, the frame below
+        const auto position = positions.find(frame->node.get());
+        writer.put(position == positions.end() ? -1 : position->second);
+        writer.put(static_cast<int>(frame->phase));
+        writer.put(frame->memoize);
+        writer.put(frame->aliens);
+        writer.put(frame->hasResult);
+        writer.put(frame->result);
+        writer.put(frame->bestCost);
+        writer.put(frame->index);
+        writer.put(frame->position);
+        writer.put(frame->partial);
+        writer.put(frame->rCost);
+        writer.put(frame->firstEdge);
+        writer.putEvents(frame->trace.events());
+        writer.putPairs(frame->segments);
+        writer.put(frame->splitPositions.size());
+        for (const size_t splitPosition : frame->splitPositions)
+        {
+            writer.put(splitPosition);
+        }
+        writer.putCosts(frame->vertexCosts);
+        writer.put(frame->prevVertices.size());
+        for (const auto &[vertex, previous] : frame->prevVertices)
+        {
+            writer.put(vertex.first);
+            writer.put(vertex.second);
+            writer.put(previous.first);
+            writer.put(previous.second);
+        }
+        writer.putPairs(frame->stack);
+        writer.put(frame->parts.size());
+        for (const auto &part : frame->parts)
+        {
+            writer.putEvents(part);
+        }
+        writer.putPairs(frame->rParts);
+        writer.putPairs(frame->qParts);
+        writer.putCosts(frame->qrCosts);
+    }
+    writer.putWide(fingerprint(writer.words));
+
+    std::string saved(frameMagic, sizeof(frameMagic));
+    saved.append(reinterpret_cast<const char *>(writer.words.data()), writer.words.size() * sizeof(int));
+    return saved;
+}
+
+/**
+ * Replaces the frames with saved ones. Each loaded frame owns a copy of its trace, which fingerprints like the view it
+ * was saved from, so the memo keeps serving the same subproblems.
+ *
+ * @param saved Bytes of saveFrames
+ * @throws std::invalid_argument if the bytes are damaged or were saved for another tree or trace
+ */
+void SuspendableAlignment::loadFrames(const std::string &saved)
+{
+    if (saved.size() < sizeof(frameMagic) + 2 * sizeof(int) || (saved.size() - sizeof(frameMagic)) % sizeof(int) != 0 ||
+        saved.compare(0, sizeof(frameMagic), frameMagic, sizeof(frameMagic)) != 0)
+    {
+        framesDamaged();
+    }
+    std::vector<int> words((saved.size() - sizeof(frameMagic)) / sizeof(int));
+    std::memcpy(words.data(), saved.data() + sizeof(frameMagic), words.size() * sizeof(int));
+    const std::span<const int> body = std::span<const int>(words).first(words.size() - 2);
+    if (static_cast<uint32_t>(words[words.size() - 2]) != static_cast<uint32_t>(fingerprint(body)) ||
+        static_cast<uint32_t>(words.back()) != static_cast<uint32_t>(fingerprint(body) >> 32))
+    {
+        framesDamaged();
+    }
+
+    const auto eventIndex = eventIndices(trace);
+    std::vector<int> activities(eventIndex.size());
+    for (const auto &[activity, index] : eventIndex)
+    {
+        activities[index] = activity;
+    }
+    FrameReader reader{body, activities};
+    if (reader.get() != frameFormatVersion)
+    {
+        throw std::invalid_argument("Suspended frames were saved in another format.");
+    }
+    if (reader.getWide() != structureFingerprint({root}))
+    {
+        throw std::invalid_argument("Suspended frames were saved for another tree.");
+    }
+    if (reader.getEvents() != trace)
+    {
+        throw std::invalid_argument("Suspended frames were saved for another trace.");
+    }
+
+    const bool loadedStarted = reader.get() != 0;
+    const bool loadedFinished = reader.get() != 0;
+    const int loadedCost = reader.get();
+    const auto nodes = preorderNodes(root);
+    std::vector<std::unique_ptr<AlignmentFrame>> loaded(reader.getSize(words.size()));
+    for (size_t i = 0; i < loaded.size(); i++)
+    {
+        auto frame = std::make_unique<AlignmentFrame>();
+        const int position = reader.get();
+        if (position == -1 && i > 0 && loaded[i - 1]->helper)
+        {
+            frame->node = loaded[i - 1]->helper;
+        }
+        else if (position >= 0 && static_cast<size_t>(position) < nodes.size())
+        {
+            frame->node = nodes[position];
+        }
+        else
+        {
+            framesDamaged();
+        }
+        const Operation operation = frame->node->getOperation();
+        if (operation != SEQUENCE && operation != PARALLEL && operation != XOR && operation != REDO_LOOP)
+        {
+            framesDamaged();
+        }
+        frame->memoKey = costs ? costs->memoKey(*frame->node) : frame->node->getMemoKey();
+        frame->phase = static_cast<FramePhase>(reader.getSize(static_cast<size_t>(FramePhase::LOOP_EDGES)));
+        frame->memoize = reader.get() != 0;
+        frame->aliens = reader.get();
+        frame->hasResult = reader.get() != 0;
+        frame->result = reader.get();
+        frame->bestCost = reader.get();
+        frame->index = reader.getSize(words.size());
+        frame->position = reader.getSize(trace.size() + 1);
+        frame->partial = reader.get();
+        frame->rCost = reader.get();
+        frame->firstEdge = reader.get() != 0;
+        frame->events = reader.getEvents();
+        frame->trace = frame->hashes.emplace(frame->events).view();
+        frame->segments = reader.getPairs();
+        frame->splitPositions.resize(reader.getSize(words.size()));
+        for (size_t &splitPosition : frame->splitPositions)
+        {
+            splitPosition = reader.getSize(frame->trace.size());
+        }
+        frame->vertexCosts = reader.getCosts();
+        for (size_t count = reader.getSize(words.size()); count > 0; count--)
+        {
+            const IntPair vertex = reader.getPair();
+            frame->prevVertices[vertex] = reader.getPair();
+        }
+        frame->stack = reader.getPairs();
+        frame->parts.resize(reader.getSize(words.size()));
+        for (auto &part : frame->parts)
+        {
+            part = reader.getEvents();
+        }
+        for (const auto &part : frame->parts)
+        {
+            frame->partHashes.emplace_back(part);
+        }
+        frame->rParts = reader.getPairs();
+        frame->qParts = reader.getPairs();
+        frame->qrCosts = reader.getCosts();
+        if (operation == REDO_LOOP && frame->phase >= FramePhase::LOOP_STARTS)
+        {
+            frame->helper = frame->node->getLoopHelper() ? frame->node->getLoopHelper() : createLoopHelper(frame->node);
+        }
+        loaded[i] = std::move(frame);
+    }
+    if (reader.next != body.size() || (loadedFinished || !loadedStarted) != loaded.empty())
+    {
+        framesDamaged();
+    }
+
+    frames = std::move(loaded);
+    started = loadedStarted;
+    finished = loadedFinished;
+    cost = loadedCost;
+}
+
+void DeviationCounts::add(const DeviationCounts &other)
+{
+    const auto addAll = [](std::vector<size_t> &into, const std::vector<size_t> &from)
+    {
+        into.resize(std::max(into.size(), from.size()));
+        for (size_t i = 0; i < from.size(); ++i)
+        {
+            into[i] += from[i];
+        }
+    };
+    addAll(syncMoves, other.syncMoves);
+    addAll(logMoves, other.logMoves);
+    addAll(modelMoves, other.modelMoves);
+    unknownLogMoves += other.unknownLogMoves;
+    addAll(nodeLogMoves, other.nodeLogMoves);
+    addAll(nodeModelMoves, other.nodeModelMoves);
+    traces += other.traces;
+    skippedTraces += other.skippedTraces;
+}
+
+std::unordered_map<const TreeNode *, int> preorderPositions(const std::shared_ptr<TreeNode> &root)
+{
+    std::unordered_map<const TreeNode *, int> positions;
+    std::vector<const TreeNode *> stack = {root.get()};
+    while (!stack.empty())
+    {
+        const TreeNode *node = stack.back();
+        stack.pop_back();
+        const int position = static_cast<int>(positions.size());
+        positions.try_emplace(node, position);
+        const auto &children = node->getChildren();
+        for (auto it = children.rbegin(); it != children.rend(); ++it)
+        {
+            stack.push_back(it->get());
+        }
+    }
+    return positions;
+}
+
+// One optimal alignment walked from the root down. Every node projects its part of the trace like dynAlign does;
+// sequences and loops run their split search once more with the memo warm from the alignment and follow the split
+// it settles on, choices follow their cheapest child.
+template <typename Cost>
+struct DeviationWalk
+{
+    const std::unordered_map<const TreeNode *, int> &positions;
+    size_t frequency;
+    DeviationCounts &counts;
+    // of the moves counted so far
+    int cost = 0;
+
+    void count(std::vector<size_t> &counters, size_t index)
+    {
+        if (index >= counters.size())
+        {
+            counters.resize(index + 1);
+        }
+        counters[index] += frequency;
+    }
+
+    void logMove(int activity, int position)
+    {
+        cost += Cost::logMove(activity);
+        if (activity < 0)
+        {
+            counts.unknownLogMoves += frequency;
+        }
+        else
+        {
+            count(counts.logMoves, activity);
+        }
+        count(counts.nodeLogMoves, position);
+    }
+
+    void modelMove(int activity, int position)
+    {
+        cost += Cost::modelMove(activity);
+        count(counts.modelMoves, activity);
+        count(counts.nodeModelMoves, position);
+    }
+
+    // false if a split search came back without a split
+    bool walk(const std::shared_ptr<TreeNode> &node, std::span<const int> trace)
+    {
+        const int position = positions.at(node.get());
+        const auto &activities = node->getActivities();
+        std::vector<int> projected;
+        for (const int activity : trace)
+        {
+            if (activities.count(activity) != 0)
+            {
+                projected.push_back(activity);
+            }
+            else
+            {
+                logMove(activity, position);
+            }
+        }
+
+        switch (node->getOperation())
+        {
+        case ACTIVITY:
+            // matching one event is always cheaper than a model move, any further ones are log moves
+            if (projected.empty())
+            {
+                modelMove(node->getActivity(), position);
+                return true;
+            }
+            count(counts.syncMoves, node->getActivity());
+            for (size_t i = 1; i < projected.size(); ++i)
+            {
+                logMove(node->getActivity(), position);
+            }
+            return true;
+        case SILENT_ACTIVITY:
+            return true;
+        case XOR:
+            return walkXor(node, projected);
+        case PARALLEL:
+            return walkParallel(node, projected, position);
+        case SEQUENCE:
+            return walkSequence(node, projected, position);
+        case REDO_LOOP:
+            return walkLoop(node, projected, position);
+        default:
+            throw std::runtime_error("Unknown node operation: " + std::to_string(node->getOperation()));
+        }
+    }
+
+    bool walkXor(const std::shared_ptr<TreeNode> &node, const std::vector<int> &trace)
+    {
+        const HashedTrace hashed(trace);
+        const std::shared_ptr<TreeNode> *best = nullptr;
+        int bestCost = unbounded;
+        for (const auto &child : node->getChildren())
+        {
+            const int childCost = dynAlign<Cost>(child, hashed.view(), bestCost - 1);
+            if (childCost < bestCost)
+            {
+                bestCost = childCost;
+                best = &child;
+            }
+        }
+        return best && walk(*best, trace);
+    }
+
+    // the same split as dynAlignParallel: every event goes to the child that has its activity
+    bool walkParallel(const std::shared_ptr<TreeNode> &node, const std::vector<int> &trace, int position)
+    {
+        const auto &children = node->getChildren();
+        std::vector<std::vector<int>> subTraces(children.size());
+        for (const int activity : trace)
+        {
+            const int child = node->childIndexOf(activity);
+            if (child < 0)
+            {
+                logMove(activity, position);
+            }
+            else
+            {
+                subTraces[child].push_back(activity);
+            }
+        }
+        for (size_t i = 0; i < children.size(); ++i)
+        {
+            if (!walk(children[i], subTraces[i]))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // also walks the parts of loop helpers, which have no position of their own; their log moves go to the loop
+    bool walkSequence(const std::shared_ptr<TreeNode> &node, std::span<const int> trace, int position)
+    {
+        const auto &children = node->getChildren();
+        const HashedTrace hashed(trace);
+        std::vector<size_t> cuts;
+        dynAlignSequence<Cost>(node, hashed.view(), unbounded, &cuts);
+        if (cuts.size() != children.size() + 1)
+        {
+            return false;
+        }
+        for (size_t i = 0; i < children.size(); ++i)
+        {
+            if (!walk(children[i], trace.subspan(cuts[i], cuts[i + 1] - cuts[i])))
+            {
+                return false;
+            }
+        }
+        for (size_t i = cuts.back(); i < trace.size(); ++i)
+        {
+            logMove(trace[i], position);
+        }
+        return true;
+    }
+
+    bool walkLoop(const std::shared_ptr<TreeNode> &node, std::span<const int> trace, int position)
+    {
+        const HashedTrace hashed(trace);
+        std::vector<size_t> cuts;
+        dynAlignLoop<Cost>(node, hashed.view(), unbounded, &cuts);
+        if (cuts.empty() || cuts.back() != trace.size() || !walk(node->getChildren()[0], trace.subspan(0, cuts[0])))
+        {
+            return false;
+        }
+        const std::shared_ptr<TreeNode> helper = node->getLoopHelper() ? node->getLoopHelper() : createLoopHelper(node);
+        for (size_t i = 1; i < cuts.size(); ++i)
+        {
+            if (!walkSequence(helper, trace.subspan(cuts[i - 1], cuts[i] - cuts[i - 1]), position))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+};
+
+template <typename Cost>
+bool countDeviations(const std::shared_ptr<TreeNode> &root, std::span<const int> trace,
+                     const std::unordered_map<const TreeNode *, int> &positions, size_t frequency, DeviationCounts &counts)
+{
+    // a perfectly fitting trace is matched event by event
+    if (fitsPerfectly(*root, trace))
+    {
+        counts.traces += frequency;
+        DeviationWalk<Cost> walk{positions, frequency, counts};
+        for (const int activity : trace)
+        {
+            walk.count(counts.syncMoves, activity);
+        }
+        return true;
+    }
+
+    // the moves are only added if they make up an optimal alignment
+    DeviationCounts traceCounts;
+    DeviationWalk<Cost> walk{positions, frequency, traceCounts};
+    if (!walk.walk(root, trace) || walk.cost != alignTrace<Cost>(root, trace))
+    {
+        counts.skippedTraces += frequency;
+        return false;
+    }
+    traceCounts.traces = frequency;
+    counts.add(traceCounts);
+    return true;
+}
+
+bool countDeviations(const std::shared_ptr<TreeNode> &root, std::span<const int> trace,
+                     const std::unordered_map<const TreeNode *, int> &positions, size_t frequency, DeviationCounts &counts,
+                     const CostModel *costs)
+{
+    // one entry per node, also for the nodes without deviations
+    counts.nodeLogMoves.resize(std::max(counts.nodeLogMoves.size(), positions.size()));
+    counts.nodeModelMoves.resize(std::max(counts.nodeModelMoves.size(), positions.size()));
+    if (!costs)
+    {
+        return countDeviations<UnitCost>(root, trace, positions, frequency, counts);
+    }
+    CostModelScope scope(*costs);
+    return countDeviations<WeightedCost>(root, trace, positions, frequency, counts);
 }
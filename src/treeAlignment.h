@@ -1,12 +1,177 @@
 #ifndef TREEALIGNMENT_H
 #define TREEALIGNMENT_H
+#include "costModel.h"
+#include "traceView.h"
 #include "treeNode.h"
 #include <memory>
 #include <span>
 #include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
 
-const size_t dynAlign(std::shared_ptr<TreeNode> node, const std::span<const int> trace);
+// Cancellation token for a single alignment. dynAlign polls it on every call,
+// but only looks at the clock every checkInterval calls to keep the poll cheap.
+class Deadline
+{
+public:
+    static constexpr uint32_t checkInterval = 1024;
 
-extern std::atomic<bool> stop_flag;
+    // never expires unless cancelled
+    Deadline();
 
-#endif // TREENODE_H
\ No newline at end of file
+    // a non-positive timeout means no time limit
+    explicit Deadline(std::chrono::milliseconds timeout);
+
+    // may be called from any thread, is noticed within checkInterval dynAlign calls
+    void cancel();
+
+    bool expired();
+
+    bool hasExpired() const;
+
+private:
+    std::chrono::steady_clock::time_point end;
+    bool limited;
+    bool timedOut;
+    uint32_t callsUntilCheck;
+    std::atomic<bool> cancelled;
+};
+
+// memo lookups of dynAlign on this thread, a miss is a subproblem that had to be computed
+struct MemoStats
+{
+    size_t hits = 0;
+    size_t misses = 0;
+};
+
+extern thread_local MemoStats memoStats;
+
+// cost is an upper bound and lowerBound a lower bound on the optimal alignment cost,
+// both are equal to it if exact is set
+struct AlignmentResult
+{
+    int cost;
+    int lowerBound;
+    bool exact;
+};
+
+int dynAlign(const std::shared_ptr<TreeNode> &node, const std::span<const int> trace);
+
+// same as above for a subtrace whose prefix hashes already exist
+int dynAlign(const std::shared_ptr<TreeNode> &node, TraceView trace);
+
+// The entry points below align with unit costs unless given a cost model built for root. The kernels are
+// instantiated once per cost function, so unit costs pay nothing for the weighted ones.
+
+// runs dynAlign on the calling thread; if the deadline expires first, the best bounds found so far are returned
+AlignmentResult alignAnytime(const std::shared_ptr<TreeNode> &root, std::span<const int> trace, Deadline &deadline,
+                             const CostModel *costs = nullptr);
+
+// runs dynAlign on the calling thread, returns -1 if the deadline expired first
+int alignWithDeadline(const std::shared_ptr<TreeNode> &root, std::span<const int> trace, Deadline &deadline,
+                      const CostModel *costs = nullptr);
+
+// exact result if the cost is at most budget, otherwise lowerBound is above budget (or the deadline expired)
+AlignmentResult alignWithin(const std::shared_ptr<TreeNode> &root, std::span<const int> trace, int budget, Deadline &deadline,
+                            const CostModel *costs = nullptr);
+
+// the cost if it is at most budget, -1 otherwise
+int alignWithin(const std::shared_ptr<TreeNode> &root, std::span<const int> trace, int budget);
+
+struct AlignmentFrame;
+
+template <typename Cost>
+struct FrameEvaluator;
+
+// An exact alignment that evaluates the subproblems on an explicit stack of frames instead of the call stack, so it
+// can stop after any step and go on later, on any thread, or in another process once its frames are saved. A frame
+// holds what dynAlign and the kernel of the operator keep in locals, e.g. the split DP of a sequence or the costs of
+// the parts of a loop, and each step solves at most one child. Subproblems go through the memo of the calling thread
+// as in dynAlign; the frames do not depend on it, a different memo between two runs only changes what is a hit.
+class SuspendableAlignment
+{
+public:
+    // costs has to be built for root and outlive the alignment, nullptr for unit costs
+    SuspendableAlignment(std::shared_ptr<TreeNode> root, std::vector<int> trace, const CostModel *costs = nullptr);
+
+    SuspendableAlignment(SuspendableAlignment &&other) noexcept;
+
+    SuspendableAlignment &operator=(SuspendableAlignment &&other) noexcept;
+
+    ~SuspendableAlignment();
+
+    // steps until the cost is exact or the deadline expired, the deadline is polled before every step
+    bool run(Deadline &deadline);
+
+    bool done() const;
+
+    // exact once done, otherwise bounds from the trace and the best alignment the root found so far
+    AlignmentResult bounds() const;
+
+    // frames waiting for their children
+    size_t depth() const;
+
+    // the suspended frames in a form that only depends on the tree structure and the trace
+    std::string saveFrames() const;
+
+    // @throws std::invalid_argument if the frames are damaged or were saved for another tree or trace
+    void loadFrames(const std::string &frames);
+
+private:
+    template <typename Cost>
+    friend struct FrameEvaluator;
+
+    std::shared_ptr<TreeNode> root;
+    std::vector<int> trace;
+    const CostModel *costs;
+    std::vector<std::unique_ptr<AlignmentFrame>> frames;
+    bool started;
+    bool finished;
+    int cost;
+};
+
+// Moves of optimal alignments summed over many traces, per activity and per node of one tree
+struct DeviationCounts
+{
+    // by activity id: events the model matched, events it could not match and activities of the run no event matched
+    std::vector<size_t> syncMoves;
+    std::vector<size_t> logMoves;
+    std::vector<size_t> modelMoves;
+    // log moves of events whose label is in no tree
+    size_t unknownLogMoves = 0;
+    // By position of the node in a preorder walk of the tree, see preorderPositions. A log move is charged to the
+    // highest node whose alphabet lacks the event, or to the leaf that already matched it; a model move to its leaf.
+    std::vector<size_t> nodeLogMoves;
+    std::vector<size_t> nodeModelMoves;
+    // traces counted, and those left out because their alignment was not exact or could not be rebuilt
+    size_t traces = 0;
+    size_t skippedTraces = 0;
+
+    void add(const DeviationCounts &other);
+};
+
+// position of every node of the tree in a preorder walk
+std::unordered_map<const TreeNode *, int> preorderPositions(const std::shared_ptr<TreeNode> &root);
+
+/**
+ * Adds the moves of one optimal alignment of the trace to counts. Sequences and loops run their split search once
+ * more and follow the split it settles on, so right after the trace was aligned on this thread their children are
+ * memo hits and the walk costs about as much as one more pass over the nodes of the alignment.
+ *
+ * @param root Root of the process tree
+ * @param trace Encoded trace
+ * @param positions preorderPositions of root
+ * @param frequency Cases with this trace, every move is counted this many times
+ * @param counts Receives the moves, or the trace as skipped
+ * @param costs Cost model the trace was aligned with, nullptr for unit costs
+ * @return false if the walk did not rebuild an alignment of the optimal cost, e.g. because a deadline of the thread
+ *         cut a split search short; the trace then only counts as skipped
+ */
+bool countDeviations(const std::shared_ptr<TreeNode> &root, std::span<const int> trace,
+                     const std::unordered_map<const TreeNode *, int> &positions, size_t frequency, DeviationCounts &counts,
+                     const CostModel *costs = nullptr);
+
+#endif // TREEALIGNMENT_H
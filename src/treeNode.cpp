@@ -1,29 +1,106 @@
 #include "parser.h"
 #include "treeNode.h"
 #include "utils.h"
+#include <algorithm>
 #include <iostream>
+#include <limits>
 #include <memory>
+#include <mutex>
 #include <unordered_map>
 #include <unordered_set>
 
 int TreeNode::numberOfNodes = 0;
 
-std::unordered_map<int, std::unordered_map<std::vector<int>, int, SpanHash, SpanEqual>> costTable;
+thread_local CostTable costTable;
 
-TreeNode::TreeNode(Operation operation)
-    : activities(), children(), operation(operation), id(++numberOfNodes)
+// Structure of every subtree seen so far -> its memo key. Like the activity dictionary it is shared by all trees
+// and only ever grows, so a key never changes meaning while a memo still holds entries under it.
+std::unordered_map<std::vector<int>, int, SpanHash, SpanEqual> subtreeKeys;
+std::mutex subtreeKeysMutex;
+
+/**
+ * Returns the memo key of a structure, interning it if it is new. The structure of a subtree is the operation,
+ * the activity of a leaf and the keys of the children in order, so two subtrees get the same key exactly if they
+ * are equal. Other users of the memo start their structures with a negative tag to stay apart from subtrees.
+ *
+ * @param structure Encoded subtree
+ * @return Key shared by every subtree with this structure
+ */
+int internSubtree(std::vector<int> structure)
 {
-    if (operation == ACTIVITY) {
-        activities.insert(this->getId());
+    std::lock_guard<std::mutex> lock(subtreeKeysMutex);
+    const int nextKey = static_cast<int>(subtreeKeys.size()) + 1;
+    return subtreeKeys.try_emplace(std::move(structure), nextKey).first->second;
+}
+
+size_t costTableEntries(const CostTable &table)
+{
+    size_t entries = 0;
+    for (const auto &[nodeId, innerMap] : table)
+    {
+        entries += innerMap.size();
+    }
+    return entries;
+}
+
+size_t costTableBytes(const CostTable &table)
+{
+    size_t bytes = 0;
+    for (const auto &[nodeId, innerMap] : table)
+    {
+        bytes += innerMap.memoryBytes();
     }
+    return bytes;
+}
+
+const char *operationToString(Operation operation)
+{
+    switch (operation)
+    {
+    case SEQUENCE:
+        return "SEQUENCE";
+    case PARALLEL:
+        return "PARALLEL";
+    case XOR:
+        return "XOR";
+    case REDO_LOOP:
+        return "REDO_LOOP";
+    case XOR_LOOP:
+        return "XOR_LOOP";
+    case ACTIVITY:
+        return "ACTIVITY";
+    case SILENT_ACTIVITY:
+        return "SILENT_ACTIVITY";
+    }
+    return "UNKNOWN";
+}
+
+NodeShape initialShape(Operation operation)
+{
+    switch (operation)
+    {
+    case ACTIVITY:
+        return NodeShape::LEAF;
+    case SILENT_ACTIVITY:
+        return NodeShape::SILENT_LEAF;
+    default:
+        return NodeShape::GENERIC;
+    }
+}
+
+TreeNode::TreeNode(Operation operation)
+    : TreeNode(operation, ++numberOfNodes)
+{
 }
 
 TreeNode::TreeNode(Operation operation, int id)
-    : activities(), children(), operation(operation), id(id)
+    : id(id), activity(operation == ACTIVITY ? id : -1), operation(operation), minModelCost(operation == ACTIVITY ? 1 : 0),
+      shape(initialShape(operation)), activities(), children()
 {
-        if (operation == ACTIVITY) {
-        activities.insert(id);
+    if (operation == ACTIVITY) {
+        activities.insert(activity);
     }
+    updateMemoKey();
 }
 
 int TreeNode::getId() const
@@ -31,11 +108,49 @@ int TreeNode::getId() const
     return id;
 }
 
+int TreeNode::getMemoKey() const
+{
+    return memoKey;
+}
+
+void TreeNode::updateMemoKey()
+{
+    std::vector<int> structure = {operation, activity};
+    structure.reserve(children.size() + 2);
+    for (const auto &child : children)
+    {
+        structure.push_back(child->getMemoKey());
+    }
+    memoKey = internSubtree(std::move(structure));
+}
+
 Operation TreeNode::getOperation() const
 {
     return operation;
 }
 
+int TreeNode::getActivity() const
+{
+    return activity;
+}
+
+void TreeNode::setActivity(int newActivity)
+{
+    activity = newActivity;
+    activities = {newActivity};
+    updateMemoKey();
+}
+
+const std::shared_ptr<TreeNode> &TreeNode::getLoopHelper() const
+{
+    return loopHelper;
+}
+
+void TreeNode::setLoopHelper(std::shared_ptr<TreeNode> helper)
+{
+    loopHelper = std::move(helper);
+}
+
 void TreeNode::setActivities(std::unordered_set<int> newActivities)
 {
     activities = newActivities;
@@ -46,6 +161,11 @@ void TreeNode::addChild(std::shared_ptr<TreeNode> child)
     children.push_back(child);
 }
 
+void TreeNode::setChildren(std::vector<std::shared_ptr<TreeNode>> newChildren)
+{
+    children = std::move(newChildren);
+}
+
 const std::unordered_set<int> &TreeNode::getActivities() const
 {
     return activities;
@@ -56,6 +176,65 @@ const std::vector<std::shared_ptr<TreeNode>> &TreeNode::getChildren() const
     return children;
 }
 
+int TreeNode::getMinModelCost() const
+{
+    return minModelCost;
+}
+
+NodeShape TreeNode::getShape() const
+{
+    return shape;
+}
+
+int TreeNode::childIndexOf(int activity) const
+{
+    const auto it = activityChildren.find(activity);
+    return it == activityChildren.end() ? -1 : it->second;
+}
+
+// shape of an operator node given its current children
+NodeShape classifyShape(Operation operation, const std::vector<std::shared_ptr<TreeNode>> &children)
+{
+    const bool leavesOnly = std::all_of(children.begin(), children.end(), [](const auto &child)
+                                        { return child->getOperation() == ACTIVITY || child->getOperation() == SILENT_ACTIVITY; });
+    if (!leavesOnly || children.empty())
+    {
+        return NodeShape::GENERIC;
+    }
+
+    switch (operation)
+    {
+    case SEQUENCE:
+        // the LCS kernel needs every child to consume an event
+        if (std::all_of(children.begin(), children.end(), [](const auto &child)
+                        { return child->getOperation() == ACTIVITY; }))
+        {
+            return NodeShape::LEAF_SEQUENCE;
+        }
+        return NodeShape::GENERIC;
+    case XOR:
+        return NodeShape::LEAF_CHOICE;
+    case PARALLEL:
+        return NodeShape::LEAF_PARALLEL;
+    case REDO_LOOP:
+        if (children.size() != 2)
+        {
+            return NodeShape::GENERIC;
+        }
+        if (children[0]->getOperation() == ACTIVITY && children[1]->getOperation() == SILENT_ACTIVITY)
+        {
+            return NodeShape::LEAF_LOOP;
+        }
+        if (children[0]->getOperation() == SILENT_ACTIVITY && children[1]->getOperation() == ACTIVITY)
+        {
+            return NodeShape::SKIPPABLE_LEAF_LOOP;
+        }
+        return NodeShape::GENERIC;
+    default:
+        return NodeShape::GENERIC;
+    }
+}
+
 void TreeNode::fillActivityMaps()
 {
 
@@ -65,12 +244,46 @@ void TreeNode::fillActivityMaps()
     }
 
     auto &currActivities = this->activities;
-    for (auto &child : this->getChildren())
+    activityChildren.clear();
+    for (size_t childIndex = 0; childIndex < children.size(); ++childIndex)
     {
-        for (const auto &activity : child->getActivities())
+        for (const auto &activity : children[childIndex]->getActivities())
         {
             currActivities.insert(activity);
+            activityChildren[activity] = childIndex;
+        }
+    }
+    // children are complete whenever the maps are filled, the parser and the normalization both work bottom up
+    updateMemoKey();
+
+    if (children.empty())
+    {
+        return;
+    }
+
+    shape = classifyShape(operation, children);
+
+    switch (operation)
+    {
+    case XOR:
+        minModelCost = std::numeric_limits<int>::max();
+        for (const auto &child : children)
+        {
+            minModelCost = std::min(minModelCost, child->getMinModelCost());
         }
+        break;
+    case REDO_LOOP:
+    case XOR_LOOP:
+        // the shortest run only executes the do part once
+        minModelCost = children[0]->getMinModelCost();
+        break;
+    default:
+        minModelCost = 0;
+        for (const auto &child : children)
+        {
+            minModelCost += child->getMinModelCost();
+        }
+        break;
     }
 }
 
@@ -79,12 +292,7 @@ void TreeNode::printTree(int level)
     std::string activityName = "None"; // Default if activity is -1 or not found
 
     if (this->operation == ACTIVITY) {
-        auto it = idToActivity.find(this->getId());
-        if (it != idToActivity.end()) {
-            activityName = it->second; // Found the activity, get its name
-        } else {
-            activityName = "Unknown Activity (ID: " + std::to_string(this->getId()) + ")";
-        }
+        activityName = activityLabel(this->getActivity());
     }
 
     std::cout << std::string(level * 2, ' ') << "Node ID: " << this->getId() << ", Operation: " << this->getOperation() << ", Activity (if exists): " << activityName << std::endl;
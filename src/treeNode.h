@@ -1,6 +1,7 @@
 #ifndef TREENODE_H
 #define TREENODE_H
 
+#include "memoTable.h"
 #include <memory>
 #include <string>
 #include <unordered_set>
@@ -63,8 +64,18 @@ struct SpanEqual
     }
 };
 
-// node id -> (trace -> alignmentcost)
-extern std::unordered_map<int, std::unordered_map<std::vector<int>, int, SpanHash, SpanEqual>> costTable;
+// memo key -> (trace -> alignmentcost)
+using CostTable = std::unordered_map<int, MemoTable>;
+
+// one memo per thread so alignments can run concurrently
+extern thread_local CostTable costTable;
+
+size_t costTableEntries(const CostTable &table);
+
+// memo key of an encoded structure, equal structures get equal keys in every tree
+int internSubtree(std::vector<int> structure);
+
+size_t costTableBytes(const CostTable &table);
 
 enum Operation
 {
@@ -77,6 +88,26 @@ enum Operation
     SILENT_ACTIVITY // 6
 };
 
+const char *operationToString(Operation operation);
+
+// Subtree shapes whose alignment cost has a closed form, see alignShape in treeAlignment.cpp
+enum class NodeShape
+{
+    GENERIC,
+    LEAF,
+    SILENT_LEAF,
+    // X(a, b, tau, ...) over leaves
+    LEAF_CHOICE,
+    // +(a, b, tau, ...) over leaves
+    LEAF_PARALLEL,
+    // ->(a, b, ...) over leaves
+    LEAF_SEQUENCE,
+    // *(a, tau), i.e. a at least once
+    LEAF_LOOP,
+    // *(tau, a), i.e. a any number of times
+    SKIPPABLE_LEAF_LOOP
+};
+
 class TreeNode
 {
 public:
@@ -86,26 +117,60 @@ public:
 
     int getId() const;
 
+    // Structural key of the subtree, interned across all trees: subtrees with the same operators, activity ids and
+    // child order get the same key wherever they occur, so they share one memo partition. Activity ids are shared
+    // by all trees, so a fragment that is unchanged in an edited model keeps its key and its memoized costs.
+    int getMemoKey() const;
+
     Operation getOperation() const;
 
+    // activity id a leaf matches, the node id unless set otherwise; -1 for other nodes
+    int getActivity() const;
+
+    void setActivity(int newActivity);
+
     const std::unordered_set<int> &getActivities() const;
 
     void setActivities(std::unordered_set<int> newActivities);
 
     void addChild(std::shared_ptr<TreeNode> child);
 
+    void setChildren(std::vector<std::shared_ptr<TreeNode>> newChildren);
+
     const std::vector<std::shared_ptr<TreeNode>> &getChildren() const;
 
+    // number of visible activities on the cheapest run through this subtree,
+    // i.e. the alignment cost of the empty trace
+    int getMinModelCost() const;
+
+    NodeShape getShape() const;
+
+    // index of the child whose alphabet contains the activity, -1 if none does
+    int childIndexOf(int activity) const;
+
+    // ->(redo, do) that dynAlignLoop aligns the (redo do)* part of a loop trace with
+    const std::shared_ptr<TreeNode> &getLoopHelper() const;
+
+    void setLoopHelper(std::shared_ptr<TreeNode> helper);
+
     void fillActivityMaps();
 
     void printTree(int level = 0);
 
 private:
+    void updateMemoKey();
+
     static int numberOfNodes;
     int id;
+    int memoKey;
+    int activity;
     Operation operation;
+    int minModelCost;
+    NodeShape shape;
     std::unordered_set<int> activities;
+    std::unordered_map<int, int> activityChildren;
     std::vector<std::shared_ptr<TreeNode>> children;
+    std::shared_ptr<TreeNode> loopHelper;
 };
 
 #endif // TREENODE_H
\ No newline at end of file
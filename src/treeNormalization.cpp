@@ -0,0 +1,135 @@
+#include "treeNormalization.h"
+#include "parser.h"
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+size_t countNodes(const std::shared_ptr<TreeNode> &root)
+{
+    size_t nodes = 1;
+    for (const auto &child : root->getChildren())
+    {
+        nodes += countNodes(child);
+    }
+    return nodes;
+}
+
+int maxNodeId(const std::shared_ptr<TreeNode> &root)
+{
+    int maxId = root->getId();
+    for (const auto &child : root->getChildren())
+    {
+        maxId = std::max(maxId, maxNodeId(child));
+    }
+    return maxId;
+}
+
+bool isSilent(const std::shared_ptr<TreeNode> &node)
+{
+    return node->getOperation() == SILENT_ACTIVITY;
+}
+
+/**
+ * Normalizes a subtree bottom up. Sequences, parallels and choices are associative, so a child with
+ * the same operator is replaced by its children. A tau in a sequence or parallel is the neutral element and
+ * is dropped, a choice keeps at most one tau. An operator left with a single child is replaced by that
+ * child, a sequence or parallel left without children becomes a tau.
+ *
+ * @param node Root of the subtree
+ * @param nextNodeId Id for the next node the pass creates, ids are unique per tree
+ * @return The normalized subtree, possibly a different node
+ */
+std::shared_ptr<TreeNode> normalizeNode(const std::shared_ptr<TreeNode> &node, int &nextNodeId)
+{
+    const Operation operation = node->getOperation();
+    if (operation == ACTIVITY || operation == SILENT_ACTIVITY)
+    {
+        return node;
+    }
+
+    std::vector<std::shared_ptr<TreeNode>> children;
+    children.reserve(node->getChildren().size());
+    for (const auto &child : node->getChildren())
+    {
+        children.push_back(normalizeNode(child, nextNodeId));
+    }
+
+    // loops are neither associative nor do they have a neutral child, only their children are normalized
+    if (operation == REDO_LOOP || operation == XOR_LOOP)
+    {
+        node->setChildren(std::move(children));
+        node->setActivities({});
+        node->fillActivityMaps();
+        if (operation == REDO_LOOP)
+        {
+            node->setLoopHelper(createLoopHelper(node));
+        }
+        return node;
+    }
+
+    std::vector<std::shared_ptr<TreeNode>> flattened;
+    bool hasSilent = false;
+    for (auto &child : children)
+    {
+        if (isSilent(child))
+        {
+            if (operation == XOR && !hasSilent)
+            {
+                flattened.push_back(child);
+            }
+            hasSilent = true;
+        }
+        else if (child->getOperation() == operation)
+        {
+            // already normalized, so its own children are neither of the same operator nor redundant taus
+            for (const auto &grandChild : child->getChildren())
+            {
+                if (isSilent(grandChild) && hasSilent)
+                {
+                    continue;
+                }
+                hasSilent = hasSilent || isSilent(grandChild);
+                flattened.push_back(grandChild);
+            }
+        }
+        else
+        {
+            flattened.push_back(child);
+        }
+    }
+
+    if (flattened.empty())
+    {
+        return std::make_shared<TreeNode>(SILENT_ACTIVITY, nextNodeId++);
+    }
+    if (flattened.size() == 1)
+    {
+        return flattened[0];
+    }
+
+    node->setChildren(std::move(flattened));
+    node->setActivities({});
+    node->fillActivityMaps();
+    return node;
+}
+
+/**
+ * Semantics-preserving rewrite of a parsed tree, so that dynAlign recurses through fewer
+ * operator nodes, memo partitions and alien projections. Nodes are rewritten in place.
+ *
+ * @param root Root returned by parseProcessTreeString
+ * @param stats If given, receives the node counts before and after
+ * @return Root of the normalized tree
+ */
+std::shared_ptr<TreeNode> normalizeTree(const std::shared_ptr<TreeNode> &root, NormalizationStats *stats)
+{
+    const size_t nodesBefore = stats ? countNodes(root) : 0;
+    int nextNodeId = maxNodeId(root) + 1;
+    std::shared_ptr<TreeNode> normalized = normalizeNode(root, nextNodeId);
+    if (stats)
+    {
+        stats->nodesBefore = nodesBefore;
+        stats->nodesAfter = countNodes(normalized);
+    }
+    return normalized;
+}
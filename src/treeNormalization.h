@@ -0,0 +1,18 @@
+#ifndef TREENORMALIZATION_H
+#define TREENORMALIZATION_H
+#include "treeNode.h"
+#include <memory>
+
+struct NormalizationStats
+{
+    size_t nodesBefore = 0;
+    size_t nodesAfter = 0;
+};
+
+size_t countNodes(const std::shared_ptr<TreeNode> &root);
+
+// Rewrites the tree into an equivalent one with fewer operator nodes and returns the new root.
+// Alignment costs do not change, activity ids of the leaves are kept.
+std::shared_ptr<TreeNode> normalizeTree(const std::shared_ptr<TreeNode> &root, NormalizationStats *stats = nullptr);
+
+#endif // TREENORMALIZATION_H
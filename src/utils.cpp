@@ -60,7 +60,7 @@ void printVector(const std::vector<std::string> &vec)
 void printNestedVector(const std::vector<std::shared_ptr<std::vector<std::string>>> &nestedVec)
 {
     std::cout << "[\n";
-    for (const auto vecPtr : nestedVec)
+    for (const auto &vecPtr : nestedVec)
     {
         if (!vecPtr)
         {
@@ -114,7 +114,7 @@ std::string visualizeIntTrace(const std::vector<int> &vec)
     for (size_t i = 0; i < vec.size(); ++i)
     {
         result += "'";
-        result += idToActivity[vec[i]];
+        result += activityLabel(vec[i]);
         result += "'";
         if (i < vec.size() - 1)
         {
@@ -131,7 +131,7 @@ std::string visualizeSpanTrace(const std::span<const int> span)
     for (size_t i = 0; i < span.size(); ++i)
     {
         result += "'";
-        result += idToActivity[span[i]];
+        result += activityLabel(span[i]);
         result += "'";
         if (i < span.size() - 1)
         {
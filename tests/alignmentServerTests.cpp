@@ -0,0 +1,187 @@
+#include "alignmentServer.h"
+#include <catch2/catch_test_macros.hpp>
+#include <filesystem>
+#include <thread>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace
+{
+    void appendUint32(std::string &payload, uint32_t value)
+    {
+        for (int shift = 0; shift < 32; shift += 8)
+        {
+            payload.push_back(static_cast<char>(value >> shift & 0xff));
+        }
+    }
+
+    void appendString(std::string &payload, const std::string &text)
+    {
+        appendUint32(payload, static_cast<uint32_t>(text.size()));
+        payload += text;
+    }
+
+    uint32_t readUint32(const std::string &payload, size_t position)
+    {
+        const auto *bytes = reinterpret_cast<const unsigned char *>(payload.data() + position);
+        return bytes[0] | bytes[1] << 8 | bytes[2] << 16 | static_cast<uint32_t>(bytes[3]) << 24;
+    }
+
+    // A blocking client of one connection, it retries connecting while the server is still binding
+    struct TestClient
+    {
+        int socket = -1;
+
+        explicit TestClient(const std::string &path)
+        {
+            sockaddr_un address{};
+            address.sun_family = AF_UNIX;
+            path.copy(address.sun_path, sizeof(address.sun_path) - 1);
+            for (int attempt = 0; attempt < 500; attempt++)
+            {
+                socket = ::socket(AF_UNIX, SOCK_STREAM, 0);
+                if (connect(socket, reinterpret_cast<sockaddr *>(&address), sizeof(address)) == 0)
+                {
+                    return;
+                }
+                close(socket);
+                socket = -1;
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            }
+            FAIL("cannot connect to " << path);
+        }
+
+        ~TestClient()
+        {
+            if (socket >= 0)
+            {
+                close(socket);
+            }
+        }
+
+        void sendBytes(const std::string &bytes)
+        {
+            REQUIRE(send(socket, bytes.data(), bytes.size(), MSG_NOSIGNAL) == static_cast<ssize_t>(bytes.size()));
+        }
+
+        // the reply payload, empty if the server closed the connection
+        std::string request(const std::string &payload)
+        {
+            std::string frame;
+            appendUint32(frame, static_cast<uint32_t>(payload.size()));
+            sendBytes(frame + payload);
+            std::string header = receive(4);
+            return header.size() == 4 ? receive(readUint32(header, 0)) : std::string();
+        }
+
+        std::string receive(size_t bytes)
+        {
+            std::string data(bytes, '\0');
+            size_t received = 0;
+            while (received < bytes)
+            {
+                const ssize_t count = recv(socket, data.data() + received, bytes - received, 0);
+                if (count <= 0)
+                {
+                    return {};
+                }
+                received += static_cast<size_t>(count);
+            }
+            return data;
+        }
+    };
+
+    std::string loadRequest(const std::string &name, const std::string &tree)
+    {
+        std::string payload(1, static_cast<char>(ServerRequest::LOAD));
+        appendString(payload, name);
+        appendString(payload, tree);
+        payload.push_back(1);
+        return payload;
+    }
+
+    std::string alignRequest(const std::string &name, int budget, const std::vector<std::string> &labels)
+    {
+        std::string payload(1, static_cast<char>(ServerRequest::ALIGN));
+        appendString(payload, name);
+        appendUint32(payload, static_cast<uint32_t>(budget));
+        appendUint32(payload, static_cast<uint32_t>(labels.size()));
+        for (const auto &label : labels)
+        {
+            appendString(payload, label);
+        }
+        return payload;
+    }
+
+    // the message of an error reply
+    std::string errorOf(const std::string &reply)
+    {
+        REQUIRE(reply.size() >= 5);
+        REQUIRE(reply[0] == 1);
+        return reply.substr(5, readUint32(reply, 1));
+    }
+}
+
+TEST_CASE("the server answers its protocol", "[server]")
+{
+    const std::string path = (std::filesystem::temp_directory_path() / ("alignmentServerTests-" + std::to_string(getpid()))).string();
+    ServerOptions options;
+    options.threads = 2;
+    AlignmentServer server(path, options);
+    std::thread serving([&]
+                        { server.run(); });
+
+    {
+        TestClient client(path);
+        CHECK(client.request(loadRequest("model", "->( 'a', X( 'b', 'c' ), 'd' )")) == std::string(1, '\0'));
+
+        const std::string aligned = client.request(alignRequest("model", -1, {"a", "c", "x", "d"}));
+        REQUIRE(aligned.size() == 10);
+        CHECK(aligned[0] == 0);
+        CHECK(readUint32(aligned, 1) == 1);
+        CHECK(readUint32(aligned, 5) == 1);
+        CHECK(aligned[9] == 1);
+
+        // over budget: the cost is not exact, the lower bound is above the budget
+        const std::string budgeted = client.request(alignRequest("model", 0, {"d", "a"}));
+        REQUIRE(budgeted.size() == 10);
+        CHECK(budgeted[9] == 0);
+        CHECK(static_cast<int32_t>(readUint32(budgeted, 5)) > 0);
+
+        CHECK(errorOf(client.request(alignRequest("other", -1, {"a"}))).find("other") != std::string::npos);
+        CHECK(errorOf(client.request(std::string(1, '\x7f'))) == "Unknown request type.");
+
+        // a truncated request and a label count the payload cannot hold are refused, the connection stays usable
+        const std::string full = alignRequest("model", -1, {"a", "b"});
+        CHECK(errorOf(client.request(full.substr(0, full.size() - 3))) == "Truncated request.");
+        std::string huge(1, static_cast<char>(ServerRequest::ALIGN));
+        appendString(huge, "model");
+        appendUint32(huge, static_cast<uint32_t>(-1));
+        appendUint32(huge, 200000000);
+        CHECK(errorOf(client.request(huge)) == "Truncated request.");
+
+        const std::string health = client.request(std::string(1, static_cast<char>(ServerRequest::HEALTH)));
+        REQUIRE(health.size() >= 5);
+        CHECK(health[0] == 0);
+        const std::string metrics = health.substr(5, readUint32(health, 1));
+        CHECK(metrics.find("status ok") != std::string::npos);
+        CHECK(metrics.find("failedRequests 4") != std::string::npos);
+    }
+
+    {
+        // a frame cut off by the client only ends its own connection
+        TestClient truncated(path);
+        std::string frame;
+        appendUint32(frame, 100);
+        truncated.sendBytes(frame + "\x03");
+    }
+
+    TestClient client(path);
+    std::string unload(1, static_cast<char>(ServerRequest::UNLOAD));
+    appendString(unload, "model");
+    CHECK(client.request(unload) == std::string("\0\1", 2));
+    CHECK(client.request(std::string(1, static_cast<char>(ServerRequest::SHUTDOWN))) == std::string(1, '\0'));
+    serving.join();
+    CHECK_FALSE(std::filesystem::exists(path));
+}
@@ -0,0 +1,95 @@
+#include "batchAlignment.h"
+#include "eventLog.h"
+#include "parser.h"
+#include "testTrees.h"
+#include <catch2/catch_test_macros.hpp>
+
+TEST_CASE("both schedules give the reference cost", "[batch][reference]")
+{
+    for (unsigned seed = 0; seed < 20; seed++)
+    {
+        const auto log = randomLog(seed, 40, 3, 10);
+        const auto root = parseProcessTreeString(log.tree);
+        INFO(log.tree);
+        std::vector<int> expected;
+        for (const auto &trace : log.traces)
+        {
+            expected.push_back(referenceCost(root, trace));
+        }
+
+        for (const BatchSchedule schedule : {BatchSchedule::INPUT_ORDER, BatchSchedule::TRIE_ORDER})
+        {
+            for (const unsigned threads : {1u, 3u})
+            {
+                // a memo limit small enough to clear the memos between the variants of a chunk
+                for (const size_t maxMemoEntries : {size_t(0), size_t(40), size_t(2000000)})
+                {
+                    INFO(static_cast<int>(schedule) << " " << threads << " " << maxMemoEntries);
+                    BatchOptions options;
+                    options.threads = threads;
+                    options.schedule = schedule;
+                    options.maxMemoEntries = maxMemoEntries;
+                    BatchStats stats;
+                    const auto results = alignVariants(root, log.traces, options, &stats);
+                    REQUIRE(results.size() == log.traces.size());
+                    for (size_t i = 0; i < results.size(); i++)
+                    {
+                        CHECK(results[i].exact);
+                        CHECK(results[i].cost == expected[i]);
+                    }
+                    CHECK(stats.chunks > 0);
+                    CHECK(stats.memoHitRate() >= 0);
+                    CHECK(stats.memoHitRate() <= 1);
+                }
+            }
+        }
+    }
+}
+
+TEST_CASE("a warm memo is reused across the variants of a trie chunk", "[batch]")
+{
+    const auto root = parseProcessTreeString("->( 'a', *( X( 'b', 'c' ), 'd' ), +( 'e', 'f' ) )");
+    std::vector<std::vector<int>> variants;
+    for (const auto &tail : std::vector<std::vector<std::string>>{{"e", "f"}, {"f", "e"}, {"f"}, {"e", "e", "f"}})
+    {
+        std::vector<std::string> labels = {"a", "b", "d", "c", "d", "b"};
+        labels.insert(labels.end(), tail.begin(), tail.end());
+        variants.push_back(encodeTrace(labels));
+    }
+
+    BatchOptions options;
+    options.threads = 1;
+    options.schedule = BatchSchedule::TRIE_ORDER;
+    BatchStats stats;
+    const auto results = alignVariants(root, variants, options, &stats);
+    for (size_t i = 0; i < variants.size(); i++)
+    {
+        CHECK(results[i].cost == referenceCost(root, variants[i]));
+    }
+    // the shared prefix is aligned once
+    CHECK(stats.memoHits > 0);
+    CHECK(stats.memoEntries > 0);
+}
+
+TEST_CASE("a log gets one result per case", "[batch][reference]")
+{
+    const auto log = randomLog(7, 30, 3, 8);
+    const auto root = parseProcessTreeString(log.tree);
+    INFO(log.tree);
+    const EventLog grouped = groupTraces(log.traces);
+    REQUIRE(grouped.caseIds.size() == log.traces.size());
+
+    BatchOptions options;
+    options.threads = 2;
+    options.countDeviations = true;
+    BatchStats stats;
+    const auto results = alignLog(root, grouped, options, &stats);
+    REQUIRE(results.size() == grouped.caseIds.size());
+    for (size_t i = 0; i < results.size(); i++)
+    {
+        CHECK(results[i].cost == referenceCost(root, log.traces[grouped.caseIds[i]]));
+    }
+    REQUIRE(stats.deviations.size() == 1);
+    // deviations are counted per case, not per variant
+    CHECK(stats.deviations[0].traces + stats.deviations[0].skippedTraces == grouped.caseIds.size());
+}
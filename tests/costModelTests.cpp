@@ -0,0 +1,47 @@
+#include "costModel.h"
+#include "parser.h"
+#include "testTrees.h"
+#include <catch2/catch_test_macros.hpp>
+#include <stdexcept>
+
+TEST_CASE("models with equal weights share their memo keys", "[costModel]")
+{
+    const std::string tree = "->( 'a', X( 'b', *( 'c', tau ) ), 'e' )";
+    const auto root = parseProcessTreeString(tree);
+    const auto reloaded = parseProcessTreeString(tree);
+    const CostModel costs(root, testLogMoveCosts(), testModelMoveCosts());
+    const CostModel sameCosts(reloaded, testLogMoveCosts(), testModelMoveCosts());
+    // a weight of 1 is the default, spelling it out does not change the model
+    auto paddedLogMoveCosts = testLogMoveCosts();
+    paddedLogMoveCosts["f"] = 1;
+    const CostModel paddedCosts(root, paddedLogMoveCosts, testModelMoveCosts());
+    auto otherLogMoveCosts = testLogMoveCosts();
+    otherLogMoveCosts["a"] = 7;
+    const CostModel otherCosts(root, otherLogMoveCosts, testModelMoveCosts());
+
+    std::vector<const TreeNode *> stack = {root.get()};
+    std::vector<const TreeNode *> reloadedStack = {reloaded.get()};
+    while (!stack.empty())
+    {
+        const TreeNode *node = stack.back();
+        const TreeNode *reloadedNode = reloadedStack.back();
+        stack.pop_back();
+        reloadedStack.pop_back();
+        CHECK(costs.memoKey(*node) == sameCosts.memoKey(*reloadedNode));
+        CHECK(costs.memoKey(*node) == paddedCosts.memoKey(*node));
+        CHECK(costs.memoKey(*node) != otherCosts.memoKey(*node));
+        CHECK(costs.memoKey(*node) != node->getMemoKey());
+        for (size_t i = 0; i < node->getChildren().size(); i++)
+        {
+            stack.push_back(node->getChildren()[i].get());
+            reloadedStack.push_back(reloadedNode->getChildren()[i].get());
+        }
+    }
+}
+
+TEST_CASE("move costs have to be positive", "[costModel]")
+{
+    const auto root = parseProcessTreeString("->( 'a', 'b' )");
+    CHECK_THROWS_AS(CostModel(root, {{"a", 0}}, {}), std::invalid_argument);
+    CHECK_THROWS_AS(CostModel(root, {}, {{"b", -2}}), std::invalid_argument);
+}
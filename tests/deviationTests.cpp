@@ -0,0 +1,89 @@
+#include "parser.h"
+#include "testTrees.h"
+#include "treeAlignment.h"
+#include <catch2/catch_test_macros.hpp>
+#include <numeric>
+
+namespace
+{
+    size_t total(const std::vector<size_t> &counters)
+    {
+        return std::accumulate(counters.begin(), counters.end(), size_t(0));
+    }
+
+    // the moves priced by the cost model, nullptr for unit costs
+    long long movesCost(const DeviationCounts &counts, const CostModel *costs)
+    {
+        long long cost = static_cast<long long>(counts.unknownLogMoves) * (costs ? costs->logMove(-1) : 1);
+        for (size_t activity = 0; activity < counts.logMoves.size(); activity++)
+        {
+            cost += static_cast<long long>(counts.logMoves[activity]) * (costs ? costs->logMove(activity) : 1);
+        }
+        for (size_t activity = 0; activity < counts.modelMoves.size(); activity++)
+        {
+            cost += static_cast<long long>(counts.modelMoves[activity]) * (costs ? costs->modelMove(activity) : 1);
+        }
+        return cost;
+    }
+}
+
+TEST_CASE("deviations of a trace are its alignment moves", "[deviations]")
+{
+    const auto root = parseProcessTreeString("->( 'a', X( 'b', 'c' ), 'd' )");
+    const auto positions = preorderPositions(root);
+    const auto trace = encodeTrace({"a", "e", "c"});
+    DeviationCounts counts;
+    costTable.clear();
+    dynAlign(root, trace);
+    REQUIRE(countDeviations(root, trace, positions, 3, counts));
+
+    const int a = trace[0];
+    const int c = trace[2];
+    const int d = encodeTrace({"d"})[0];
+    CHECK(counts.traces == 3);
+    CHECK(counts.skippedTraces == 0);
+    CHECK(counts.syncMoves.at(a) == 3);
+    CHECK(counts.syncMoves.at(c) == 3);
+    CHECK(counts.logMoves.at(trace[1]) == 3);
+    CHECK(counts.modelMoves.at(d) == 3);
+    CHECK(total(counts.logMoves) == 3);
+    CHECK(total(counts.modelMoves) == 3);
+    // the model move goes to the leaf d, the log move of e to the root, whose alphabet lacks it
+    CHECK(counts.nodeModelMoves.at(positions.at(root->getChildren()[2].get())) == 3);
+    CHECK(counts.nodeLogMoves.at(positions.at(root.get())) == 3);
+
+    // events of labels that no tree has are counted apart
+    const std::vector<int> unknown = {a, -1, c, d};
+    dynAlign(root, unknown);
+    REQUIRE(countDeviations(root, unknown, positions, 1, counts));
+    CHECK(counts.unknownLogMoves == 1);
+    CHECK(total(counts.logMoves) == 3);
+    CHECK(counts.traces == 4);
+}
+
+TEST_CASE("deviation counts add up to the alignment cost", "[deviations][reference]")
+{
+    for (unsigned seed = 0; seed < 60; seed++)
+    {
+        const auto log = randomLog(seed, 20);
+        const auto root = parseProcessTreeString(log.tree);
+        const auto positions = preorderPositions(root);
+        const CostModel costs(root, testLogMoveCosts(), testModelMoveCosts());
+        INFO(log.tree);
+        for (const CostModel *model : {static_cast<const CostModel *>(nullptr), &costs})
+        {
+            costTable.clear();
+            for (const auto &trace : log.traces)
+            {
+                DeviationCounts counts;
+                Deadline deadline;
+                alignAnytime(root, trace, deadline, model);
+                REQUIRE(countDeviations(root, trace, positions, 2, counts, model));
+                CHECK(movesCost(counts, model) == 2 * referenceCost(root, trace, model));
+                CHECK(total(counts.syncMoves) + total(counts.logMoves) + counts.unknownLogMoves == 2 * trace.size());
+                CHECK(total(counts.nodeLogMoves) == total(counts.logMoves) + counts.unknownLogMoves);
+                CHECK(total(counts.nodeModelMoves) == total(counts.modelMoves));
+            }
+        }
+    }
+}
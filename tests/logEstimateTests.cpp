@@ -0,0 +1,138 @@
+#include "batchAlignment.h"
+#include "eventLog.h"
+#include "parser.h"
+#include "testTrees.h"
+#include <catch2/catch_test_macros.hpp>
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <stdexcept>
+
+namespace
+{
+    bool near(double value, double expected)
+    {
+        return std::abs(value - expected) <= 1e-9 * std::max(1.0, std::abs(expected));
+    }
+
+    // traces of random labels, so nearly every case is its own variant
+    std::vector<std::vector<int>> scatteredTraces(size_t count)
+    {
+        std::mt19937 random(48);
+        std::vector<std::vector<int>> traces;
+        for (size_t i = 0; i < count; i++)
+        {
+            std::vector<std::string> labels(4 + random() % 6);
+            for (auto &label : labels)
+            {
+                label = std::string(1, "abcdefgh"[random() % 8]);
+            }
+            traces.push_back(encodeTrace(labels));
+        }
+        return traces;
+    }
+}
+
+TEST_CASE("an estimate that draws every variant is the exact mean", "[estimate][reference]")
+{
+    const auto log = randomLog(5, 12);
+    const auto root = parseProcessTreeString(log.tree);
+    INFO(log.tree);
+    const EventLog grouped = groupTraces(log.traces);
+
+    double costSum = 0, fitnessSum = 0;
+    for (const auto &trace : log.traces)
+    {
+        const int cost = referenceCost(root, trace);
+        costSum += cost;
+        const int worstCost = root->getMinModelCost() + static_cast<int>(trace.size());
+        fitnessSum += worstCost == 0 ? 1.0 : 1.0 - static_cast<double>(cost) / worstCost;
+    }
+
+    BatchOptions options;
+    options.threads = 2;
+    EstimateOptions estimate;
+    // widths no sample reaches, only completing the log stops the sampling
+    estimate.fitnessWidth = 1e-12;
+    estimate.minSamples = 100000;
+    estimate.timeBudgetMs = 0;
+    BatchStats stats;
+    const LogEstimate result = estimateLog(root, grouped, options, estimate, &stats);
+    CHECK(result.complete);
+    CHECK(result.converged);
+    CHECK(result.sampledVariants == grouped.variants.size());
+    CHECK(result.inexactSamples == 0);
+    CHECK(near(result.meanCost * log.traces.size(), costSum));
+    CHECK(near(result.costLow, result.meanCost));
+    CHECK(near(result.costHigh, result.meanCost));
+    CHECK(near(result.fitness * log.traces.size(), fitnessSum));
+    CHECK(near(result.fitnessHigh, result.fitness));
+    CHECK(stats.memoHitRate() >= 0);
+
+    const LogEstimate empty = estimateLog(root, groupTraces({}), options, estimate);
+    CHECK(empty.complete);
+    CHECK(empty.samples == 0);
+    CHECK(empty.fitness == 1);
+}
+
+TEST_CASE("an estimate stops at the requested width", "[estimate]")
+{
+    const auto root = parseProcessTreeString(randomLog(2, 1).tree);
+    const auto traces = scatteredTraces(3000);
+    const EventLog grouped = groupTraces(traces);
+    BatchOptions options;
+    options.threads = 1;
+    const auto exact = alignLog(root, grouped, options);
+    double costSum = 0;
+    for (const auto &result : exact)
+    {
+        costSum += result.cost;
+    }
+
+    EstimateOptions estimate;
+    estimate.fitnessWidth = 0;
+    estimate.costWidth = 1;
+    estimate.minSamples = 50;
+    estimate.timeBudgetMs = 0;
+    const LogEstimate result = estimateLog(root, grouped, options, estimate);
+    CHECK(result.converged);
+    CHECK_FALSE(result.complete);
+    CHECK(result.samples >= estimate.minSamples);
+    CHECK(result.samples < traces.size());
+    CHECK(result.costHigh - result.costLow <= estimate.costWidth);
+    CHECK(result.fitnessLow <= result.fitness);
+    CHECK(result.fitness <= result.fitnessHigh);
+    // with this seed the interval covers the mean over all cases
+    CHECK(result.costLow <= costSum / traces.size());
+    CHECK(costSum / traces.size() <= result.costHigh);
+
+    // without a time budget the stopping point only depends on the seed, not on the threads
+    options.threads = 4;
+    const LogEstimate parallel = estimateLog(root, grouped, options, estimate);
+    CHECK(parallel.samples == result.samples);
+    CHECK(parallel.meanCost == result.meanCost);
+}
+
+TEST_CASE("an estimate refuses stopping rules it cannot meet", "[estimate]")
+{
+    const auto root = parseProcessTreeString("->( 'a', 'b' )");
+    const EventLog grouped = groupTraces({encodeTrace({"a", "b"})});
+    const BatchOptions options;
+
+    EstimateOptions estimate;
+    for (const double confidence : {0.0, 1.0, -0.5, 1.5})
+    {
+        estimate.confidence = confidence;
+        CHECK_THROWS_AS(estimateLog(root, grouped, options, estimate), std::invalid_argument);
+    }
+
+    estimate = EstimateOptions();
+    estimate.fitnessWidth = 0;
+    estimate.costWidth = 0;
+    estimate.timeBudgetMs = 0;
+    CHECK_THROWS_AS(estimateLog(root, grouped, options, estimate), std::invalid_argument);
+
+    BatchOptions twoModels;
+    twoModels.costs = {std::make_shared<const CostModel>(root, testLogMoveCosts(), testModelMoveCosts()), nullptr};
+    CHECK_THROWS_AS(estimateLog(root, grouped, twoModels, EstimateOptions()), std::invalid_argument);
+}
@@ -0,0 +1,55 @@
+#include "longTraceAlignment.h"
+#include "parser.h"
+#include "testTrees.h"
+#include <catch2/catch_test_macros.hpp>
+
+TEST_CASE("a sequence of distinct alphabets splits exactly", "[longTrace]")
+{
+    const auto root = parseProcessTreeString("->( *( 'a', 'b' ), +( 'c', 'd' ), *( 'e', tau ) )");
+    std::vector<std::string> labels;
+    for (int i = 0; i < 100; i++)
+    {
+        labels.insert(labels.end(), {"a", "b"});
+    }
+    // the second c is the only deviation
+    labels.insert(labels.end(), {"a", "d", "c", "c"});
+    labels.insert(labels.end(), 200, "e");
+    const auto trace = encodeTrace(labels);
+
+    Deadline deadline;
+    const AlignmentResult result = alignLongTrace(root, trace, 16, deadline);
+    CHECK(result.exact);
+    CHECK(result.cost == 1);
+    CHECK(result.lowerBound == 1);
+}
+
+TEST_CASE("long trace bounds contain the exact cost", "[longTrace]")
+{
+    for (unsigned seed = 0; seed < 40; seed++)
+    {
+        // a loop around the random tree, so that several of its runs make up one long trace
+        const auto log = randomLog(seed, 8, 3, 10);
+        const auto root = parseProcessTreeString("*( " + log.tree + ", tau )");
+        std::vector<int> trace;
+        for (const auto &run : log.traces)
+        {
+            trace.insert(trace.end(), run.begin(), run.end());
+        }
+        INFO(log.tree);
+        costTable.clear();
+        const int exact = dynAlign(root, trace);
+
+        for (const size_t window : {4, 16, 64})
+        {
+            INFO(window);
+            Deadline deadline;
+            const AlignmentResult result = alignLongTrace(root, trace, window, deadline);
+            CHECK(result.lowerBound <= exact);
+            CHECK(exact <= result.cost);
+            if (result.exact)
+            {
+                CHECK(result.cost == exact);
+            }
+        }
+    }
+}
@@ -0,0 +1,115 @@
+#include "batchAlignment.h"
+#include "memoPolicy.h"
+#include "parser.h"
+#include "testTrees.h"
+#include "treeAlignment.h"
+#include <catch2/catch_test_macros.hpp>
+#include <random>
+#include <set>
+#include <thread>
+
+namespace
+{
+    // a generic root over a choice the static rules skip
+    const std::string policyTree = "->( X( ->( 'a', 'b' ), *( 'c', tau ) ), +( 'd', ->( 'e', 'f' ) ), *( 'g', 'a' ) )";
+
+    // distinct traces, so the memo keys near the root never hit
+    std::vector<std::vector<int>> distinctTraces(size_t count)
+    {
+        std::mt19937 random(49);
+        std::set<std::vector<std::string>> traces;
+        while (traces.size() < count)
+        {
+            std::vector<std::string> labels(3 + random() % 6);
+            for (auto &label : labels)
+            {
+                label = std::string(1, "abcdefg"[random() % 7]);
+            }
+            traces.insert(labels);
+        }
+        std::vector<std::vector<int>> encoded;
+        for (const auto &labels : traces)
+        {
+            encoded.push_back(encodeTrace(labels));
+        }
+        return encoded;
+    }
+}
+
+TEST_CASE("every memo policy gives the reference cost", "[memoPolicy][reference]")
+{
+    for (const MemoPolicy policy : {MemoPolicy::ALWAYS, MemoPolicy::STATIC, MemoPolicy::ADAPTIVE})
+    {
+        const MemoPolicyScope scope(policy);
+        INFO(static_cast<int>(policy));
+        // the memo is kept across the logs, so the adaptive policy sees enough lookups to switch keys off
+        costTable.clear();
+        for (unsigned seed = 0; seed < 60; seed++)
+        {
+            const auto log = randomLog(seed, 20);
+            const auto root = parseProcessTreeString(log.tree);
+            const CostModel costs(root, testLogMoveCosts(), testModelMoveCosts());
+            INFO(log.tree);
+            for (const auto &trace : log.traces)
+            {
+                CHECK(dynAlign(root, trace) == referenceCost(root, trace));
+                Deadline deadline;
+                CHECK(alignAnytime(root, trace, deadline, &costs).cost == referenceCost(root, trace, &costs));
+            }
+        }
+    }
+}
+
+TEST_CASE("the policies skip what they promise to", "[memoPolicy][reference]")
+{
+    const auto root = parseProcessTreeString(policyTree);
+    const auto traces = distinctTraces(800);
+    std::vector<int> expected;
+    for (const auto &trace : traces)
+    {
+        expected.push_back(referenceCost(root, trace));
+    }
+
+    for (const MemoPolicy policy : {MemoPolicy::ALWAYS, MemoPolicy::STATIC, MemoPolicy::ADAPTIVE})
+    {
+        const MemoPolicyScope scope(policy);
+        INFO(static_cast<int>(policy));
+        costTable.clear();
+        memoPolicyStats = MemoPolicyStats{};
+        for (size_t i = 0; i < traces.size(); i++)
+        {
+            CHECK(dynAlign(root, traces[i]) == expected[i]);
+        }
+        CHECK((memoPolicyStats.staticSkips > 0) == (policy != MemoPolicy::ALWAYS));
+        // keys without a hit in a measuring window are switched off
+        CHECK((memoPolicyStats.switchedOff > 0) == (policy == MemoPolicy::ADAPTIVE));
+        CHECK((memoPolicyStats.adaptiveSkips > 0) == (policy == MemoPolicy::ADAPTIVE));
+    }
+}
+
+TEST_CASE("batch statistics report the policy", "[memoPolicy][batch]")
+{
+    const auto root = parseProcessTreeString(policyTree);
+    const auto traces = distinctTraces(800);
+
+    for (const MemoPolicy policy : {MemoPolicy::ALWAYS, MemoPolicy::STATIC, MemoPolicy::ADAPTIVE})
+    {
+        BatchOptions options;
+        options.threads = 1;
+        options.memoPolicy = policy;
+        BatchStats stats;
+        std::vector<AlignmentResult> results;
+        // the adaptive policy measures per thread, a new one has none of the keys switched off that the tests above did
+        std::thread([&]
+                    { results = alignVariants(root, traces, options, &stats); })
+            .join();
+        INFO(static_cast<int>(policy));
+        REQUIRE(results.size() == traces.size());
+        for (size_t i = 0; i < traces.size(); i++)
+        {
+            CHECK(results[i].cost == referenceCost(root, traces[i]));
+        }
+        CHECK((stats.memoSkips > 0) == (policy != MemoPolicy::ALWAYS));
+        CHECK((stats.memoSwitchedOff > 0) == (policy == MemoPolicy::ADAPTIVE));
+    }
+}
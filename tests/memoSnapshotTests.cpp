@@ -0,0 +1,96 @@
+#include "memoSnapshot.h"
+#include "parser.h"
+#include "testTrees.h"
+#include "treeAlignment.h"
+#include <catch2/catch_test_macros.hpp>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+
+namespace
+{
+    std::string snapshotPath(const std::string &name)
+    {
+        return (std::filesystem::temp_directory_path() / ("memoSnapshotTests-" + name + ".bin")).string();
+    }
+
+    std::vector<int> costsWithSnapshot(const std::shared_ptr<TreeNode> &root, const std::vector<std::vector<int>> &traces,
+                                       const MemoSnapshot *snapshot)
+    {
+        const MemoSnapshotScope scope(snapshot);
+        costTable.clear();
+        std::vector<int> costs;
+        for (const auto &trace : traces)
+        {
+            costs.push_back(dynAlign(root, trace));
+        }
+        return costs;
+    }
+}
+
+TEST_CASE("a snapshot answers the subproblems of the next run", "[snapshot]")
+{
+    const auto log = randomLog(47, 40, 4, 12);
+    const auto root = parseProcessTreeString(log.tree);
+    const std::string path = snapshotPath("roundTrip");
+    const auto expected = costsWithSnapshot(root, log.traces, nullptr);
+    writeMemoSnapshot(path, {root}, {&costTable});
+
+    // a tree parsed again gets other memo keys, the snapshot goes by the positions of the subtrees
+    const auto reparsed = parseProcessTreeString(log.tree);
+    const auto snapshot = openMemoSnapshot(path, {reparsed});
+    REQUIRE(snapshot != nullptr);
+    CHECK(snapshot->entries() > 0);
+    memoStats = MemoStats{};
+    CHECK(costsWithSnapshot(reparsed, log.traces, snapshot.get()) == expected);
+    CHECK(memoStats.hits > 0);
+
+    // written again on top of the snapshot it was opened from, nothing is lost
+    const std::string next = snapshotPath("merged");
+    costTable.clear();
+    writeMemoSnapshot(next, {reparsed}, {&costTable}, snapshot.get());
+    const auto merged = openMemoSnapshot(next, {reparsed});
+    REQUIRE(merged != nullptr);
+    CHECK(merged->entries() == snapshot->entries());
+    std::filesystem::remove(path);
+    std::filesystem::remove(next);
+}
+
+TEST_CASE("a snapshot of other trees is rejected", "[snapshot]")
+{
+    const auto root = parseProcessTreeString("->( 'a', X( 'b', 'c' ) )");
+    const std::string path = snapshotPath("otherTree");
+    costsWithSnapshot(root, {encodeTrace({"a", "c"})}, nullptr);
+    writeMemoSnapshot(path, {root}, {&costTable});
+
+    CHECK(openMemoSnapshot(path, {parseProcessTreeString("->( 'a', X( 'c', 'b' ) )")}) == nullptr);
+    CHECK(openMemoSnapshot(path, {root, root}) == nullptr);
+    CHECK(openMemoSnapshot(snapshotPath("missing"), {root}) == nullptr);
+    std::filesystem::remove(path);
+}
+
+TEST_CASE("a damaged snapshot never gives a wrong cost", "[snapshot]")
+{
+    const auto log = randomLog(7, 20, 3, 8);
+    const auto root = parseProcessTreeString(log.tree);
+    const std::string path = snapshotPath("damaged");
+    const auto expected = costsWithSnapshot(root, log.traces, nullptr);
+    writeMemoSnapshot(path, {root}, {&costTable});
+    std::string bytes;
+    {
+        std::ifstream in(path, std::ios::binary);
+        bytes.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    }
+    REQUIRE(!bytes.empty());
+
+    for (size_t position = 0; position < bytes.size(); position += 1 + bytes.size() / 200)
+    {
+        std::string damaged = bytes;
+        damaged[position] ^= 0x10;
+        std::ofstream(path, std::ios::binary | std::ios::trunc) << damaged;
+        INFO(position);
+        const auto snapshot = openMemoSnapshot(path, {root});
+        CHECK(costsWithSnapshot(root, log.traces, snapshot.get()) == expected);
+    }
+    std::filesystem::remove(path);
+}
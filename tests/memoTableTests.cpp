@@ -0,0 +1,78 @@
+#include "memoTable.h"
+#include <catch2/catch_test_macros.hpp>
+#include <map>
+#include <random>
+
+namespace
+{
+    // Fills the table with random traces, some sharing prefixes and some costs too wide for 16 bits, and checks
+    // every lookup, the visit of every entry and a clear against a std::map
+    template <typename Table>
+    void checkTable()
+    {
+        std::mt19937 random(37);
+        Table table;
+        std::map<std::vector<int>, int> expected;
+        for (int i = 0; i < 5000; i++)
+        {
+            std::vector<int> trace;
+            if (!expected.empty() && random() % 3 == 0)
+            {
+                // an entry that is a prefix or an extension of an earlier one
+                trace = std::next(expected.begin(), random() % expected.size())->first;
+                trace.resize(random() % (trace.size() + 3), static_cast<int>(random() % 5));
+            }
+            else
+            {
+                trace.resize(random() % 30);
+                for (int &event : trace)
+                {
+                    // -1 is the id of labels no tree has, large ids take several varint bytes
+                    event = static_cast<int>(random() % 400) - 1;
+                }
+            }
+            const int cost = random() % 10 == 0 ? 65535 + static_cast<int>(random() % 100000) : static_cast<int>(random() % 70);
+            if (expected.count(trace) != 0)
+            {
+                continue;
+            }
+            const HashedTrace hashed(trace);
+            REQUIRE(table.find(hashed.view()) == -1);
+            table.insert(hashed.view(), cost);
+            expected[trace] = cost;
+        }
+        CHECK(table.size() == expected.size());
+        CHECK(table.memoryBytes() > 0);
+
+        for (const auto &[trace, cost] : expected)
+        {
+            const HashedTrace hashed(trace);
+            CHECK(table.find(hashed.view()) == cost);
+            // a subtrace view of a longer trace has the same key
+            std::vector<int> padded = {7};
+            padded.insert(padded.end(), trace.begin(), trace.end());
+            const HashedTrace paddedHash(padded);
+            CHECK(table.find(paddedHash.view().subspan(1, trace.size())) == cost);
+        }
+
+        std::map<std::vector<int>, int> visited;
+        table.forEach([&](std::span<const int> trace, int cost)
+                      { visited[std::vector<int>(trace.begin(), trace.end())] = cost; });
+        CHECK(visited == expected);
+
+        table.clear();
+        CHECK(table.size() == 0);
+        const HashedTrace first(expected.begin()->first);
+        CHECK(table.find(first.view()) == -1);
+    }
+}
+
+TEST_CASE("the hash memo keeps every entry", "[memo]")
+{
+    checkTable<HashMemoTable>();
+}
+
+TEST_CASE("the compact memo keeps every entry", "[memo]")
+{
+    checkTable<CompactMemoTable>();
+}
@@ -0,0 +1,99 @@
+#include "batchAlignment.h"
+#include "modelRegistry.h"
+#include "parser.h"
+#include "testTrees.h"
+#include <catch2/catch_test_macros.hpp>
+#include <stdexcept>
+
+TEST_CASE("the registry loads, replaces and unloads models", "[registry]")
+{
+    ModelRegistry registry;
+    const auto first = registry.load("first", "->( 'a', ->( 'b', 'c' ), tau )");
+    registry.load("second", "X( 'a', 'd' )", false);
+    CHECK(first->normalization.nodesAfter < first->normalization.nodesBefore);
+    REQUIRE(registry.models().size() == 2);
+    CHECK(registry.models()[0]->name == "first");
+    CHECK(registry.find("second")->root->getChildren().size() == 2);
+    CHECK(registry.find("third") == nullptr);
+
+    // a replaced model keeps its place, alignments holding the old one keep it alive
+    const auto replaced = registry.load("first", "->( 'a', 'd' )");
+    REQUIRE(registry.models().size() == 2);
+    CHECK(registry.models()[0] == replaced);
+    CHECK(first->root->getChildren().size() == 3);
+
+    CHECK(registry.unload("first"));
+    CHECK_FALSE(registry.unload("first"));
+    REQUIRE(registry.models().size() == 1);
+    CHECK(registry.models()[0]->name == "second");
+    CHECK_THROWS(registry.load("broken", "->( 'a', "));
+    CHECK(registry.models().size() == 1);
+}
+
+TEST_CASE("a log aligned against several models gives each model's reference cost", "[registry][reference]")
+{
+    ModelRegistry registry;
+    std::vector<std::string> trees;
+    for (unsigned seed = 0; seed < 4; seed++)
+    {
+        trees.push_back(randomLog(seed, 1).tree);
+        registry.load("model" + std::to_string(seed), trees.back());
+    }
+    // the traces of one model are deviating runs of the others
+    const auto log = randomLog(11, 40, 3, 8);
+    const EventLog grouped = groupTraces(log.traces);
+
+    for (const BatchSchedule schedule : {BatchSchedule::INPUT_ORDER, BatchSchedule::TRIE_ORDER})
+    {
+        BatchOptions options;
+        options.threads = 3;
+        options.schedule = schedule;
+        std::vector<std::shared_ptr<const ProcessModel>> models;
+        const auto results = registry.alignLog(grouped, options, &models);
+        REQUIRE(models.size() == trees.size());
+        REQUIRE(results.size() == trees.size());
+        for (size_t model = 0; model < models.size(); model++)
+        {
+            INFO(trees[model]);
+            REQUIRE(results[model].size() == grouped.caseIds.size());
+            for (size_t i = 0; i < grouped.caseIds.size(); i++)
+            {
+                CHECK(results[model][i].cost == referenceCost(models[model]->root, log.traces[grouped.caseIds[i]]));
+            }
+        }
+    }
+}
+
+TEST_CASE("models sharing the workers' memo keep their own costs", "[registry][reference]")
+{
+    // the same tree three times, the middle one weighted, so only the memo keys tell them apart
+    const std::string tree = "->( 'a', X( 'b', *( 'c', tau ) ), +( 'd', 'e' ) )";
+    const std::vector<std::shared_ptr<TreeNode>> roots = {parseProcessTreeString(tree), parseProcessTreeString(tree),
+                                                          parseProcessTreeString(tree)};
+    const auto weighted = std::make_shared<const CostModel>(roots[1], testLogMoveCosts(), testModelMoveCosts());
+    std::vector<std::vector<int>> traces;
+    for (const auto &labels : std::vector<std::vector<std::string>>{
+             {"a", "b", "d", "e"}, {"a", "c", "c", "e", "d"}, {"b", "a", "x", "e"}, {"a"}, {"e", "d", "c", "b", "a"}, {}})
+    {
+        traces.push_back(encodeTrace(labels));
+    }
+    const EventLog grouped = groupTraces(traces);
+
+    BatchOptions options;
+    options.threads = 1;
+    options.costs = {nullptr, weighted, nullptr};
+    const auto results = alignLogAgainst(roots, grouped, options);
+    REQUIRE(results.size() == roots.size());
+    bool weightsMatter = false;
+    for (size_t i = 0; i < traces.size(); i++)
+    {
+        CHECK(results[0][i].cost == referenceCost(roots[0], traces[i]));
+        CHECK(results[1][i].cost == referenceCost(roots[1], traces[i], weighted.get()));
+        CHECK(results[2][i].cost == results[0][i].cost);
+        weightsMatter |= results[1][i].cost != results[0][i].cost;
+    }
+    CHECK(weightsMatter);
+
+    options.costs = {weighted};
+    CHECK_THROWS_AS(alignLogAgainst(roots, grouped, options), std::invalid_argument);
+}
@@ -0,0 +1,157 @@
+#include "parser.h"
+#include "testTrees.h"
+#include "treeAlignment.h"
+#include <catch2/catch_test_macros.hpp>
+#include <random>
+
+namespace
+{
+    // every trace over a to f of up to length events, in order of length
+    std::vector<std::vector<int>> allTraces(size_t length)
+    {
+        std::vector<std::vector<int>> traces = {{}};
+        for (size_t begin = 0; traces[begin].size() < length; begin++)
+        {
+            for (const char label : std::string("abcdef"))
+            {
+                auto trace = traces[begin];
+                trace.push_back(encodeTrace({std::string(1, label)})[0]);
+                traces.push_back(trace);
+            }
+        }
+        return traces;
+    }
+
+    void checkShape(const std::string &tree, NodeShape shape)
+    {
+        const auto root = parseProcessTreeString(tree);
+        const CostModel costs(root, testLogMoveCosts(), testModelMoveCosts());
+        INFO(tree);
+        REQUIRE(root->getShape() == shape);
+        costTable.clear();
+        for (const auto &trace : allTraces(4))
+        {
+            CHECK(dynAlign(root, trace) == referenceCost(root, trace));
+            Deadline deadline;
+            CHECK(alignAnytime(root, trace, deadline, &costs).cost == referenceCost(root, trace, &costs));
+        }
+    }
+
+    // Cost of aligning a trace with a single run by the quadratic edit DP, matches only join equal activities
+    int runCost(const std::vector<int> &run, const std::vector<int> &trace, const CostModel *costs)
+    {
+        const auto logMove = [&](int activity)
+        { return costs ? costs->logMove(activity) : 1; };
+        const auto modelMove = [&](int activity)
+        { return costs ? costs->modelMove(activity) : 1; };
+        std::vector<int> row(run.size() + 1, 0);
+        for (size_t j = 0; j < run.size(); j++)
+        {
+            row[j + 1] = row[j] + modelMove(run[j]);
+        }
+        for (const int event : trace)
+        {
+            std::vector<int> next(run.size() + 1);
+            next[0] = row[0] + logMove(event);
+            for (size_t j = 0; j < run.size(); j++)
+            {
+                next[j + 1] = std::min(row[j + 1] + logMove(event), next[j] + modelMove(run[j]));
+                if (run[j] == event)
+                {
+                    next[j + 1] = std::min(next[j + 1], row[j]);
+                }
+            }
+            row = std::move(next);
+        }
+        return row.back();
+    }
+}
+
+TEST_CASE("closed form shapes match the reference", "[shape][reference]")
+{
+    checkShape("X( 'a', 'b', 'c' )", NodeShape::LEAF_CHOICE);
+    checkShape("X( tau, 'a' )", NodeShape::LEAF_CHOICE);
+    checkShape("X( 'b', tau, 'e', 'b' )", NodeShape::LEAF_CHOICE);
+    checkShape("+( 'a', 'b', 'c' )", NodeShape::LEAF_PARALLEL);
+    checkShape("+( 'a', tau, 'd' )", NodeShape::LEAF_PARALLEL);
+    checkShape("+( 'a', 'b', 'a' )", NodeShape::LEAF_PARALLEL);
+    checkShape("->( 'a', 'b', 'c' )", NodeShape::LEAF_SEQUENCE);
+    checkShape("->( 'e', 'a', 'd', 'b' )", NodeShape::LEAF_SEQUENCE);
+    checkShape("*( 'a', tau )", NodeShape::LEAF_LOOP);
+    checkShape("*( tau, 'c' )", NodeShape::SKIPPABLE_LEAF_LOOP);
+}
+
+TEST_CASE("closed form shapes inside larger trees", "[shape][reference]")
+{
+    for (const std::string tree : {"->( X( tau, 'a' ), +( 'b', 'c' ), *( 'd', tau ) )", "*( ->( 'a', 'b' ), X( 'c', 'd' ) )",
+                                   "+( *( tau, 'a' ), ->( 'b', 'c', 'd' ) )"})
+    {
+        const auto root = parseProcessTreeString(tree);
+        INFO(tree);
+        costTable.clear();
+        for (const auto &trace : allTraces(4))
+        {
+            CHECK(dynAlign(root, trace) == referenceCost(root, trace));
+        }
+    }
+}
+
+TEST_CASE("long chains of distinct leaves match the edit distance", "[shape][sequence]")
+{
+    std::mt19937 random(35);
+    // one word, a full word, and chains whose LCS carries across words
+    for (const size_t length : {20, 64, 65, 130, 200})
+    {
+        std::string tree = "->( ";
+        std::vector<std::string> labels;
+        std::unordered_map<std::string, int> logMoveCosts;
+        std::unordered_map<std::string, int> modelMoveCosts;
+        for (size_t i = 0; i < length + 10; i++)
+        {
+            labels.push_back("chain" + std::to_string(i));
+            logMoveCosts[labels.back()] = 1 + i % 3;
+            modelMoveCosts[labels.back()] = 1 + i % 4;
+        }
+        for (size_t i = 0; i < length; i++)
+        {
+            tree += (i > 0 ? ", '" : "'") + labels[i] + "'";
+        }
+        const auto root = parseProcessTreeString(tree + " )");
+        const CostModel costs(root, logMoveCosts, modelMoveCosts);
+        REQUIRE(root->getShape() == NodeShape::LEAF_SEQUENCE);
+        const auto run = encodeTrace(std::vector<std::string>(labels.begin(), labels.begin() + length));
+        INFO(length);
+
+        for (int i = 0; i < 20; i++)
+        {
+            // mostly the chain in order with events left out, the last labels are in no leaf
+            std::vector<std::string> events;
+            for (size_t position = 0; position < length; position++)
+            {
+                if (random() % 4 != 0)
+                {
+                    events.push_back(labels[random() % 8 == 0 ? random() % labels.size() : position]);
+                }
+            }
+            const auto trace = encodeTrace(events);
+            costTable.clear();
+            CHECK(dynAlign(root, trace) == runCost(run, trace, nullptr));
+            Deadline deadline;
+            CHECK(alignAnytime(root, trace, deadline, &costs).cost == runCost(run, trace, &costs));
+        }
+    }
+}
+
+TEST_CASE("chains with a repeated leaf match the reference", "[shape][reference]")
+{
+    for (const std::string tree : {"->( 'a', 'b', 'a' )", "->( 'c', 'a', 'c', 'c' )"})
+    {
+        const auto root = parseProcessTreeString(tree);
+        INFO(tree);
+        costTable.clear();
+        for (const auto &trace : allTraces(4))
+        {
+            CHECK(dynAlign(root, trace) == referenceCost(root, trace));
+        }
+    }
+}
@@ -0,0 +1,87 @@
+#include "onlineAlignment.h"
+#include "parser.h"
+#include "testTrees.h"
+#include <catch2/catch_test_macros.hpp>
+#include <stdexcept>
+#include <thread>
+
+TEST_CASE("every prefix of a running case costs what the reference says", "[online][reference]")
+{
+    for (const size_t maxMemoEntries : {size_t(0), size_t(16)})
+    {
+        INFO(maxMemoEntries);
+        size_t hits = 0;
+        for (unsigned seed = 0; seed < 30; seed++)
+        {
+            const auto log = randomLog(seed, 6, 3, 10);
+            const auto root = parseProcessTreeString(log.tree);
+            OnlineAligner aligner(root, maxMemoEntries, std::chrono::milliseconds(0), 0);
+            INFO(log.tree);
+            std::vector<int64_t> caseIds;
+            for (size_t i = 0; i < log.traces.size(); i++)
+            {
+                caseIds.push_back(aligner.openCase());
+            }
+
+            // the cases take turns, so every case resumes with the memo it left behind
+            for (size_t length = 1; length <= 10; length++)
+            {
+                for (size_t i = 0; i < log.traces.size(); i++)
+                {
+                    const auto &trace = log.traces[i];
+                    if (length > trace.size())
+                    {
+                        continue;
+                    }
+                    aligner.appendEvent(caseIds[i], trace[length - 1]);
+                    memoStats = MemoStats{};
+                    const AlignmentResult result = aligner.currentCost(caseIds[i]);
+                    hits += memoStats.hits;
+                    CHECK(result.exact);
+                    CHECK(result.cost == referenceCost(root, std::vector<int>(trace.begin(), trace.begin() + length)));
+                    // asking again is answered without aligning
+                    CHECK(aligner.currentCost(caseIds[i]).cost == result.cost);
+                    if (maxMemoEntries > 0)
+                    {
+                        CHECK(aligner.memoEntries(caseIds[i]) <= maxMemoEntries);
+                    }
+                }
+            }
+            CHECK(aligner.openCases() == log.traces.size());
+        }
+        // the subproblems of earlier prefixes are reused, also after trimming
+        CHECK(hits > 0);
+    }
+}
+
+TEST_CASE("idle and closed cases are dropped", "[online]")
+{
+    const auto root = parseProcessTreeString("->( 'a', *( 'b', 'c' ), 'd' )");
+    const auto events = encodeTrace({"a", "b", "d"});
+    OnlineAligner aligner(root, 0, std::chrono::milliseconds(50), 0);
+    const int64_t idle = aligner.openCase();
+    const int64_t busy = aligner.openCase();
+    const int64_t closed = aligner.openCase();
+    aligner.appendEvent(idle, events[0]);
+    aligner.closeCase(closed);
+    CHECK(aligner.openCases() == 2);
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(80));
+    aligner.appendEvent(busy, events[0]);
+    CHECK(aligner.evictIdleCases() == 1);
+    CHECK(aligner.openCases() == 1);
+    CHECK(aligner.currentCost(busy).cost == referenceCost(root, {events[0]}));
+    CHECK(aligner.memoEntries(idle) == 0);
+
+    CHECK_THROWS_AS(aligner.currentCost(idle), std::out_of_range);
+    CHECK_THROWS_AS(aligner.appendEvent(closed, events[1]), std::out_of_range);
+    CHECK_THROWS_AS(aligner.currentCost(busy + 100), std::out_of_range);
+
+    // opening a case sweeps the cases that went idle since the last sweep
+    std::this_thread::sleep_for(std::chrono::milliseconds(80));
+    const int64_t next = aligner.openCase();
+    CHECK(aligner.openCases() == 1);
+    CHECK_THROWS_AS(aligner.currentCost(busy), std::out_of_range);
+    aligner.closeCase(next);
+    CHECK(aligner.openCases() == 0);
+}
@@ -0,0 +1,39 @@
+#include "parser.h"
+#include "perfectFit.h"
+#include "testTrees.h"
+#include "treeAlignment.h"
+#include <catch2/catch_test_macros.hpp>
+
+TEST_CASE("nested loops fit their runs", "[perfectFit]")
+{
+    const auto root = parseProcessTreeString("*( ->( 'a', *( 'b', 'c' ) ), X( 'd', tau ) )");
+
+    for (const std::vector<std::string> &labels : std::vector<std::vector<std::string>>{
+             {"a", "b"}, {"a", "b", "c", "b"}, {"a", "b", "a", "b"}, {"a", "b", "c", "b", "d", "a", "b"}})
+    {
+        INFO(labels.size());
+        CHECK(fitsPerfectly(*root, encodeTrace(labels)));
+    }
+    for (const std::vector<std::string> &labels : std::vector<std::vector<std::string>>{
+             {}, {"a"}, {"a", "b", "c"}, {"a", "b", "d"}, {"b", "a"}, {"a", "b", "d", "d", "a", "b"}, {"a", "b", "x"}})
+    {
+        INFO(labels.size());
+        CHECK_FALSE(fitsPerfectly(*root, encodeTrace(labels)));
+    }
+}
+
+TEST_CASE("fitsPerfectly agrees with a zero alignment cost", "[perfectFit]")
+{
+    for (unsigned seed = 0; seed < 100; seed++)
+    {
+        const auto log = randomLog(seed, 20, 4, 12);
+        const auto root = parseProcessTreeString(log.tree);
+        INFO(log.tree);
+        costTable.clear();
+        // the parser gives every leaf an activity of its own, so no fitting trace may be missed
+        for (const auto &trace : log.traces)
+        {
+            CHECK(fitsPerfectly(*root, trace) == (dynAlign(root, trace) == 0));
+        }
+    }
+}
@@ -0,0 +1,141 @@
+#include "parser.h"
+#include "shardedAlignment.h"
+#include "testTrees.h"
+#include <catch2/catch_test_macros.hpp>
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <unistd.h>
+
+namespace
+{
+    // a directory of its own, removed with everything in it at the end of the test
+    struct TemporaryDirectory
+    {
+        std::filesystem::path path;
+
+        TemporaryDirectory()
+            : path(std::filesystem::temp_directory_path() / ("shardedAlignmentTests-" + std::to_string(getpid())))
+        {
+            std::filesystem::create_directories(path);
+        }
+
+        ~TemporaryDirectory()
+        {
+            std::filesystem::remove_all(path);
+        }
+
+        std::string file(const std::string &name) const
+        {
+            return (path / name).string();
+        }
+    };
+
+    std::string readFile(const std::string &path)
+    {
+        std::ifstream input(path);
+        std::ostringstream content;
+        content << input.rdbuf();
+        return content.str();
+    }
+
+    // the merged output file of the partials
+    std::string mergedOutput(const std::vector<PartialResult> &partials, const std::string &path)
+    {
+        writeMergedResult(mergePartialResults(partials), path);
+        return readFile(path);
+    }
+}
+
+TEST_CASE("sharded runs merge into the output of a single run", "[sharded][reference]")
+{
+    const TemporaryDirectory directory;
+    const auto log = randomLog(41, 60, 3, 8);
+    const auto root = parseProcessTreeString(log.tree);
+    INFO(log.tree);
+
+    // the trace file format of the command line, one case per line
+    const std::string traceFile = directory.file("traces.tsv");
+    {
+        std::ofstream output(traceFile);
+        for (size_t i = 0; i < log.traces.size(); i++)
+        {
+            output << "case " << i;
+            for (const int activity : log.traces[i])
+            {
+                output << "\t" << activityLabel(activity);
+            }
+            output << "\n";
+        }
+    }
+    const TraceFile file = readTraceFile(traceFile);
+    REQUIRE(file.traces.size() == log.traces.size());
+
+    BatchOptions options;
+    options.threads = 2;
+    const PartialResult single = alignShard(log.tree, file, 0, 1, options);
+    REQUIRE(single.cases.size() == log.traces.size());
+    for (const auto &row : single.cases)
+    {
+        CHECK(row.caseName == "case " + std::to_string(row.index));
+        CHECK(row.result.cost == referenceCost(root, log.traces[row.index]));
+    }
+    const std::string expected = mergedOutput({single}, directory.file("single.tsv"));
+
+    // every shard goes through its file, as it does between worker processes
+    std::vector<PartialResult> partials;
+    for (size_t shard = 0; shard < 3; shard++)
+    {
+        const PartialResult partial = alignShard(log.tree, file, shard, 3, options);
+        const std::string path = partialResultPath(directory.file("merged.tsv"), shard, 3);
+        writePartialResult(partial, path);
+        const PartialResult read = readPartialResult(path);
+        CHECK(read.model == partial.model);
+        CHECK(read.shard == shard);
+        CHECK(read.shards == 3);
+        CHECK(read.stats.cases == partial.stats.cases);
+        CHECK(read.stats.totalCost == partial.stats.totalCost);
+        CHECK(read.stats.millis == partial.stats.millis);
+        REQUIRE(read.cases.size() == partial.cases.size());
+        for (size_t i = 0; i < read.cases.size(); i++)
+        {
+            CHECK(read.cases[i].index == partial.cases[i].index);
+            CHECK(read.cases[i].caseName == partial.cases[i].caseName);
+            CHECK(read.cases[i].result.cost == partial.cases[i].result.cost);
+            CHECK(read.cases[i].result.exact == partial.cases[i].result.exact);
+        }
+        partials.push_back(read);
+    }
+
+    // the merge does not depend on the order the shards finished in
+    std::vector<size_t> order = {0, 1, 2};
+    do
+    {
+        std::vector<PartialResult> shuffled;
+        for (const size_t shard : order)
+        {
+            shuffled.push_back(partials[shard]);
+        }
+        CHECK(mergedOutput(shuffled, directory.file("merged.tsv")) == expected);
+        CHECK(mergePartialResults(shuffled).stats.totalCost == single.stats.totalCost);
+    } while (std::next_permutation(order.begin(), order.end()));
+
+    // another tree, another sharding, a missing or a repeated shard are refused
+    auto otherTree = partials;
+    otherTree[1] = alignShard("->( 'a', 'b' )", file, 1, 3, options);
+    CHECK_THROWS_AS(mergePartialResults(otherTree), std::runtime_error);
+    CHECK_THROWS_AS(mergePartialResults({partials[0], partials[1], alignShard(log.tree, file, 1, 2, options)}), std::runtime_error);
+    CHECK_THROWS_AS(mergePartialResults({partials[0], partials[2]}), std::runtime_error);
+    CHECK_THROWS_AS(mergePartialResults({partials[0], partials[1], partials[1], partials[2]}), std::runtime_error);
+    CHECK_THROWS_AS(mergePartialResults({}), std::runtime_error);
+    CHECK_THROWS_AS(alignShard(log.tree, file, 3, 3, options), std::invalid_argument);
+
+    // a partial result cut short is not mistaken for a whole one
+    const std::string truncated = directory.file("truncated");
+    const std::string content = readFile(partialResultPath(directory.file("merged.tsv"), 0, 3));
+    std::ofstream(truncated) << content.substr(0, content.rfind('\n', content.size() - 2) + 1);
+    CHECK_THROWS_AS(readPartialResult(truncated), std::runtime_error);
+    CHECK_THROWS_AS(readPartialResult(directory.file("missing")), std::runtime_error);
+}
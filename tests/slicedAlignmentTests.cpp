@@ -0,0 +1,73 @@
+#include "parser.h"
+#include "slicedAlignment.h"
+#include "testTrees.h"
+#include <catch2/catch_test_macros.hpp>
+#include <random>
+#include <thread>
+
+namespace
+{
+    // loops without parallels keep the reference polynomial, so traces can be long enough to take several slices
+    const std::string loopTree = "*( X( ->( 'a', 'b' ), *( 'c', ->( 'd', 'a' ) ) ), X( 'e', 'f', tau ) )";
+
+    std::vector<int> randomTrace(unsigned seed, size_t length)
+    {
+        std::mt19937 random(seed);
+        std::vector<std::string> labels;
+        for (size_t i = 0; i < length; i++)
+        {
+            labels.push_back(std::string(1, "abcdef"[random() % 6]));
+        }
+        return encodeTrace(labels);
+    }
+}
+
+TEST_CASE("a task resumes on other threads", "[sliced][reference]")
+{
+    const auto root = parseProcessTreeString(loopTree);
+    for (unsigned seed = 0; seed < 3; seed++)
+    {
+        const auto trace = randomTrace(seed, 44);
+        AlignmentTask task(root, trace);
+        // every other slice on a thread of its own, the rest on this one
+        for (int slice = 0; !task.done(); slice++)
+        {
+            if (slice % 2 == 0)
+            {
+                std::thread([&]
+                            { task.resume(std::chrono::milliseconds(1)); })
+                    .join();
+            }
+            else
+            {
+                task.resume(std::chrono::milliseconds(1));
+            }
+        }
+        INFO(seed);
+        CHECK(task.result().exact);
+        CHECK(task.result().cost == referenceCost(root, trace));
+    }
+}
+
+TEST_CASE("the pool aligns every variant in slices", "[sliced][reference]")
+{
+    const auto root = parseProcessTreeString(loopTree);
+    std::vector<std::vector<int>> variants;
+    for (unsigned seed = 0; seed < 8; seed++)
+    {
+        variants.push_back(randomTrace(seed + 10, 8 + 5 * seed));
+    }
+    SlicedOptions options;
+    options.threads = 4;
+    options.slice = std::chrono::milliseconds(1);
+    options.timeoutMs = 0;
+
+    const auto results = alignVariantsSliced(root, variants, options);
+    REQUIRE(results.size() == variants.size());
+    for (size_t i = 0; i < variants.size(); i++)
+    {
+        INFO(i);
+        CHECK(results[i].exact);
+        CHECK(results[i].cost == referenceCost(root, variants[i]));
+    }
+}
@@ -0,0 +1,100 @@
+#include "parser.h"
+#include "testTrees.h"
+#include "treeAlignment.h"
+#include <catch2/catch_test_macros.hpp>
+#include <stdexcept>
+
+namespace
+{
+    // Runs the alignment in slices that end at the first clock check of a cancelled deadline, moving the frames
+    // into a new alignment after every slice and clearing the memo after every other one
+    AlignmentResult runInSlices(const std::shared_ptr<TreeNode> &root, const std::vector<int> &trace, const CostModel *costs,
+                                int exact)
+    {
+        SuspendableAlignment alignment(root, trace, costs);
+        for (int slice = 0;; slice++)
+        {
+            Deadline cancelled;
+            cancelled.cancel();
+            if (alignment.run(cancelled))
+            {
+                return alignment.bounds();
+            }
+            const AlignmentResult bounds = alignment.bounds();
+            CHECK(bounds.lowerBound <= exact);
+            CHECK(exact <= bounds.cost);
+
+            SuspendableAlignment resumed(root, trace, costs);
+            resumed.loadFrames(alignment.saveFrames());
+            CHECK(resumed.depth() == alignment.depth());
+            alignment = std::move(resumed);
+            if (slice % 2 == 1)
+            {
+                costTable.clear();
+            }
+        }
+    }
+}
+
+TEST_CASE("suspended alignments resume to the exact cost", "[suspendable][reference]")
+{
+    for (unsigned seed = 0; seed < 40; seed++)
+    {
+        const auto log = randomLog(seed, 10, 4, 8);
+        const auto root = parseProcessTreeString(log.tree);
+        const CostModel costs(root, testLogMoveCosts(), testModelMoveCosts());
+        INFO(log.tree);
+        for (const auto &trace : log.traces)
+        {
+            costTable.clear();
+            const int exact = referenceCost(root, trace);
+            const AlignmentResult result = runInSlices(root, trace, nullptr, exact);
+            CHECK(result.exact);
+            CHECK(result.cost == exact);
+
+            costTable.clear();
+            const int weighted = referenceCost(root, trace, &costs);
+            CHECK(runInSlices(root, trace, &costs, weighted).cost == weighted);
+        }
+    }
+}
+
+TEST_CASE("a deep chain runs off the call stack", "[suspendable]")
+{
+    // a sequence nested 2000 deep, which dynAlign would walk on the call stack
+    std::string tree = "'a'";
+    for (int i = 0; i < 2000; i++)
+    {
+        tree = "->( " + tree + ", X( 'chain" + std::to_string(i) + "', tau ) )";
+    }
+    const auto root = parseProcessTreeString(tree);
+    const auto trace = encodeTrace({"a", "chain5", "c", "chain1999"});
+
+    costTable.clear();
+    SuspendableAlignment alignment(root, trace);
+    Deadline deadline;
+    REQUIRE(alignment.run(deadline));
+    CHECK(alignment.done());
+    CHECK(alignment.bounds().cost == 1);
+}
+
+TEST_CASE("frames of another trace or tree are rejected", "[suspendable]")
+{
+    const auto root = parseProcessTreeString("*( ->( 'a', +( 'b', 'c' ) ), 'd' )");
+    const auto trace = encodeTrace({"a", "c", "b", "d", "a", "b", "c", "d", "a"});
+    SuspendableAlignment alignment(root, trace);
+    Deadline cancelled;
+    cancelled.cancel();
+    alignment.run(cancelled);
+    const std::string frames = alignment.saveFrames();
+
+    SuspendableAlignment otherTrace(root, encodeTrace({"a", "b", "c"}));
+    CHECK_THROWS_AS(otherTrace.loadFrames(frames), std::invalid_argument);
+    SuspendableAlignment otherTree(parseProcessTreeString("*( ->( 'a', +( 'c', 'b' ) ), 'd' )"), trace);
+    CHECK_THROWS_AS(otherTree.loadFrames(frames), std::invalid_argument);
+    std::string damaged = frames;
+    damaged[damaged.size() / 2] ^= 0x01;
+    SuspendableAlignment same(root, trace);
+    CHECK_THROWS_AS(same.loadFrames(damaged), std::invalid_argument);
+    CHECK_THROWS_AS(same.loadFrames("not frames"), std::invalid_argument);
+}
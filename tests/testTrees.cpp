@@ -0,0 +1,343 @@
+#include "testTrees.h"
+#include "parser.h"
+#include <algorithm>
+#include <map>
+#include <random>
+#include <tuple>
+
+namespace
+{
+    const std::string labels = "abcdefgh";
+
+    struct RandomTree
+    {
+        std::string op;
+        std::string label;
+        std::vector<RandomTree> children;
+    };
+
+    RandomTree randomTree(std::mt19937 &random, int depth)
+    {
+        std::uniform_real_distribution<double> chance(0.0, 1.0);
+        if (depth == 0 || chance(random) < 0.3)
+        {
+            if (chance(random) < 0.25)
+            {
+                return {"tau", "", {}};
+            }
+            return {"", std::string(1, labels[random() % labels.size()]), {}};
+        }
+        static const char *operators[] = {"->", "X", "+", "*"};
+        RandomTree tree{operators[random() % 4], "", {}};
+        const size_t count = tree.op == "*" ? 2 : 2 + random() % 2;
+        for (size_t i = 0; i < count; i++)
+        {
+            tree.children.push_back(randomTree(random, depth - 1));
+        }
+        return tree;
+    }
+
+    std::string treeString(const RandomTree &tree)
+    {
+        if (tree.op == "tau")
+        {
+            return "tau";
+        }
+        if (tree.op.empty())
+        {
+            return "'" + tree.label + "'";
+        }
+        std::string result = tree.op + "( ";
+        for (size_t i = 0; i < tree.children.size(); i++)
+        {
+            result += (i > 0 ? ", " : "") + treeString(tree.children[i]);
+        }
+        return result + " )";
+    }
+
+    std::vector<std::string> play(std::mt19937 &random, const RandomTree &tree)
+    {
+        std::uniform_real_distribution<double> chance(0.0, 1.0);
+        if (tree.op == "tau")
+        {
+            return {};
+        }
+        if (tree.op.empty())
+        {
+            return {tree.label};
+        }
+        std::vector<std::string> run;
+        if (tree.op == "->")
+        {
+            for (const auto &child : tree.children)
+            {
+                const auto part = play(random, child);
+                run.insert(run.end(), part.begin(), part.end());
+            }
+        }
+        else if (tree.op == "X")
+        {
+            run = play(random, tree.children[random() % tree.children.size()]);
+        }
+        else if (tree.op == "+")
+        {
+            std::vector<std::vector<std::string>> parts;
+            for (const auto &child : tree.children)
+            {
+                parts.push_back(play(random, child));
+            }
+            std::vector<size_t> next(parts.size(), 0);
+            while (true)
+            {
+                std::vector<size_t> open;
+                for (size_t i = 0; i < parts.size(); i++)
+                {
+                    if (next[i] < parts[i].size())
+                    {
+                        open.push_back(i);
+                    }
+                }
+                if (open.empty())
+                {
+                    break;
+                }
+                const size_t part = open[random() % open.size()];
+                run.push_back(parts[part][next[part]++]);
+            }
+        }
+        else
+        {
+            run = play(random, tree.children[0]);
+            while (chance(random) < 0.5 && run.size() < 12)
+            {
+                for (const auto &child : {tree.children[1], tree.children[0]})
+                {
+                    const auto part = play(random, child);
+                    run.insert(run.end(), part.begin(), part.end());
+                }
+            }
+        }
+        return run;
+    }
+
+    constexpr int infinite = 1 << 28;
+
+    // Alignment costs of the subtrees with subsequences of the trace, which are masks over its positions: a
+    // sequence splits the subsequence into consecutive parts, a parallel deals its events out to the children and a
+    // loop alternates parts of its do and redo child. That is the definition of the alignment cost, so the reference
+    // shares no code with the aligners under test.
+    struct Reference
+    {
+        const std::vector<int> &trace;
+        const CostModel *costs;
+        std::map<std::tuple<const TreeNode *, size_t, uint64_t>, int> memo;
+
+        int logMove(int activity) const
+        {
+            return costs ? costs->logMove(activity) : 1;
+        }
+
+        int modelMove(int activity) const
+        {
+            return costs ? costs->modelMove(activity) : 1;
+        }
+
+        std::vector<int> positions(uint64_t mask) const
+        {
+            std::vector<int> result;
+            for (int position = 0; position < static_cast<int>(trace.size()); position++)
+            {
+                if (mask & (uint64_t(1) << position))
+                {
+                    result.push_back(position);
+                }
+            }
+            return result;
+        }
+
+        // mask of the positions from begin to end in the list
+        static uint64_t part(const std::vector<int> &positions, size_t begin, size_t end)
+        {
+            uint64_t mask = 0;
+            for (size_t i = begin; i < end; i++)
+            {
+                mask |= uint64_t(1) << positions[i];
+            }
+            return mask;
+        }
+
+        // the children from first on share the events of mask
+        int parallel(const TreeNode &node, size_t first, uint64_t mask)
+        {
+            const auto &children = node.getChildren();
+            if (first + 1 == children.size())
+            {
+                return cost(*children[first], mask);
+            }
+            const auto key = std::make_tuple(&node, first + 1, mask);
+            if (const auto it = memo.find(key); it != memo.end())
+            {
+                return it->second;
+            }
+            int best = infinite;
+            // every submask, the empty one included
+            for (uint64_t own = mask;; own = (own - 1) & mask)
+            {
+                best = std::min(best, cost(*children[first], own) + parallel(node, first + 1, mask & ~own));
+                if (own == 0)
+                {
+                    break;
+                }
+            }
+            return memo[key] = best;
+        }
+
+        int cost(const TreeNode &node, uint64_t mask)
+        {
+            const auto key = std::make_tuple(&node, size_t(0), mask);
+            if (const auto it = memo.find(key); it != memo.end())
+            {
+                return it->second;
+            }
+            const auto events = positions(mask);
+            const auto &children = node.getChildren();
+            int logMoves = 0;
+            for (const int position : events)
+            {
+                logMoves += logMove(trace[position]);
+            }
+
+            int best = infinite;
+            switch (node.getOperation())
+            {
+            case ACTIVITY:
+            {
+                const int activity = node.getActivity();
+                const bool matched = std::any_of(events.begin(), events.end(), [&](int position)
+                                                 { return trace[position] == activity; });
+                best = matched ? logMoves - logMove(activity) : logMoves + modelMove(activity);
+                break;
+            }
+            case SILENT_ACTIVITY:
+                best = logMoves;
+                break;
+            case XOR:
+                for (const auto &child : children)
+                {
+                    best = std::min(best, cost(*child, mask));
+                }
+                break;
+            case PARALLEL:
+                best = parallel(node, 0, mask);
+                break;
+            case SEQUENCE:
+            {
+                // cheapest alignment of the first end events with the children so far
+                std::vector<int> prefix(events.size() + 1, infinite);
+                prefix[0] = 0;
+                for (const auto &child : children)
+                {
+                    std::vector<int> next(events.size() + 1, infinite);
+                    for (size_t end = 0; end <= events.size(); end++)
+                    {
+                        for (size_t begin = 0; begin <= end; begin++)
+                        {
+                            next[end] = std::min(next[end], prefix[begin] + cost(*child, part(events, begin, end)));
+                        }
+                    }
+                    prefix = std::move(next);
+                }
+                best = prefix.back();
+                break;
+            }
+            case REDO_LOOP:
+            {
+                // cheapest alignment of the first end events with do (redo do)*, and with do (redo do)* redo; a step
+                // that adds no events adds no cost either, so an end only depends on smaller ones and itself
+                const TreeNode &doChild = *children[0];
+                const TreeNode &redoChild = *children[1];
+                std::vector<int> runs(events.size() + 1, infinite);
+                std::vector<int> redone(events.size() + 1, infinite);
+                for (size_t end = 0; end <= events.size(); end++)
+                {
+                    for (size_t begin = 0; begin < end; begin++)
+                    {
+                        redone[end] = std::min(redone[end], runs[begin] + cost(redoChild, part(events, begin, end)));
+                    }
+                    runs[end] = std::min(cost(doChild, part(events, 0, end)), redone[end] + cost(doChild, 0));
+                    for (size_t split = 0; split < end; split++)
+                    {
+                        runs[end] = std::min(runs[end], redone[split] + cost(doChild, part(events, split, end)));
+                    }
+                    redone[end] = std::min(redone[end], runs[end] + cost(redoChild, 0));
+                }
+                best = runs.back();
+                break;
+            }
+            default:
+                break;
+            }
+            return memo[key] = best;
+        }
+    };
+}
+
+RandomLog randomLog(unsigned seed, size_t traces, int depth, size_t maxTraceLength)
+{
+    std::mt19937 random(seed);
+    std::uniform_real_distribution<double> chance(0.0, 1.0);
+    const RandomTree tree = randomTree(random, depth);
+    RandomLog log{treeString(tree), {}};
+    for (size_t i = 0; i < traces; i++)
+    {
+        auto trace = play(random, tree);
+        if (!trace.empty() && chance(random) < 0.4)
+        {
+            const size_t position = random() % trace.size();
+            const double kind = chance(random);
+            if (kind < 0.3)
+            {
+                trace.erase(trace.begin() + position);
+            }
+            else if (kind < 0.6)
+            {
+                trace.insert(trace.begin() + position, std::string(1, labels[random() % labels.size()]));
+            }
+            else if (position + 1 < trace.size())
+            {
+                std::swap(trace[position], trace[position + 1]);
+            }
+        }
+        trace.resize(std::min(trace.size(), maxTraceLength));
+        log.traces.push_back(encodeTrace(trace));
+    }
+    return log;
+}
+
+std::vector<int> encodeTrace(const std::vector<std::string> &labels)
+{
+    std::vector<int> trace;
+    for (const auto &label : labels)
+    {
+        trace.push_back(registerActivity(label));
+    }
+    return trace;
+}
+
+const std::unordered_map<std::string, int> &testLogMoveCosts()
+{
+    static const std::unordered_map<std::string, int> costs = {{"a", 1}, {"b", 4}, {"c", 5}, {"d", 2}, {"e", 3}};
+    return costs;
+}
+
+const std::unordered_map<std::string, int> &testModelMoveCosts()
+{
+    static const std::unordered_map<std::string, int> costs = {{"a", 4}, {"b", 1}, {"c", 4}, {"d", 2}, {"e", 1}};
+    return costs;
+}
+
+int referenceCost(const std::shared_ptr<TreeNode> &root, const std::vector<int> &trace, const CostModel *costs)
+{
+    Reference reference{trace, costs, {}};
+    return reference.cost(*root, trace.empty() ? 0 : (uint64_t(1) << trace.size()) - 1);
+}
@@ -0,0 +1,32 @@
+#ifndef TESTTREES_H
+#define TESTTREES_H
+#include "costModel.h"
+#include "treeNode.h"
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// A random tree over the labels a to h and traces played out of it, some with an event dropped, added or swapped
+struct RandomLog
+{
+    std::string tree;
+    std::vector<std::vector<int>> traces;
+};
+
+// the same seed gives the same log; traces are cut to maxTraceLength events so that referenceCost stays cheap
+RandomLog randomLog(unsigned seed, size_t traces, int depth = 3, size_t maxTraceLength = 6);
+
+// activity ids of the labels, registering labels no tree has
+std::vector<int> encodeTrace(const std::vector<std::string> &labels);
+
+// weights of the labels a to e, with log and model moves priced differently
+const std::unordered_map<std::string, int> &testLogMoveCosts();
+
+const std::unordered_map<std::string, int> &testModelMoveCosts();
+
+// Alignment cost straight from its definition, by a search over the subsequences of the trace that is exponential in
+// its length, so only for short traces of fewer than 64 events
+int referenceCost(const std::shared_ptr<TreeNode> &root, const std::vector<int> &trace, const CostModel *costs = nullptr);
+
+#endif // TESTTREES_H
@@ -0,0 +1,99 @@
+#include "parser.h"
+#include "testTrees.h"
+#include "treeAlignment.h"
+#include <catch2/catch_test_macros.hpp>
+
+TEST_CASE("a sequence pays for every child the trace skips", "[sequence]")
+{
+    const auto root = parseProcessTreeString("->( 'a', X( 'b', 'd' ), 'c' )");
+
+    CHECK(dynAlign(root, encodeTrace({"b"})) == 2);
+    CHECK(dynAlign(root, encodeTrace({"a", "d", "c"})) == 0);
+    CHECK(dynAlign(root, encodeTrace({"c", "d", "a"})) == 4);
+}
+
+TEST_CASE("dynAlign agrees with the reference", "[sequence][reference]")
+{
+    for (unsigned seed = 0; seed < 60; seed++)
+    {
+        const auto log = randomLog(seed, 20);
+        const auto root = parseProcessTreeString(log.tree);
+        INFO(log.tree);
+        costTable.clear();
+        for (const auto &trace : log.traces)
+        {
+            CHECK(dynAlign(root, trace) == referenceCost(root, trace));
+        }
+    }
+}
+
+TEST_CASE("weighted alignments agree with the reference", "[weighted][reference]")
+{
+    for (unsigned seed = 0; seed < 60; seed++)
+    {
+        const auto log = randomLog(seed, 20);
+        const auto root = parseProcessTreeString(log.tree);
+        const CostModel costs(root, testLogMoveCosts(), testModelMoveCosts());
+        INFO(log.tree);
+        costTable.clear();
+        for (const auto &trace : log.traces)
+        {
+            Deadline deadline;
+            const AlignmentResult result = alignAnytime(root, trace, deadline, &costs);
+            CHECK(result.exact);
+            CHECK(result.cost == referenceCost(root, trace, &costs));
+        }
+    }
+}
+
+TEST_CASE("anytime bounds contain the exact cost", "[anytime]")
+{
+    for (unsigned seed = 0; seed < 30; seed++)
+    {
+        const auto log = randomLog(seed, 10, 4, 40);
+        const auto root = parseProcessTreeString(log.tree);
+        INFO(log.tree);
+        for (const auto &trace : log.traces)
+        {
+            costTable.clear();
+            const int exact = dynAlign(root, trace);
+
+            // a cancelled deadline is noticed at the next clock check, which leaves the search cut short
+            costTable.clear();
+            Deadline cancelled;
+            cancelled.cancel();
+            const AlignmentResult result = alignAnytime(root, trace, cancelled);
+            CHECK(result.lowerBound <= exact);
+            CHECK(exact <= result.cost);
+            if (result.exact)
+            {
+                CHECK(result.cost == exact);
+            }
+        }
+    }
+}
+
+TEST_CASE("alignWithin is exact up to the budget", "[budget][reference]")
+{
+    for (unsigned seed = 0; seed < 40; seed++)
+    {
+        const auto log = randomLog(seed, 10);
+        const auto root = parseProcessTreeString(log.tree);
+        INFO(log.tree);
+        for (const auto &trace : log.traces)
+        {
+            const int exact = referenceCost(root, trace);
+            for (int budget = 0; budget <= exact + 1; budget++)
+            {
+                costTable.clear();
+                CHECK(alignWithin(root, trace, budget) == (exact <= budget ? exact : -1));
+            }
+            // and again with the memo the budgets left behind
+            CHECK(alignWithin(root, trace, exact) == exact);
+            if (exact > 0)
+            {
+                CHECK(alignWithin(root, trace, exact - 1) == -1);
+            }
+        }
+    }
+}
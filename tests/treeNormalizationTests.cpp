@@ -0,0 +1,36 @@
+#include "parser.h"
+#include "testTrees.h"
+#include "treeAlignment.h"
+#include "treeNormalization.h"
+#include <catch2/catch_test_macros.hpp>
+
+TEST_CASE("nested operators and taus are flattened", "[normalization]")
+{
+    NormalizationStats stats;
+    const auto root = normalizeTree(parseProcessTreeString("->( 'a', ->( tau, 'b', +( 'c' ) ), X( tau, X( tau, 'd' ) ) )"), &stats);
+
+    CHECK(stats.nodesBefore == 12);
+    CHECK(stats.nodesAfter == countNodes(root));
+    CHECK(stats.nodesAfter == 7);
+    CHECK(dynAlign(root, encodeTrace({"a", "b", "c"})) == 0);
+    CHECK(dynAlign(root, encodeTrace({"a", "c", "b", "d"})) == 2);
+}
+
+TEST_CASE("normalized trees have the same alignment costs", "[normalization][reference]")
+{
+    for (unsigned seed = 0; seed < 60; seed++)
+    {
+        const auto log = randomLog(seed, 20, 4);
+        // the tree is rewritten in place, so the reference gets a tree of its own
+        const auto original = parseProcessTreeString(log.tree);
+        NormalizationStats stats;
+        const auto root = normalizeTree(parseProcessTreeString(log.tree), &stats);
+        INFO(log.tree);
+        CHECK(stats.nodesAfter <= stats.nodesBefore);
+        costTable.clear();
+        for (const auto &trace : log.traces)
+        {
+            CHECK(dynAlign(root, trace) == referenceCost(original, trace));
+        }
+    }
+}